@@ -47,7 +47,7 @@ win32 {
     }
 
     INCLUDEPATH += $$PWD/../libs/windows/include
-    LIBS += ws2_32.lib winmm.lib dxva2.lib ole32.lib gdi32.lib user32.lib d3d9.lib dwmapi.lib dbghelp.lib
+    LIBS += ws2_32.lib winmm.lib dxva2.lib ole32.lib gdi32.lib user32.lib d3d9.lib dwmapi.lib dbghelp.lib psapi.lib
 }
 macx {
     INCLUDEPATH += $$PWD/../libs/mac/include
@@ -129,6 +129,7 @@ SOURCES += \
     backend/nvapp.cpp \
     main.cpp \
     backend/computerseeker.cpp \
+    backend/cachedcomputervalidator.cpp \
     backend/identitymanager.cpp \
     backend/nvcomputer.cpp \
     backend/nvhttp.cpp \
@@ -145,20 +146,25 @@ SOURCES += \
     streaming/input/abstouch.cpp \
     streaming/input/gamepad.cpp \
     streaming/input/input.cpp \
+    streaming/input/inputthread.cpp \
     streaming/input/keyboard.cpp \
     streaming/input/mouse.cpp \
     streaming/input/reltouch.cpp \
     streaming/session.cpp \
+    streaming/avsync.cpp \
     streaming/audio/audio.cpp \
     streaming/audio/renderers/sdlaud.cpp \
+    streaming/audio/renderers/nullaud.cpp \
     gui/computermodel.cpp \
     gui/appmodel.cpp \
     streaming/streamutils.cpp \
+    streaming/threadroles.cpp \
     backend/autoupdatechecker.cpp \
     path.cpp \
     settings/mappingmanager.cpp \
     gui/sdlgamepadkeynavigation.cpp \
     streaming/video/overlaymanager.cpp \
+    streaming/video/planecopy.cpp \
     backend/systemproperties.cpp \
     wm.cpp
 
@@ -169,6 +175,7 @@ HEADERS += \
     settings/mappingfetcher.h \
     utils.h \
     backend/computerseeker.h \
+    backend/cachedcomputervalidator.h \
     backend/identitymanager.h \
     backend/nvcomputer.h \
     backend/nvhttp.h \
@@ -182,17 +189,21 @@ HEADERS += \
     settings/streamingpreferences.h \
     streaming/input/input.h \
     streaming/session.h \
+    streaming/avsync.h \
     streaming/audio/renderers/renderer.h \
     streaming/audio/renderers/sdl.h \
+    streaming/audio/renderers/nullaud.h \
     gui/computermodel.h \
     gui/appmodel.h \
     streaming/video/decoder.h \
     streaming/streamutils.h \
+    streaming/threadroles.h \
     backend/autoupdatechecker.h \
     path.h \
     settings/mappingmanager.h \
     gui/sdlgamepadkeynavigation.h \
     streaming/video/overlaymanager.h \
+    streaming/video/planecopy.h \
     backend/systemproperties.h
 
 # Platform-specific renderers and decoders
@@ -202,15 +213,23 @@ ffmpeg {
     DEFINES += HAVE_FFMPEG
     SOURCES += \
         streaming/video/ffmpeg.cpp \
+        streaming/video/rfitracker.cpp \
         streaming/video/ffmpeg-renderers/sdlvid.cpp \
+        streaming/video/ffmpeg-renderers/nullvid.cpp \
         streaming/video/ffmpeg-renderers/pacer/pacer.cpp \
+        streaming/video/ffmpeg-renderers/pacer/pacingdepth.cpp \
+        streaming/video/ffmpeg-renderers/pacer/heldframes.cpp \
         streaming/video/ffmpeg-renderers/pacer/nullthreadedvsyncsource.cpp
 
     HEADERS += \
         streaming/video/ffmpeg.h \
+        streaming/video/rfitracker.h \
         streaming/video/ffmpeg-renderers/renderer.h \
         streaming/video/ffmpeg-renderers/sdlvid.h \
+        streaming/video/ffmpeg-renderers/nullvid.h \
         streaming/video/ffmpeg-renderers/pacer/pacer.h \
+        streaming/video/ffmpeg-renderers/pacer/pacingdepth.h \
+        streaming/video/ffmpeg-renderers/pacer/heldframes.h \
         streaming/video/ffmpeg-renderers/pacer/nullthreadedvsyncsource.h
 }
 libva {
@@ -0,0 +1,98 @@
+#include "cachedcomputervalidator.h"
+#include "nvcomputer.h"
+
+#include <QThreadPool>
+
+class AddressValidationTask : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    AddressValidationTask(NvComputer* computer, const NvAddress& address,
+                          QSharedPointer<QAtomicInt> claimed)
+        : m_Computer(computer),
+          m_Address(address),
+          m_Claimed(claimed)
+    {
+    }
+
+signals:
+    void addressValidated(bool valid);
+
+private:
+    void run() override
+    {
+        NvHTTP http(m_Address, 0, m_Computer->serverCert);
+
+        QString serverInfo;
+        try {
+            serverInfo = http.getServerInfo(NvHTTP::NvLogLevel::NVLL_NONE, true);
+        } catch (...) {
+            emit addressValidated(false);
+            return;
+        }
+
+        NvComputer newState(http, serverInfo);
+
+        // Ensure the machine that responded is the one we intended to contact,
+        // and only let the first address that answered update the computer.
+        if (m_Computer->uuid != newState.uuid || !m_Claimed->testAndSetOrdered(0, 1)) {
+            emit addressValidated(false);
+            return;
+        }
+
+        m_Computer->update(newState);
+        emit addressValidated(true);
+    }
+
+    NvComputer* m_Computer;
+    NvAddress m_Address;
+    QSharedPointer<QAtomicInt> m_Claimed;
+};
+
+CachedComputerValidator::CachedComputerValidator(NvComputer *computer, QObject *parent)
+    : QObject(parent),
+      m_Computer(computer),
+      m_Claimed(new QAtomicInt(0)),
+      m_PendingAddresses(0),
+      m_Complete(false)
+{
+
+}
+
+void CachedComputerValidator::start()
+{
+    QVector<NvAddress> addresses = m_Computer->uniqueAddresses();
+
+    m_PendingAddresses = addresses.size();
+    if (m_PendingAddresses == 0) {
+        m_Complete = true;
+        emit validationComplete(false);
+        return;
+    }
+
+    // A stale address can take the full fast fail timeout to give up,
+    // so don't make the other addresses wait for it.
+    for (const NvAddress& address : addresses) {
+        AddressValidationTask* task = new AddressValidationTask(m_Computer, address, m_Claimed);
+        connect(task, &AddressValidationTask::addressValidated,
+                this, &CachedComputerValidator::onAddressValidated);
+        QThreadPool::globalInstance()->start(task);
+    }
+}
+
+void CachedComputerValidator::onAddressValidated(bool valid)
+{
+    m_PendingAddresses--;
+
+    if (m_Complete) {
+        return;
+    }
+
+    if (valid || m_PendingAddresses == 0) {
+        m_Complete = true;
+        emit validationComplete(valid);
+    }
+}
+
+#include "cachedcomputervalidator.moc"
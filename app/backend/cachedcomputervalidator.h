@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QSharedPointer>
+
+class NvComputer;
+
+// Confirms that the persisted state of a host is still usable by sending a
+// single serverinfo request to each of its cached addresses at once. The
+// first address that answers as the same host updates the computer.
+class CachedComputerValidator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CachedComputerValidator(NvComputer *computer, QObject *parent = nullptr);
+
+    void start();
+
+signals:
+    void validationComplete(bool valid);
+
+private slots:
+    void onAddressValidated(bool valid);
+
+private:
+    NvComputer *m_Computer;
+    QSharedPointer<QAtomicInt> m_Claimed;
+    int m_PendingAddresses;
+    bool m_Complete;
+};
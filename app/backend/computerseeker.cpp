@@ -29,16 +29,16 @@ void ComputerSeeker::onComputerUpdated(NvComputer *computer)
     if (!m_TimeoutTimer->isActive()) {
         return;
     }
-    if (matchComputer(computer) && isOnline(computer)) {
+    if (matchComputer(computer, m_ComputerName) && isOnline(computer)) {
         m_ComputerManager->stopPollingAsync();
         m_TimeoutTimer->stop();
         emit computerFound(computer);
     }
 }
 
-bool ComputerSeeker::matchComputer(NvComputer *computer) const
+bool ComputerSeeker::matchComputer(NvComputer *computer, const QString& computerName)
 {
-    QString value = m_ComputerName.toLower();
+    QString value = computerName.toLower();
 
     if (computer->name.toLower() == value || computer->uuid.toLower() == value) {
         return true;
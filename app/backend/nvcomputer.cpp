@@ -6,6 +6,25 @@
 #include <QHostInfo>
 #include <QNetworkInterface>
 #include <QNetworkProxy>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+
+#ifdef Q_OS_WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+// Bytes of RTP and video packet headers that are added to the packet
+// size. The default 1392 byte packet size fills a 1500 byte MTU.
+#define VIDEO_PACKET_OVERHEAD (1500 - 20 - 8 - 1392)
+
+// How long a cached path MTU is trusted. This matches how long Linux
+// and Windows keep a PMTU learned from ICMP before probing again.
+#define PATH_MTU_CACHE_TTL_MS (10 * 60 * 1000)
 
 #define SER_NAME "hostname"
 #define SER_UUID "uuid"
@@ -102,9 +121,21 @@ void NvComputer::serialize(QSettings& settings) const
 
 void NvComputer::sortAppList()
 {
-    std::stable_sort(appList.begin(), appList.end(), [](const NvApp& app1, const NvApp& app2) {
-       return app1.name.toLower() < app2.name.toLower();
+    // Compute each sort key once rather than lowercasing both
+    // names on every comparison.
+    QVector<QPair<QString, NvApp>> keyedApps;
+    keyedApps.reserve(appList.count());
+    for (const NvApp& app : appList) {
+        keyedApps.append(qMakePair(app.name.toLower(), app));
+    }
+
+    std::stable_sort(keyedApps.begin(), keyedApps.end(), [](const QPair<QString, NvApp>& app1, const QPair<QString, NvApp>& app2) {
+       return app1.first < app2.first;
     });
+
+    for (int i = 0; i < keyedApps.count(); i++) {
+        appList[i] = keyedApps[i].second;
+    }
 }
 
 NvComputer::NvComputer(NvHTTP& http, QString serverInfo)
@@ -353,6 +384,109 @@ bool NvComputer::isReachableOverVpn()
     }
 }
 
+// Path MTUs keyed by host UUID and address. Each entry is only valid
+// for the local address it was measured from, since a VPN coming up or
+// going down changes the route without changing the host's address.
+struct PathMtuCacheEntry
+{
+    QHostAddress localAddress;
+    int maxPayloadSize;
+    QElapsedTimer age;
+};
+static QHash<QString, PathMtuCacheEntry> s_MaxUdpPayloadSizes;
+static QMutex s_MaxUdpPayloadSizesLock;
+
+int NvComputer::getMaxUdpPayloadSize()
+{
+    if (activeAddress.isNull()) {
+        return 0;
+    }
+
+    // Connecting a UDP socket only performs a route lookup. No packets
+    // are sent, so this doesn't need anything listening on the host.
+    QUdpSocket s;
+    s.setProxy(QNetworkProxy::NoProxy);
+    s.connectToHost(activeAddress.address(), activeAddress.port());
+    if (!s.waitForConnected(3000)) {
+        qWarning() << "Unable to determine path MTU:" << s.error();
+        return 0;
+    }
+
+    QString cacheKey = uuid + '/' + activeAddress.toString();
+    {
+        QMutexLocker locker(&s_MaxUdpPayloadSizesLock);
+        auto it = s_MaxUdpPayloadSizes.find(cacheKey);
+        if (it != s_MaxUdpPayloadSizes.end()) {
+            if (it->localAddress == s.localAddress() && !it->age.hasExpired(PATH_MTU_CACHE_TTL_MS)) {
+                return it->maxPayloadSize;
+            }
+
+            // The route changed or the kernel may have relearned the PMTU
+            s_MaxUdpPayloadSizes.erase(it);
+        }
+    }
+
+    bool isIpv6 = s.peerAddress().protocol() == QAbstractSocket::IPv6Protocol;
+    int mtu = 0;
+
+#if defined(IP_MTU) && defined(IPV6_MTU)
+    // The kernel knows the route MTU and any smaller PMTU it has learned
+    // from ICMP messages for this destination.
+    int sockMtu = 0;
+    socklen_t sockMtuLen = sizeof(sockMtu);
+    if (getsockopt(s.socketDescriptor(),
+                   isIpv6 ? IPPROTO_IPV6 : IPPROTO_IP,
+                   isIpv6 ? IPV6_MTU : IP_MTU,
+                   (char*)&sockMtu, &sockMtuLen) == 0) {
+        mtu = sockMtu;
+        qInfo() << "Kernel path MTU:" << mtu;
+    }
+#endif
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    if (mtu <= 0) {
+        // Fall back to the MTU of the interface we'd send from
+        for (const QNetworkInterface& nic : QNetworkInterface::allInterfaces()) {
+            for (const QNetworkAddressEntry& addr : nic.addressEntries()) {
+                if (addr.ip() == s.localAddress()) {
+                    mtu = nic.maximumTransmissionUnit();
+                    qInfo() << "Interface MTU:" << mtu;
+                }
+            }
+        }
+    }
+#endif
+
+    // Anything below the IPv4 minimum MTU isn't believable
+    if (mtu < 576) {
+        qWarning() << "Unable to determine path MTU for" << activeAddress.toString();
+        return 0;
+    }
+
+    PathMtuCacheEntry entry;
+    entry.localAddress = s.localAddress();
+
+    // Subtract the IP and UDP headers
+    entry.maxPayloadSize = mtu - (isIpv6 ? 40 : 20) - 8;
+    entry.age.start();
+
+    QMutexLocker locker(&s_MaxUdpPayloadSizesLock);
+    s_MaxUdpPayloadSizes.insert(cacheKey, entry);
+    return entry.maxPayloadSize;
+}
+
+int NvComputer::getVideoPacketSizeForPath(int defaultPacketSize, int maxUdpPayloadSize)
+{
+    if (maxUdpPayloadSize <= 0) {
+        return defaultPacketSize;
+    }
+
+    // The path MTU can only shrink the default size. We can't see the MTU
+    // of the host's own link or of hops past a VPN endpoint, so going above
+    // it would take an active probe answered by the host.
+    return qMin(maxUdpPayloadSize - VIDEO_PACKET_OVERHEAD, defaultPacketSize);
+}
+
 bool NvComputer::updateAppList(QVector<NvApp> newAppList) {
     if (appList == newAppList) {
         return false;
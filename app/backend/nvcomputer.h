@@ -38,6 +38,18 @@ public:
     bool
     isReachableOverVpn();
 
+    // Returns the largest UDP payload that fits in the path MTU to the
+    // active address, or 0 if it couldn't be determined
+    int
+    getMaxUdpPayloadSize();
+
+    // Returns the video packet size to use on a path that carries UDP
+    // payloads of up to maxUdpPayloadSize bytes (0 if unknown). This is
+    // never larger than defaultPacketSize.
+    static
+    int
+    getVideoPacketSizeForPath(int defaultPacketSize, int maxUdpPayloadSize);
+
     QVector<NvAddress>
     uniqueAddresses() const;
 
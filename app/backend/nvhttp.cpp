@@ -5,6 +5,7 @@
 #include <QUuid>
 #include <QtNetwork/QNetworkReply>
 #include <QEventLoop>
+#include <QElapsedTimer>
 #include <QTimer>
 #include <QXmlStreamReader>
 #include <QSslKey>
@@ -520,6 +521,9 @@ NvHTTP::openConnection(QUrl baseUrl,
     QT_WARNING_POP
 #endif
 
+    QElapsedTimer requestTimer;
+    requestTimer.start();
+
     QNetworkReply* reply = m_Nam.get(request);
 
     // Run the request with a timeout if requested
@@ -547,6 +551,12 @@ NvHTTP::openConnection(QUrl baseUrl,
     // GFE will puke next time
     m_Nam.clearAccessCache();
 
+    // Log how long the host took to respond. This makes it possible to measure
+    // discovery, polling, and launch latency from the logs alone.
+    if (logLevel >= NvLogLevel::NVLL_VERBOSE) {
+        qInfo() << command << "request completed in" << requestTimer.elapsed() << "ms";
+    }
+
     // Handle error
     if (reply->error() != QNetworkReply::NoError)
     {
@@ -1,9 +1,12 @@
 #include "startstream.h"
+#include "backend/cachedcomputervalidator.h"
 #include "backend/computermanager.h"
 #include "backend/computerseeker.h"
 #include "streaming/session.h"
 
 #include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
 #include <QTimer>
 
 #define COMPUTER_SEEK_TIMEOUT 10000
@@ -14,6 +17,7 @@ namespace CliStartStream
 
 enum State {
     StateInit,
+    StateValidateCachedComputer,
     StateSeekComputer,
     StateSeekApp,
     StateStartSession,
@@ -26,6 +30,8 @@ public:
     enum Type {
         AppQuitCompleted,
         AppQuitRequested,
+        CachedComputerValidated,
+        CachedComputerStale,
         ComputerFound,
         ComputerUpdated,
         Executed,
@@ -58,24 +64,60 @@ public:
         // Occurs when CliStartStreamSegue becomes visible and the UI calls launcher's execute()
         case Event::Executed:
             if (m_State == StateInit) {
-                m_State = StateSeekComputer;
                 m_ComputerManager = event.computerManager;
-
-                m_ComputerSeeker = new ComputerSeeker(m_ComputerManager, m_ComputerName, q);
-                q->connect(m_ComputerSeeker, &ComputerSeeker::computerFound,
-                           q, &Launcher::onComputerFound);
-                q->connect(m_ComputerSeeker, &ComputerSeeker::errorTimeout,
-                           q, &Launcher::onTimeout);
-                m_ComputerSeeker->start(COMPUTER_SEEK_TIMEOUT);
+                m_LaunchTimer.start();
 
                 q->connect(m_ComputerManager, &ComputerManager::computerStateChanged,
                            q, &Launcher::onComputerUpdated);
                 q->connect(m_ComputerManager, &ComputerManager::quitAppCompleted,
                            q, &Launcher::onQuitAppCompleted);
 
+                // If we've streamed this app from this host before, we can skip
+                // discovery and the app list fetch. We just need one serverinfo
+                // response to get the host's current address and state.
+                m_Computer = findCachedComputer();
+                if (m_Computer != nullptr) {
+                    m_State = StateValidateCachedComputer;
+
+                    CachedComputerValidator* validator = new CachedComputerValidator(m_Computer, q);
+                    q->connect(validator, &CachedComputerValidator::validationComplete,
+                               q, &Launcher::onCachedComputerValidated);
+                    validator->start();
+                }
+                else {
+                    startComputerSeek();
+                }
+
                 emit q->searchingComputer();
             }
             break;
+        // Occurs when the cached host responded to our serverinfo request
+        case Event::CachedComputerValidated:
+            if (m_State == StateValidateCachedComputer) {
+                int index = getAppIndex();
+                if (m_Computer->pairState == NvComputer::PS_PAIRED && index != -1) {
+                    app = m_Computer->appList[index];
+                    if (isNotStreaming() || isStreamingApp(app)) {
+                        qInfo() << "Starting session from cached host state after" << m_LaunchTimer.elapsed() << "ms";
+                        m_State = StateStartSession;
+                        session = new Session(m_Computer, app, m_Preferences);
+                        emit q->sessionCreated(app.name, session);
+                        break;
+                    }
+                }
+
+                // We need another app to quit first or the cached state wasn't
+                // what we expected, so take the normal path that polls the host.
+                startComputerSeek();
+            }
+            break;
+        // Occurs when the cached host couldn't be reached at any cached address
+        case Event::CachedComputerStale:
+            if (m_State == StateValidateCachedComputer) {
+                qInfo() << "Cached host state is stale; searching for" << m_ComputerName;
+                startComputerSeek();
+            }
+            break;
         // Occurs when searched computer is found
         case Event::ComputerFound:
             if (m_State == StateSeekComputer) {
@@ -101,6 +143,7 @@ public:
                     app = m_Computer->appList[index];
                     m_TimeoutTimer->stop();
                     if (isNotStreaming() || isStreamingApp(app)) {
+                        qInfo() << "Starting session after host discovery took" << m_LaunchTimer.elapsed() << "ms";
                         m_State = StateStartSession;
                         session = new Session(m_Computer, app, m_Preferences);
                         emit q->sessionCreated(app.name, session);
@@ -140,6 +183,45 @@ public:
         }
     }
 
+    void startComputerSeek()
+    {
+        Q_Q(Launcher);
+
+        m_State = StateSeekComputer;
+
+        m_ComputerSeeker = new ComputerSeeker(m_ComputerManager, m_ComputerName, q);
+        q->connect(m_ComputerSeeker, &ComputerSeeker::computerFound,
+                   q, &Launcher::onComputerFound);
+        q->connect(m_ComputerSeeker, &ComputerSeeker::errorTimeout,
+                   q, &Launcher::onTimeout);
+        m_ComputerSeeker->start(COMPUTER_SEEK_TIMEOUT);
+    }
+
+    NvComputer* findCachedComputer()
+    {
+        for (NvComputer* computer : m_ComputerManager->getComputers()) {
+            if (!ComputerSeeker::matchComputer(computer, m_ComputerName)) {
+                continue;
+            }
+
+            QReadLocker lock(&computer->lock);
+
+            // We must have paired with this host in the past
+            // and know about the app we're going to launch.
+            if (computer->serverCert.isNull()) {
+                continue;
+            }
+
+            for (const NvApp& app : computer->appList) {
+                if (app.name.toLower() == m_AppName.toLower()) {
+                    return computer;
+                }
+            }
+        }
+
+        return nullptr;
+    }
+
     int getAppIndex() const
     {
         for (int i = 0; i < m_Computer->appList.length(); i++) {
@@ -179,6 +261,7 @@ public:
     NvComputer *m_Computer;
     State m_State;
     QTimer *m_TimeoutTimer;
+    QElapsedTimer m_LaunchTimer;
 };
 
 Launcher::Launcher(QString computer, QString app,
@@ -230,6 +313,13 @@ void Launcher::onComputerFound(NvComputer *computer)
     d->handleEvent(event);
 }
 
+void Launcher::onCachedComputerValidated(bool valid)
+{
+    Q_D(Launcher);
+    Event event(valid ? Event::CachedComputerValidated : Event::CachedComputerStale);
+    d->handleEvent(event);
+}
+
 void Launcher::onComputerUpdated(NvComputer *computer)
 {
     Q_D(Launcher);
@@ -36,6 +36,7 @@ signals:
     void appQuitRequired(QString appName);
 
 private slots:
+    void onCachedComputerValidated(bool valid);
     void onComputerFound(NvComputer *computer);
     void onComputerUpdated(NvComputer *computer);
     void onTimeout();
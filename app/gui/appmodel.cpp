@@ -1,5 +1,8 @@
 #include "appmodel.h"
 
+#include <QHash>
+#include <QSet>
+
 AppModel::AppModel(QObject *parent)
     : QAbstractListModel(parent)
 {
@@ -118,26 +121,22 @@ void AppModel::quitRunningApp()
     m_ComputerManager->quitRunningApp(m_Computer);
 }
 
-bool AppModel::isAppCurrentlyVisible(const NvApp& app)
-{
-    for (const NvApp& visibleApp : m_VisibleApps) {
-        if (app.id == visibleApp.id) {
-            return true;
-        }
-    }
-
-    return false;
-}
-
 QVector<NvApp> AppModel::getVisibleApps(const QVector<NvApp>& appList)
 {
     QVector<NvApp> visibleApps;
+    QSet<int> currentlyVisibleIds;
+
+    if (!m_ShowHiddenGames) {
+        for (const NvApp& visibleApp : m_VisibleApps) {
+            currentlyVisibleIds.insert(visibleApp.id);
+        }
+    }
 
     for (const NvApp& app : appList) {
         // Don't immediately hide games that were previously visible. This
         // allows users to easily uncheck the "Hide App" checkbox if they
         // check it by mistake.
-        if (m_ShowHiddenGames || !app.hidden || isAppCurrentlyVisible(app)) {
+        if (m_ShowHiddenGames || !app.hidden || currentlyVisibleIds.contains(app.id)) {
             visibleApps.append(app);
         }
     }
@@ -151,57 +150,93 @@ void AppModel::updateAppList(QVector<NvApp> newList)
 
     QVector<NvApp> newVisibleList = getVisibleApps(newList);
 
-    // Process removals and updates first
+    // The new list is already sorted, so we just need to know
+    // where each app lands in it to reconcile the two lists.
+    QHash<int, int> newIndexById;
+    newIndexById.reserve(newVisibleList.count());
+    for (int i = 0; i < newVisibleList.count(); i++) {
+        newIndexById.insert(newVisibleList[i].id, i);
+    }
+
+    // Find the existing apps we can keep. An app must be removed if it's
+    // gone from the new list or if it was renamed such that it's now out
+    // of order relative to the apps before it (it will be reinserted below).
+    QVector<bool> keepApp(m_VisibleApps.count());
+    int lastNewIndex = -1;
     for (int i = 0; i < m_VisibleApps.count(); i++) {
-        const NvApp& existingApp = m_VisibleApps.at(i);
-
-        bool found = false;
-        for (const NvApp& newApp : newVisibleList) {
-            if (existingApp.id == newApp.id) {
-                // If the data changed, update it in our list
-                if (existingApp != newApp) {
-                    m_VisibleApps.replace(i, newApp);
-                    emit dataChanged(createIndex(i, 0), createIndex(i, 0));
-                }
+        int newIndex = newIndexById.value(m_VisibleApps[i].id, -1);
+        if (newIndex > lastNewIndex) {
+            keepApp[i] = true;
+            lastNewIndex = newIndex;
+        }
+    }
 
-                found = true;
-                break;
-            }
+    // Process removals in contiguous ranges from the end, so the
+    // indexes of earlier rows remain valid as we go.
+    for (int i = m_VisibleApps.count() - 1; i >= 0; i--) {
+        if (keepApp[i]) {
+            continue;
         }
 
-        if (!found) {
-            beginRemoveRows(QModelIndex(), i, i);
-            m_VisibleApps.removeAt(i);
-            endRemoveRows();
+        int last = i;
+        while (i > 0 && !keepApp[i - 1]) {
             i--;
         }
-    }
 
-    // Process additions now
-    for (const NvApp& newApp : newVisibleList) {
-        int insertionIndex = m_VisibleApps.size();
-        bool found = false;
+        beginRemoveRows(QModelIndex(), i, last);
+        m_VisibleApps.remove(i, last - i + 1);
+        endRemoveRows();
+    }
 
-        for (int i = 0; i < m_VisibleApps.count(); i++) {
-            const NvApp& existingApp = m_VisibleApps.at(i);
+    // Our remaining apps are now an in-order subsequence of the new list,
+    // so we can merge additions and updates in a single pass.
+    int changedStart = -1;
+    for (int i = 0; i < newVisibleList.count(); i++) {
+        if (i < m_VisibleApps.count() && m_VisibleApps[i].id == newVisibleList[i].id) {
+            // If the data changed, update it in our list
+            if (m_VisibleApps[i] != newVisibleList[i]) {
+                m_VisibleApps.replace(i, newVisibleList[i]);
+                if (changedStart < 0) {
+                    changedStart = i;
+                }
+                continue;
+            }
+        }
+        else {
+            // Insert this app and any others that follow it without
+            // an existing app in between as a single range.
+            int last = i;
+            while (last + 1 < newVisibleList.count() &&
+                   (i >= m_VisibleApps.count() || m_VisibleApps[i].id != newVisibleList[last + 1].id)) {
+                last++;
+            }
 
-            if (existingApp.id == newApp.id) {
-                found = true;
-                break;
+            if (changedStart >= 0) {
+                emit dataChanged(createIndex(changedStart, 0), createIndex(i - 1, 0));
+                changedStart = -1;
             }
-            else if (existingApp.name.toLower() > newApp.name.toLower()) {
-                insertionIndex = i;
-                break;
+
+            beginInsertRows(QModelIndex(), i, last);
+            m_VisibleApps.insert(i, last - i + 1, NvApp());
+            for (int j = i; j <= last; j++) {
+                m_VisibleApps[j] = newVisibleList[j];
             }
+            endInsertRows();
+
+            i = last;
+            continue;
         }
 
-        if (!found) {
-            beginInsertRows(QModelIndex(), insertionIndex, insertionIndex);
-            m_VisibleApps.insert(insertionIndex, newApp);
-            endInsertRows();
+        if (changedStart >= 0) {
+            emit dataChanged(createIndex(changedStart, 0), createIndex(i - 1, 0));
+            changedStart = -1;
         }
     }
 
+    if (changedStart >= 0) {
+        emit dataChanged(createIndex(changedStart, 0), createIndex(m_VisibleApps.count() - 1, 0));
+    }
+
     Q_ASSERT(newVisibleList == m_VisibleApps);
 }
 
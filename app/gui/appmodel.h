@@ -60,8 +60,6 @@ private:
 
     QVector<NvApp> getVisibleApps(const QVector<NvApp>& appList);
 
-    bool isAppCurrentlyVisible(const NvApp& app);
-
     NvComputer* m_Computer;
     BoxArtManager m_BoxArtManager;
     ComputerManager* m_ComputerManager;
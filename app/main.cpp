@@ -300,6 +300,18 @@ int main(int argc, char *argv[])
     SSL_free(nullptr);
 #endif
 
+    // Headless streaming is meant for machines without a display server,
+    // so Qt must not try to connect to one either. The option itself is
+    // parsed by GlobalCommandLineParser once the QGuiApplication exists.
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+                qputenv("QT_QPA_PLATFORM", "offscreen");
+            }
+            break;
+        }
+    }
+
     // Avoid using High DPI on EGLFS. It breaks font rendering.
     // https://bugreports.qt.io/browse/QTBUG-64377
     //
@@ -610,5 +622,8 @@ int main(int argc, char *argv[])
     // sometimes freezing and blocking process exit.
     QThreadPool::globalInstance()->waitForDone(30000);
 
+    // Session cleanup is done, so nothing else will use warm resources
+    Session::releaseWarmResources();
+
     return err;
 }
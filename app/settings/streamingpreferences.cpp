@@ -71,6 +71,8 @@ void StreamingPreferences::reload()
     recommendedFullScreenMode = WindowMode::WM_FULLSCREEN;
 #endif
 
+    headless = false;
+
     width = settings.value(SER_WIDTH, 1280).toInt();
     height = settings.value(SER_HEIGHT, 720).toInt();
     fps = settings.value(SER_FPS, 60).toInt();
@@ -162,6 +162,9 @@ public:
     Language language;
     CaptureSysKeysMode captureSysKeysMode;
 
+    // Not persisted. Only set from the command line for benchmarking.
+    bool headless;
+
 signals:
     void displayModeChanged();
     void bitrateChanged();
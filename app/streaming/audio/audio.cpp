@@ -1,4 +1,6 @@
+#include "../avsync.h"
 #include "../session.h"
+#include "../threadroles.h"
 #include "renderers/renderer.h"
 
 #ifdef HAVE_SOUNDIO
@@ -10,6 +12,7 @@
 #endif
 
 #include "renderers/sdl.h"
+#include "renderers/nullaud.h"
 
 #include <Limelight.h>
 
@@ -23,6 +26,13 @@
 
 IAudioRenderer* Session::createAudioRenderer(const POPUS_MULTISTREAM_CONFIGURATION opusConfig)
 {
+    // Headless sessions never play audio, but we still decode it
+    // so the CPU cost is representative of a real session.
+    if (m_Preferences->headless) {
+        TRY_INIT_RENDERER(NullAudioRenderer, opusConfig)
+        return nullptr;
+    }
+
     // Handle explicit ML_AUDIO setting and fail if the requested backend fails
     QString mlAudio = qgetenv("ML_AUDIO").toLower();
     if (mlAudio == "sdl") {
@@ -41,6 +51,10 @@ IAudioRenderer* Session::createAudioRenderer(const POPUS_MULTISTREAM_CONFIGURATI
         return nullptr;
     }
 #endif
+    else if (mlAudio == "null") {
+        TRY_INIT_RENDERER(NullAudioRenderer, opusConfig)
+        return nullptr;
+    }
     else if (!mlAudio.isEmpty()) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "Unknown audio backend: %s",
@@ -73,6 +87,10 @@ int Session::getAudioRendererCapabilities(int audioConfiguration)
     opusConfig.samplesPerFrame = 240;
     opusConfig.channelCount = CHANNEL_COUNT_FROM_AUDIO_CONFIGURATION(audioConfiguration);
 
+    if (probeWarmAudioRenderer(&opusConfig)) {
+        return s_WarmResources.audioRenderer->getCapabilities();
+    }
+
     IAudioRenderer* audioRenderer = createAudioRenderer(&opusConfig);
     if (audioRenderer == nullptr) {
         return 0;
@@ -94,6 +112,11 @@ bool Session::testAudio(int audioConfiguration)
     opusConfig.samplesPerFrame = 240;
     opusConfig.channelCount = CHANNEL_COUNT_FROM_AUDIO_CONFIGURATION(audioConfiguration);
 
+    if (probeWarmAudioRenderer(&opusConfig)) {
+        // The warm renderer is already playing to this device
+        return true;
+    }
+
     IAudioRenderer* audioRenderer = createAudioRenderer(&opusConfig);
     if (audioRenderer == nullptr) {
         return false;
@@ -112,9 +135,15 @@ int Session::arInit(int /* audioConfiguration */,
 
     SDL_memcpy(&s_ActiveSession->m_AudioConfig, opusConfig, sizeof(*opusConfig));
 
-    s_ActiveSession->m_AudioRenderer = s_ActiveSession->createAudioRenderer(&s_ActiveSession->m_AudioConfig);
-    if (s_ActiveSession->m_AudioRenderer == nullptr) {
-        return -2;
+    s_ActiveSession->m_AudioRenderer = claimWarmAudioRenderer(&s_ActiveSession->m_AudioConfig);
+    if (s_ActiveSession->m_AudioRenderer != nullptr) {
+        s_ActiveSession->m_UsedWarmResources = true;
+    }
+    else {
+        s_ActiveSession->m_AudioRenderer = s_ActiveSession->createAudioRenderer(&s_ActiveSession->m_AudioConfig);
+        if (s_ActiveSession->m_AudioRenderer == nullptr) {
+            return -2;
+        }
     }
 
     // Allow the chosen renderer to remap Opus channels as needed to ensure proper output
@@ -146,7 +175,17 @@ int Session::arInit(int /* audioConfiguration */,
 
 void Session::arCleanup()
 {
-    delete s_ActiveSession->m_AudioRenderer;
+    if (isWarmSessionEnabled() && !s_ActiveSession->m_UnexpectedTermination &&
+            s_ActiveSession->m_AudioRenderer != nullptr) {
+        // Keep the audio device open for the next session
+        delete s_WarmResources.audioRenderer;
+        s_WarmResources.audioRenderer = s_ActiveSession->m_AudioRenderer;
+        SDL_memcpy(&s_WarmResources.audioConfig, &s_ActiveSession->m_AudioConfig, sizeof(s_WarmResources.audioConfig));
+        s_WarmResources.audioHeadless = s_ActiveSession->m_Preferences->headless;
+    }
+    else {
+        delete s_ActiveSession->m_AudioRenderer;
+    }
     s_ActiveSession->m_AudioRenderer = nullptr;
 
     opus_multistream_decoder_destroy(s_ActiveSession->m_OpusDecoder);
@@ -157,19 +196,11 @@ void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
 {
     int samplesDecoded;
 
-#ifndef STEAM_LINK
     // Set this thread to high priority to reduce the chance of missing
-    // our sample delivery time. On Steam Link, this causes starvation
-    // of other threads due to severely restricted CPU time available,
-    // so we will skip it on that platform.
+    // our sample delivery time.
     if (s_ActiveSession->m_AudioSampleCount == 0) {
-        if (SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH) < 0) {
-            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                        "Unable to set audio thread to high priority: %s",
-                        SDL_GetError());
-        }
+        ThreadRoles::applyToCurrentThread(ThreadRoles::RoleAudio);
     }
-#endif
 
     // See if we need to drop this sample
     if (s_ActiveSession->m_DropAudioEndTime != 0) {
@@ -190,6 +221,14 @@ void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
 
     // If audio is muted, don't decode or play the audio
     if (s_ActiveSession->m_AudioMuted) {
+        SDL_AtomicSet(&s_ActiveSession->m_AudioLatencyMs, -1);
+        return;
+    }
+
+    // Drop this sample if audio has fallen behind video
+    if (SDL_AtomicGet(&s_ActiveSession->m_AudioTrimMs) > 0) {
+        SDL_AtomicAdd(&s_ActiveSession->m_AudioTrimMs,
+                      -(s_ActiveSession->m_AudioConfig.samplesPerFrame * 1000 / s_ActiveSession->m_AudioConfig.sampleRate));
         return;
     }
 
@@ -222,6 +261,16 @@ void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
 
             delete s_ActiveSession->m_AudioRenderer;
             s_ActiveSession->m_AudioRenderer = nullptr;
+            SDL_AtomicSet(&s_ActiveSession->m_AudioLatencyMs, -1);
+            SDL_AtomicSet(&s_ActiveSession->m_AudioMemoryBytes, 0);
+        }
+        else if ((s_ActiveSession->m_AudioSampleCount % 20) == 0) {
+            // Sample the audio latency every 20 samples (100 ms)
+            SDL_AtomicSet(&s_ActiveSession->m_AudioLatencyMs,
+                          AvSync::getAudioLatencyMs((int)LiGetPendingAudioDuration(),
+                                                    s_ActiveSession->m_AudioRenderer->getLatencyMs()));
+            SDL_AtomicSet(&s_ActiveSession->m_AudioMemoryBytes,
+                          s_ActiveSession->m_AudioRenderer->getMemoryUsage());
         }
     }
 
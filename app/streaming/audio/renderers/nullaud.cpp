@@ -0,0 +1,79 @@
+#include "nullaud.h"
+
+#include <Limelight.h>
+#include <SDL.h>
+
+NullAudioRenderer::NullAudioRenderer()
+    : m_AudioBuffer(nullptr),
+      m_FrameSize(0),
+      m_BytesSubmitted(0),
+      m_FramesSubmitted(0)
+{
+
+}
+
+bool NullAudioRenderer::prepareForPlayback(const OPUS_MULTISTREAM_CONFIGURATION* opusConfig)
+{
+    m_FrameSize = opusConfig->samplesPerFrame * sizeof(short) * opusConfig->channelCount;
+
+    m_AudioBuffer = SDL_malloc(m_FrameSize);
+    if (m_AudioBuffer == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to allocate audio buffer");
+        return false;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Discarding decoded audio: %d channels at %d Hz",
+                opusConfig->channelCount,
+                opusConfig->sampleRate);
+
+    return true;
+}
+
+NullAudioRenderer::~NullAudioRenderer()
+{
+    if (m_FramesSubmitted != 0) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Null audio renderer discarded %u frames (%llu bytes)",
+                    m_FramesSubmitted,
+                    (unsigned long long)m_BytesSubmitted);
+    }
+
+    if (m_AudioBuffer != nullptr) {
+        SDL_free(m_AudioBuffer);
+    }
+}
+
+void* NullAudioRenderer::getAudioBuffer(int*)
+{
+    return m_AudioBuffer;
+}
+
+bool NullAudioRenderer::submitAudio(int bytesWritten)
+{
+    if (bytesWritten != 0) {
+        m_FramesSubmitted++;
+        m_BytesSubmitted += bytesWritten;
+    }
+
+    return true;
+}
+
+int NullAudioRenderer::getLatencyMs()
+{
+    // Audio is "played" as soon as it's submitted
+    return 0;
+}
+
+int NullAudioRenderer::getMemoryUsage()
+{
+    return m_FrameSize;
+}
+
+int NullAudioRenderer::getCapabilities()
+{
+    // We consume audio as fast as it arrives, so we can take any duration
+    // and let the decoder callback run directly on the receive thread.
+    return CAPABILITY_SUPPORTS_ARBITRARY_AUDIO_DURATION | CAPABILITY_DIRECT_SUBMIT;
+}
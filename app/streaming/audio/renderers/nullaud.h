@@ -0,0 +1,32 @@
+#pragma once
+
+#include "renderer.h"
+#include <SDL.h>
+
+// Decodes audio and throws it away. This is used for headless streaming
+// where there may not be an audio device (or anyone to hear it).
+class NullAudioRenderer : public IAudioRenderer
+{
+public:
+    NullAudioRenderer();
+
+    virtual ~NullAudioRenderer();
+
+    virtual bool prepareForPlayback(const OPUS_MULTISTREAM_CONFIGURATION* opusConfig);
+
+    virtual void* getAudioBuffer(int* size);
+
+    virtual bool submitAudio(int bytesWritten);
+
+    virtual int getCapabilities();
+
+    virtual int getLatencyMs();
+
+    virtual int getMemoryUsage();
+
+private:
+    void* m_AudioBuffer;
+    int m_FrameSize;
+    Uint64 m_BytesSubmitted;
+    Uint32 m_FramesSubmitted;
+};
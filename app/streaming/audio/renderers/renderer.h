@@ -16,6 +16,20 @@ public:
 
     virtual int getCapabilities() = 0;
 
+    // Return the duration of audio queued ahead of playback, including the
+    // device's own latency, or -1 if the renderer can't determine it
+    virtual int getLatencyMs() {
+        return -1;
+    }
+
+    // Return the bytes of audio buffers owned by the renderer
+    virtual int getMemoryUsage() {
+        return 0;
+    }
+
+    // Drop audio that has been submitted but not played yet
+    virtual void clearQueuedAudio() {}
+
     virtual void remapChannels(POPUS_MULTISTREAM_CONFIGURATION) {
         // Use default channel mapping:
         // 0 - Front Left
@@ -18,8 +18,16 @@ public:
 
     virtual int getCapabilities();
 
+    virtual int getLatencyMs();
+
+    virtual int getMemoryUsage();
+
+    virtual void clearQueuedAudio();
+
 private:
     SDL_AudioDeviceID m_AudioDevice;
     void* m_AudioBuffer;
     int m_FrameSize;
+    int m_BytesPerSecond;
+    int m_DeviceLatencyMs;
 };
@@ -5,7 +5,9 @@
 
 SdlAudioRenderer::SdlAudioRenderer()
     : m_AudioDevice(0),
-      m_AudioBuffer(nullptr)
+      m_AudioBuffer(nullptr),
+      m_BytesPerSecond(0),
+      m_DeviceLatencyMs(0)
 {
     SDL_assert(!SDL_WasInit(SDL_INIT_AUDIO));
 
@@ -49,6 +51,11 @@ bool SdlAudioRenderer::prepareForPlayback(const OPUS_MULTISTREAM_CONFIGURATION*
         return false;
     }
 
+    // SDL converts our queued audio to the device format if needed,
+    // so queued bytes are always in our format.
+    m_BytesPerSecond = opusConfig->sampleRate * sizeof(short) * opusConfig->channelCount;
+    m_DeviceLatencyMs = have.samples * 1000 / have.freq;
+
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                 "Desired audio buffer: %u samples (%u bytes)",
                 want.samples,
@@ -114,6 +121,22 @@ bool SdlAudioRenderer::submitAudio(int bytesWritten)
     return true;
 }
 
+int SdlAudioRenderer::getLatencyMs()
+{
+    return (int)((Uint64)SDL_GetQueuedAudioSize(m_AudioDevice) * 1000 / m_BytesPerSecond) + m_DeviceLatencyMs;
+}
+
+int SdlAudioRenderer::getMemoryUsage()
+{
+    // SDL holds queued audio in its own buffers until the device consumes it
+    return m_FrameSize + (int)SDL_GetQueuedAudioSize(m_AudioDevice);
+}
+
+void SdlAudioRenderer::clearQueuedAudio()
+{
+    SDL_ClearQueuedAudio(m_AudioDevice);
+}
+
 int SdlAudioRenderer::getCapabilities()
 {
     // Direct submit can't be used because we use LiGetPendingAudioDuration()
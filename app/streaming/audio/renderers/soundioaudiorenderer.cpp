@@ -11,7 +11,7 @@ SoundIoAudioRenderer::SoundIoAudioRenderer()
       m_OutputStream(nullptr),
       m_RingBuffer(nullptr),
       m_AudioPacketDuration(0),
-      m_Latency(0),
+      m_LatencyUs{},
       m_Errored(false)
 {
 
@@ -21,7 +21,7 @@ SoundIoAudioRenderer::~SoundIoAudioRenderer()
 {
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                 "Audio latency: %f",
-                m_Latency);
+                SDL_AtomicGet(&m_LatencyUs) / 1000000.0);
 
     if (m_OutputStream != nullptr) {
         soundio_outstream_destroy(m_OutputStream);
@@ -323,6 +323,26 @@ int SoundIoAudioRenderer::getCapabilities()
     return CAPABILITY_DIRECT_SUBMIT /* | CAPABILITY_SUPPORTS_ARBITRARY_AUDIO_DURATION */;
 }
 
+int SoundIoAudioRenderer::getLatencyMs()
+{
+    int bytesPerFrame = m_OpusChannelCount * m_OutputStream->bytes_per_sample;
+    int framesQueued = soundio_ring_buffer_fill_count(m_RingBuffer) / bytesPerFrame;
+
+    // m_LatencyUs is only tracked on queueing-based backends
+    return framesQueued * 1000 / m_OutputStream->sample_rate + SDL_AtomicGet(&m_LatencyUs) / 1000;
+}
+
+int SoundIoAudioRenderer::getMemoryUsage()
+{
+    return soundio_ring_buffer_capacity(m_RingBuffer);
+}
+
+void SoundIoAudioRenderer::clearQueuedAudio()
+{
+    // Only the writer may clear the ring buffer, which is us
+    soundio_ring_buffer_clear(m_RingBuffer);
+}
+
 void SoundIoAudioRenderer::sioErrorCallback(SoundIoOutStream* stream, int err)
 {
     auto me = reinterpret_cast<SoundIoAudioRenderer*>(stream->userdata);
@@ -402,7 +422,10 @@ void SoundIoAudioRenderer::sioWriteCallback(SoundIoOutStream* stream, int frameC
 
     // Track latency on queueing-based backends
     if (me->m_SoundIo->current_backend != SoundIoBackendCoreAudio && me->m_SoundIo->current_backend != SoundIoBackendJack) {
-        soundio_outstream_get_latency(stream, &me->m_Latency);
+        double latency;
+        if (soundio_outstream_get_latency(stream, &latency) == SoundIoErrorNone) {
+            SDL_AtomicSet(&me->m_LatencyUs, (int)(latency * 1000000));
+        }
     }
 
     for (;;) {
@@ -4,6 +4,8 @@
 
 #include <soundio/soundio.h>
 
+#include <SDL.h>
+
 class SoundIoAudioRenderer : public IAudioRenderer
 {
 public:
@@ -19,6 +21,12 @@ public:
 
     virtual int getCapabilities();
 
+    virtual int getLatencyMs();
+
+    virtual int getMemoryUsage();
+
+    virtual void clearQueuedAudio();
+
 private:
     int scoreChannelLayout(const struct SoundIoChannelLayout* layout, const OPUS_MULTISTREAM_CONFIGURATION* opusConfig);
 
@@ -37,6 +45,8 @@ private:
     struct SoundIoRingBuffer* m_RingBuffer;
     struct SoundIoChannelLayout m_EffectiveLayout;
     double m_AudioPacketDuration;
-    double m_Latency;
+
+    // Written by the write callback and read by the audio thread
+    SDL_atomic_t m_LatencyUs;
     bool m_Errored;
 };
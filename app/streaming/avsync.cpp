@@ -0,0 +1,39 @@
+#include "avsync.h"
+
+// A/V offsets within this range are left alone by A/V sync trimming
+#define AV_SYNC_TRIM_THRESHOLD_MS 20
+
+int AvSync::getAudioLatencyMs(int pendingAudioMs, int rendererLatencyMs)
+{
+    if (rendererLatencyMs < 0) {
+        return -1;
+    }
+
+    return pendingAudioMs + rendererLatencyMs;
+}
+
+float AvSync::getVideoLatencyMs(float reassemblyTimeMs, float decodeTimeMs,
+                                float pacerTimeMs, float renderTimeMs)
+{
+    // Reassembly counts like the audio receive queue does. Leaving it out
+    // would start video later than audio and make video look ahead.
+    return reassemblyTimeMs + decodeTimeMs + pacerTimeMs + renderTimeMs;
+}
+
+AvSync::TrimAction AvSync::getTrimAction(float offsetMs, int& audioTrimMs)
+{
+    audioTrimMs = 0;
+
+    if (offsetMs > AV_SYNC_TRIM_THRESHOLD_MS) {
+        // Video is behind, so skip a queued video frame
+        return TRIM_VIDEO;
+    }
+    else if (offsetMs < -AV_SYNC_TRIM_THRESHOLD_MS) {
+        // Audio is behind, so drop enough audio to end up in the middle
+        // of the threshold rather than right at its edge
+        audioTrimMs = (int)-offsetMs - AV_SYNC_TRIM_THRESHOLD_MS / 2;
+        return TRIM_AUDIO;
+    }
+
+    return TRIM_NONE;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// Compares how long audio and video take to reach the user. Both start
+// when the data arrives at the client. Video runs from the first packet of
+// a frame arriving until the frame is rendered. Audio runs from a packet
+// arriving until the audio device plays it.
+class AvSync
+{
+public:
+    enum TrimAction
+    {
+        TRIM_NONE,
+        TRIM_VIDEO,
+        TRIM_AUDIO
+    };
+
+    // Returns the latency of audio arriving now, given the audio waiting
+    // to be decoded and the audio the renderer has queued ahead of
+    // playback. Returns -1 if the renderer doesn't know its latency.
+    static
+    int getAudioLatencyMs(int pendingAudioMs, int rendererLatencyMs);
+
+    // Returns the latency of video from the average time that frames
+    // spend in each stage
+    static
+    float getVideoLatencyMs(float reassemblyTimeMs, float decodeTimeMs,
+                            float pacerTimeMs, float renderTimeMs);
+
+    // Picks which path to trim when video is offsetMs behind audio.
+    // For TRIM_AUDIO, audioTrimMs is set to the audio to drop.
+    static
+    TrimAction getTrimAction(float offsetMs, int& audioTrimMs);
+};
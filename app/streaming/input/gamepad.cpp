@@ -9,9 +9,6 @@
 // How long the Start button must be pressed to toggle mouse emulation
 #define MOUSE_EMULATION_LONG_PRESS_TIME 750
 
-// How long between polling the gamepad to send virtual mouse input
-#define MOUSE_EMULATION_POLLING_INTERVAL 50
-
 // Determines how fast the mouse will move each interval
 #define MOUSE_EMULATION_MOTION_MULTIPLIER 4
 
@@ -42,14 +39,47 @@ SdlInputHandler::findStateForGamepad(SDL_JoystickID id)
         }
     }
 
-    // This should only happen with > 4 gamepads
-    SDL_assert(SDL_NumJoysticks() > 4);
+    // This should only happen with > 4 gamepads, or on the input thread for
+    // events that were queued before the main thread removed the gamepad.
+    SDL_assert(!isOnMainThread() || SDL_NumJoysticks() > 4);
     return nullptr;
 }
 
-void SdlInputHandler::sendGamepadState(GamepadState* state)
+void SdlInputHandler::sendGamepadState(GamepadState* state, bool immediate)
 {
     SDL_assert(m_GamepadMask == 0x1 || m_MultiController);
+
+    // Many SDL events map to identical packets (triggers are quantized to 8 bits),
+    // so don't send anything if the host already has this exact state.
+    if (state->lastSentState.valid &&
+            state->lastSentState.gamepadMask == m_GamepadMask &&
+            state->lastSentState.buttons == state->buttons &&
+            state->lastSentState.lt == state->lt &&
+            state->lastSentState.rt == state->rt &&
+            state->lastSentState.lsX == state->lsX &&
+            state->lastSentState.lsY == state->lsY &&
+            state->lastSentState.rsX == state->rsX &&
+            state->lastSentState.rsY == state->rsY) {
+        state->sendPending = false;
+        m_GamepadPacketsDuplicate++;
+        return;
+    }
+
+    // Analog changes are limited to one packet per send interval. The scheduler
+    // will send the latest state once the interval elapses. Button changes are
+    // always sent immediately, so quick presses are never lost.
+    if (!immediate && m_GamepadSendInterval != 0 && state->lastSentState.valid &&
+            !SDL_TICKS_PASSED(SDL_GetTicks(), state->lastSendTime + m_GamepadSendInterval)) {
+        state->sendPending = true;
+        m_GamepadPacketsDeferred++;
+        return;
+    }
+
+    flushGamepadState(state);
+}
+
+void SdlInputHandler::flushGamepadState(GamepadState* state)
+{
     LiSendMultiControllerEvent(state->index,
                                m_GamepadMask,
                                state->buttons,
@@ -59,12 +89,74 @@ void SdlInputHandler::sendGamepadState(GamepadState* state)
                                state->lsY,
                                state->rsX,
                                state->rsY);
+
+    state->lastSentState.valid = true;
+    state->lastSentState.gamepadMask = m_GamepadMask;
+    state->lastSentState.buttons = state->buttons;
+    state->lastSentState.lt = state->lt;
+    state->lastSentState.rt = state->rt;
+    state->lastSentState.lsX = state->lsX;
+    state->lastSentState.lsY = state->lsY;
+    state->lastSentState.rsX = state->rsX;
+    state->lastSentState.rsY = state->rsY;
+    state->lastSendTime = SDL_GetTicks();
+    state->sendPending = false;
+    m_GamepadPacketsSent++;
+}
+
+Uint32 SdlInputHandler::runGamepadScheduler()
+{
+    Uint32 now = SDL_GetTicks();
+    Uint32 nextDeadline = SDL_MAX_UINT32;
+
+    QMutexLocker locker(&m_GamepadStateLock);
+
+    for (int i = 0; i < MAX_GAMEPADS; i++) {
+        GamepadState* state = &m_GamepadState[i];
+
+        if (state->controller == nullptr) {
+            continue;
+        }
+
+        // Deliver the latest state for gamepads that were rate limited
+        if (state->sendPending) {
+            if (state->mouseEmulationActive) {
+                state->sendPending = false;
+            }
+            else if (SDL_TICKS_PASSED(now, state->lastSendTime + m_GamepadSendInterval)) {
+                flushGamepadState(state);
+            }
+            else {
+                nextDeadline = qMin(nextDeadline, state->lastSendTime + m_GamepadSendInterval - now);
+            }
+        }
+
+        if (state->mouseEmulationActive) {
+            if (SDL_TICKS_PASSED(now, state->nextMouseEmulationTime)) {
+                sendMouseEmulationMotion(state);
+                state->nextMouseEmulationTime = now + MOUSE_EMULATION_POLLING_INTERVAL;
+            }
+
+            nextDeadline = qMin(nextDeadline, state->nextMouseEmulationTime - now);
+        }
+    }
+
+    return nextDeadline;
 }
 
-Uint32 SdlInputHandler::mouseEmulationTimerCallback(Uint32 interval, void *param)
+Uint32 SdlInputHandler::gamepadSchedulerTimerCallback(Uint32 interval, void* param)
 {
-    auto gamepad = reinterpret_cast<GamepadState*>(param);
+    auto me = reinterpret_cast<SdlInputHandler*>(param);
 
+    // This is only used if we couldn't start the input thread. Rate limiting
+    // is disabled in that case, so we only have mouse emulation to drive.
+    me->runGamepadScheduler();
+
+    return interval;
+}
+
+void SdlInputHandler::sendMouseEmulationMotion(GamepadState* gamepad)
+{
     short rawX;
     short rawY;
 
@@ -92,51 +184,62 @@ Uint32 SdlInputHandler::mouseEmulationTimerCallback(Uint32 interval, void *param
     if (deltaX != 0 || deltaY != 0) {
         LiSendMouseMoveEvent((short)deltaX, (short)deltaY);
     }
+}
 
-    return interval;
+bool SdlInputHandler::updateControllerAxisState(GamepadState* state, SDL_ControllerAxisEvent* event)
+{
+    switch (event->axis)
+    {
+        case SDL_CONTROLLER_AXIS_LEFTX:
+            state->lsX = event->value;
+            break;
+        case SDL_CONTROLLER_AXIS_LEFTY:
+            // Signed values have one more negative value than
+            // positive value, so inverting the sign on -32768
+            // could actually cause the value to overflow and
+            // wrap around to be negative again. Avoid that by
+            // capping the value at 32767.
+            state->lsY = -qMax(event->value, (short)-32767);
+            break;
+        case SDL_CONTROLLER_AXIS_RIGHTX:
+            state->rsX = event->value;
+            break;
+        case SDL_CONTROLLER_AXIS_RIGHTY:
+            state->rsY = -qMax(event->value, (short)-32767);
+            break;
+        case SDL_CONTROLLER_AXIS_TRIGGERLEFT:
+            state->lt = (unsigned char)(event->value * 255UL / 32767);
+            break;
+        case SDL_CONTROLLER_AXIS_TRIGGERRIGHT:
+            state->rt = (unsigned char)(event->value * 255UL / 32767);
+            break;
+        default:
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Unhandled controller axis: %d",
+                        event->axis);
+            return false;
+    }
+
+    return true;
 }
 
 void SdlInputHandler::handleControllerAxisEvent(SDL_ControllerAxisEvent* event)
 {
+    QMutexLocker locker(&m_GamepadStateLock);
+
     SDL_JoystickID gameControllerId = event->which;
     GamepadState* state = findStateForGamepad(gameControllerId);
     if (state == NULL) {
         return;
     }
 
-    // Batch all pending axis motion events for this gamepad to save CPU time
+    // Batch all pending axis motion events for this gamepad to save CPU time.
+    // This only applies when input is handled on the main thread. The input
+    // thread batches from its own queue in dispatchInputEvents().
     SDL_Event nextEvent;
     for (;;) {
-        switch (event->axis)
-        {
-            case SDL_CONTROLLER_AXIS_LEFTX:
-                state->lsX = event->value;
-                break;
-            case SDL_CONTROLLER_AXIS_LEFTY:
-                // Signed values have one more negative value than
-                // positive value, so inverting the sign on -32768
-                // could actually cause the value to overflow and
-                // wrap around to be negative again. Avoid that by
-                // capping the value at 32767.
-                state->lsY = -qMax(event->value, (short)-32767);
-                break;
-            case SDL_CONTROLLER_AXIS_RIGHTX:
-                state->rsX = event->value;
-                break;
-            case SDL_CONTROLLER_AXIS_RIGHTY:
-                state->rsY = -qMax(event->value, (short)-32767);
-                break;
-            case SDL_CONTROLLER_AXIS_TRIGGERLEFT:
-                state->lt = (unsigned char)(event->value * 255UL / 32767);
-                break;
-            case SDL_CONTROLLER_AXIS_TRIGGERRIGHT:
-                state->rt = (unsigned char)(event->value * 255UL / 32767);
-                break;
-            default:
-                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                            "Unhandled controller axis: %d",
-                            event->axis);
-                return;
+        if (!updateControllerAxisState(state, event)) {
+            return;
         }
 
         // Check for another event to batch with
@@ -155,13 +258,15 @@ void SdlInputHandler::handleControllerAxisEvent(SDL_ControllerAxisEvent* event)
     }
 
     // Only send the gamepad state to the host if it's not in mouse emulation mode
-    if (state->mouseEmulationTimer == 0) {
-        sendGamepadState(state);
+    if (!state->mouseEmulationActive) {
+        sendGamepadState(state, false);
     }
 }
 
 void SdlInputHandler::handleControllerButtonEvent(SDL_ControllerButtonEvent* event)
 {
+    QMutexLocker locker(&m_GamepadStateLock);
+
     GamepadState* state = findStateForGamepad(event->which);
     if (state == NULL) {
         return;
@@ -190,7 +295,7 @@ void SdlInputHandler::handleControllerButtonEvent(SDL_ControllerButtonEvent* eve
         if (event->button == SDL_CONTROLLER_BUTTON_START) {
             state->lastStartDownTime = SDL_GetTicks();
         }
-        else if (state->mouseEmulationTimer != 0) {
+        else if (state->mouseEmulationActive) {
             if (event->button == SDL_CONTROLLER_BUTTON_A) {
                 LiSendMouseButtonEvent(BUTTON_ACTION_PRESS, BUTTON_LEFT);
             }
@@ -219,27 +324,28 @@ void SdlInputHandler::handleControllerButtonEvent(SDL_ControllerButtonEvent* eve
 
         if (event->button == SDL_CONTROLLER_BUTTON_START) {
             if (SDL_GetTicks() - state->lastStartDownTime > MOUSE_EMULATION_LONG_PRESS_TIME) {
-                if (state->mouseEmulationTimer != 0) {
-                    SDL_RemoveTimer(state->mouseEmulationTimer);
-                    state->mouseEmulationTimer = 0;
+                if (state->mouseEmulationActive) {
+                    state->mouseEmulationActive = false;
 
                     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                                 "Mouse emulation deactivated");
-                    Session::get()->notifyMouseEmulationMode(false);
+                    notifyMouseEmulationMode(false);
                 }
                 else if (m_GamepadMouse) {
                     // Send the start button up event to the host, since we won't do it below
-                    sendGamepadState(state);
+                    sendGamepadState(state, true);
 
-                    state->mouseEmulationTimer = SDL_AddTimer(MOUSE_EMULATION_POLLING_INTERVAL, SdlInputHandler::mouseEmulationTimerCallback, state);
+                    // The gamepad scheduler will start sending mouse motion
+                    state->mouseEmulationActive = true;
+                    state->nextMouseEmulationTime = SDL_GetTicks() + MOUSE_EMULATION_POLLING_INTERVAL;
 
                     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                                 "Mouse emulation active");
-                    Session::get()->notifyMouseEmulationMode(true);
+                    notifyMouseEmulationMode(true);
                 }
             }
         }
-        else if (state->mouseEmulationTimer != 0) {
+        else if (state->mouseEmulationActive) {
             if (event->button == SDL_CONTROLLER_BUTTON_A) {
                 LiSendMouseButtonEvent(BUTTON_ACTION_RELEASE, BUTTON_LEFT);
             }
@@ -272,6 +378,10 @@ void SdlInputHandler::handleControllerButtonEvent(SDL_ControllerButtonEvent* eve
         // Clear buttons down on this gamepad
         LiSendMultiControllerEvent(state->index, m_GamepadMask,
                                    0, 0, 0, 0, 0, 0, 0);
+
+        // The host no longer has our last sent state
+        state->lastSentState.valid = false;
+        state->sendPending = false;
         return;
     }
 
@@ -280,19 +390,22 @@ void SdlInputHandler::handleControllerButtonEvent(SDL_ControllerButtonEvent* eve
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                     "Detected stats toggle gamepad combo");
 
-        // Toggle the stats overlay
-        Session::get()->getOverlayManager().setOverlayState(Overlay::OverlayDebug,
-                                                            !Session::get()->getOverlayManager().isOverlayEnabled(Overlay::OverlayDebug));
+        // Toggle the stats overlay on the main thread, like the keyboard combo
+        requestSpecialKeyCombo(KeyComboToggleStatsOverlay);
 
         // Clear buttons down on this gamepad
         LiSendMultiControllerEvent(state->index, m_GamepadMask,
                                    0, 0, 0, 0, 0, 0, 0);
+
+        // The host no longer has our last sent state
+        state->lastSentState.valid = false;
+        state->sendPending = false;
         return;
     }
 
     // Only send the gamepad state to the host if it's not in mouse emulation mode
-    if (state->mouseEmulationTimer == 0) {
-        sendGamepadState(state);
+    if (!state->mouseEmulationActive) {
+        sendGamepadState(state, true);
     }
 }
 
@@ -300,6 +413,12 @@ void SdlInputHandler::handleControllerDeviceEvent(SDL_ControllerDeviceEvent* eve
 {
     GamepadState* state;
 
+    // Device events are always handled on the main thread, because opening
+    // and closing gamepads isn't safe elsewhere. The input thread may be
+    // using this state at the same time.
+    SDL_assert(isOnMainThread());
+    QMutexLocker locker(&m_GamepadStateLock);
+
     if (event->type == SDL_CONTROLLERDEVICEADDED) {
         int i;
         const char* name;
@@ -422,14 +541,13 @@ void SdlInputHandler::handleControllerDeviceEvent(SDL_ControllerDeviceEvent* eve
         }
 
         // Send an empty event to tell the PC we've arrived
-        sendGamepadState(state);
+        sendGamepadState(state, true);
     }
     else if (event->type == SDL_CONTROLLERDEVICEREMOVED) {
         state = findStateForGamepad(event->which);
         if (state != NULL) {
-            if (state->mouseEmulationTimer != 0) {
-                Session::get()->notifyMouseEmulationMode(false);
-                SDL_RemoveTimer(state->mouseEmulationTimer);
+            if (state->mouseEmulationActive) {
+                notifyMouseEmulationMode(false);
             }
 
             SDL_GameControllerClose(state->controller);
@@ -499,6 +617,8 @@ void SdlInputHandler::rumble(unsigned short controllerNumber, unsigned short low
         return;
     }
 
+    QMutexLocker locker(&m_GamepadStateLock);
+
 #if SDL_VERSION_ATLEAST(2, 0, 9)
     if (m_GamepadState[controllerNumber].controller != nullptr) {
         SDL_GameControllerRumble(m_GamepadState[controllerNumber].controller, lowFreqMotor, highFreqMotor, 30000);
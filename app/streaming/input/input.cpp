@@ -11,13 +11,22 @@
 
 #define MOUSE_POLLING_INTERVAL 5
 
+// Minimum time between analog-only gamepad state updates sent to the host
+#define GAMEPAD_SEND_INTERVAL 4
+
 SdlInputHandler::SdlInputHandler(StreamingPreferences& prefs, NvComputer*, int streamWidth, int streamHeight)
-    : m_MultiController(prefs.multiController),
+    : m_Window(nullptr),
+      m_MultiController(prefs.multiController),
       m_GamepadMouse(prefs.gamepadMouse),
       m_SwapMouseButtons(prefs.swapMouseButtons),
       m_ReverseScrollDirection(prefs.reverseScrollDirection),
       m_SwapFaceButtons(prefs.swapFaceButtons),
       m_MouseMoveTimer(0),
+      m_GamepadSendInterval(GAMEPAD_SEND_INTERVAL),
+      m_GamepadSchedulerTimer(0),
+      m_GamepadPacketsSent(0),
+      m_GamepadPacketsDuplicate(0),
+      m_GamepadPacketsDeferred(0),
       m_MousePositionLock(0),
       m_MouseWasInVideoRegion(false),
       m_PendingMouseButtonsAllUpOnVideoRegionLeave(false),
@@ -27,13 +36,19 @@ SdlInputHandler::SdlInputHandler(StreamingPreferences& prefs, NvComputer*, int s
       m_LongPressTimer(0),
       m_StreamWidth(streamWidth),
       m_StreamHeight(streamHeight),
-      m_AbsoluteMouseMode(prefs.absoluteMouseMode),
       m_AbsoluteTouchMode(prefs.absoluteTouchMode),
       m_LeftButtonReleaseTimer(0),
       m_RightButtonReleaseTimer(0),
       m_DragTimer(0),
       m_DragButton(0),
-      m_NumFingersDown(0)
+      m_NumFingersDown(0),
+      m_InputThread(nullptr),
+      m_InputThreadStopping(false),
+      m_InputFilterInstalled(false),
+      m_InputEventsQueued(0),
+      m_InputEventsCoalesced(0),
+      m_MainThreadId(SDL_ThreadID()),
+      m_WindowStateLock(0)
 {
     // System keys are always captured when running without a DE
     if (!WMUtils::isRunningDesktopEnvironment()) {
@@ -132,6 +147,11 @@ SdlInputHandler::SdlInputHandler(StreamingPreferences& prefs, NvComputer*, int s
     SDL_SetHint(SDL_HINT_GAMECONTROLLER_IGNORE_DEVICES, streamIgnoreDevices.toUtf8());
     SDL_SetHint(SDL_HINT_GAMECONTROLLER_IGNORE_DEVICES_EXCEPT, streamIgnoreDevicesExcept.toUtf8());
 
+    // Route mouse, gamepad, and touch events to our input thread as they are
+    // pumped, so they don't wait behind rendering or decoder resets on the
+    // main thread. Events captured before the thread starts will be queued.
+    installInputEventFilter();
+
     // We must initialize joystick explicitly before gamecontroller in order
     // to ensure we receive gamecontroller attach events for gamepads where
     // SDL doesn't have a built-in mapping. By starting joystick first, we
@@ -181,10 +201,17 @@ SdlInputHandler::SdlInputHandler(StreamingPreferences& prefs, NvComputer*, int s
     SDL_zero(m_LastTouchUpEvent);
     SDL_zero(m_TouchDownEvent);
     SDL_zero(m_MousePositionReport);
+    SDL_zero(m_WindowState);
 
+    SDL_AtomicSet(&m_AbsoluteMouseMode, prefs.absoluteMouseMode ? 1 : 0);
+    SDL_AtomicSet(&m_CaptureActive, 0);
+    SDL_AtomicSet(&m_MouseButtonState, 0);
+    SDL_AtomicSet(&m_MouseX, 0);
+    SDL_AtomicSet(&m_MouseY, 0);
     SDL_AtomicSet(&m_MouseDeltaX, 0);
     SDL_AtomicSet(&m_MouseDeltaY, 0);
     SDL_AtomicSet(&m_MousePositionUpdated, 0);
+    SDL_AtomicSet(&m_InputActivityPending, 0);
 
     Uint32 pollingInterval = QString(qgetenv("MOUSE_POLLING_INTERVAL")).toUInt();
     if (pollingInterval == 0) {
@@ -197,14 +224,37 @@ SdlInputHandler::SdlInputHandler(StreamingPreferences& prefs, NvComputer*, int s
     }
 
     m_MouseMoveTimer = SDL_AddTimer(pollingInterval, SdlInputHandler::mouseMoveTimerCallback, this);
+
+    bool sendIntervalOk;
+    int sendInterval = qEnvironmentVariableIntValue("GAMEPAD_SEND_INTERVAL", &sendIntervalOk);
+    if (sendIntervalOk && sendInterval >= 0) {
+        // Zero is allowed here to disable rate limiting entirely
+        m_GamepadSendInterval = sendInterval;
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Using custom gamepad send interval: %u ms",
+                    m_GamepadSendInterval);
+    }
+
+    // Now that our state is initialized, start draining the input queue
+    startInputThread();
 }
 
 SdlInputHandler::~SdlInputHandler()
 {
+    // Stop the input thread before we tear down the state it uses
+    stopInputThread();
+    SDL_RemoveTimer(m_GamepadSchedulerTimer);
+    m_GamepadSchedulerTimer = 0;
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Gamepad packets: %d sent, %d duplicates suppressed, %d rate limited",
+                m_GamepadPacketsSent,
+                m_GamepadPacketsDuplicate,
+                m_GamepadPacketsDeferred);
+
     for (int i = 0; i < MAX_GAMEPADS; i++) {
-        if (m_GamepadState[i].mouseEmulationTimer != 0) {
-            Session::get()->notifyMouseEmulationMode(false);
-            SDL_RemoveTimer(m_GamepadState[i].mouseEmulationTimer);
+        if (m_GamepadState[i].mouseEmulationActive) {
+            notifyMouseEmulationMode(false);
         }
 #if !SDL_VERSION_ATLEAST(2, 0, 9)
         if (m_GamepadState[i].haptic != nullptr) {
@@ -251,11 +301,61 @@ SdlInputHandler::~SdlInputHandler()
 
 void SdlInputHandler::setWindow(SDL_Window *window)
 {
+    int mouseX, mouseY;
+
     m_Window = window;
+    updateWindowState();
+
+    // Seed our tracked mouse position until the first mouse event arrives
+    SDL_GetMouseState(&mouseX, &mouseY);
+    SDL_AtomicSet(&m_MouseX, mouseX);
+    SDL_AtomicSet(&m_MouseY, mouseY);
+}
+
+void SdlInputHandler::updateWindowState()
+{
+    int width = 0, height = 0;
+    Uint32 flags = 0;
+
+    // This must only be called on the main thread
+    SDL_assert(isOnMainThread());
+
+    if (m_Window != nullptr) {
+        SDL_GetWindowSize(m_Window, &width, &height);
+        flags = SDL_GetWindowFlags(m_Window);
+    }
+
+    SDL_AtomicLock(&m_WindowStateLock);
+    m_WindowState.width = width;
+    m_WindowState.height = height;
+    m_WindowState.flags = flags;
+    SDL_AtomicUnlock(&m_WindowStateLock);
+}
+
+void SdlInputHandler::getWindowState(int* width, int* height, Uint32* flags)
+{
+    SDL_AtomicLock(&m_WindowStateLock);
+    if (width != nullptr) {
+        *width = m_WindowState.width;
+    }
+    if (height != nullptr) {
+        *height = m_WindowState.height;
+    }
+    if (flags != nullptr) {
+        *flags = m_WindowState.flags;
+    }
+    SDL_AtomicUnlock(&m_WindowStateLock);
+}
+
+bool SdlInputHandler::isOnMainThread()
+{
+    return SDL_ThreadID() == m_MainThreadId;
 }
 
 void SdlInputHandler::raiseAllKeys()
 {
+    QMutexLocker locker(&m_KeysDownLock);
+
     if (m_KeysDown.isEmpty()) {
         return;
     }
@@ -279,7 +379,7 @@ void SdlInputHandler::notifyMouseLeave()
     //
     // On macOS and X11, capturing the mouse allows us to receive mouse motion outside the
     // window (button up already worked without capture).
-    if (m_AbsoluteMouseMode && isCaptureActive()) {
+    if (SDL_AtomicGet(&m_AbsoluteMouseMode) && isCaptureActive()) {
         // NB: Not using SDL_GetGlobalMouseState() because we want our state not the system's
         Uint32 mouseState = SDL_GetMouseState(nullptr, nullptr);
         for (Uint32 button = SDL_BUTTON_LEFT; button <= SDL_BUTTON_X2; button++) {
@@ -297,7 +397,7 @@ void SdlInputHandler::notifyFocusLost()
     // This lets user to interact with our window's title bar and with the buttons in it.
     // Doing this while the window is full-screen breaks the transition out of FS
     // (desktop and exclusive), so we must check for that before releasing mouse capture.
-    if (!(SDL_GetWindowFlags(m_Window) & SDL_WINDOW_FULLSCREEN) && !m_AbsoluteMouseMode) {
+    if (!(SDL_GetWindowFlags(m_Window) & SDL_WINDOW_FULLSCREEN) && !SDL_AtomicGet(&m_AbsoluteMouseMode)) {
         setCaptureActive(false);
     }
 
@@ -308,12 +408,10 @@ void SdlInputHandler::notifyFocusLost()
 
 bool SdlInputHandler::isCaptureActive()
 {
-    if (SDL_GetRelativeMouseMode()) {
-        return true;
-    }
-
-    // Some platforms don't support SDL_SetRelativeMouseMode
-    return m_FakeCaptureActive;
+    // This is set by setCaptureActive() for both SDL's relative mouse mode
+    // and our fake capture on platforms that don't support it. We don't call
+    // SDL_GetRelativeMouseMode() because this is used on the input thread.
+    return SDL_AtomicGet(&m_CaptureActive) != 0;
 }
 
 void SdlInputHandler::updateKeyboardGrabState()
@@ -362,11 +460,10 @@ bool SdlInputHandler::isSystemKeyCaptureActive()
         return false;
     }
 
-    if (m_Window == nullptr) {
-        return false;
-    }
-
-    Uint32 windowFlags = SDL_GetWindowFlags(m_Window);
+    // This is called on the input thread, so we use the published window
+    // state. The flags are zero if we don't have a window yet.
+    Uint32 windowFlags;
+    getWindowState(nullptr, nullptr, &windowFlags);
     if (!(windowFlags & SDL_WINDOW_INPUT_FOCUS)
 #if SDL_VERSION_ATLEAST(2, 0, 15)
             || !(windowFlags & SDL_WINDOW_KEYBOARD_GRABBED)
@@ -399,14 +496,16 @@ void SdlInputHandler::setCaptureActive(bool active)
         }
 
         // If we're in relative mode, try to activate SDL's relative mouse mode
-        if (m_AbsoluteMouseMode || SDL_SetRelativeMouseMode(SDL_TRUE) < 0) {
+        if (SDL_AtomicGet(&m_AbsoluteMouseMode) || SDL_SetRelativeMouseMode(SDL_TRUE) < 0) {
             // Relative mouse mode didn't work or was disabled, so we'll just hide the cursor
             SDL_ShowCursor(m_MouseCursorCapturedVisibilityState);
             m_FakeCaptureActive = true;
         }
 
+        SDL_AtomicSet(&m_CaptureActive, 1);
+
         // Synchronize the client and host cursor when activating absolute capture
-        if (m_AbsoluteMouseMode) {
+        if (SDL_AtomicGet(&m_AbsoluteMouseMode)) {
             int mouseX, mouseY;
             int windowX, windowY;
 
@@ -425,6 +524,8 @@ void SdlInputHandler::setCaptureActive(bool active)
         }
     }
     else {
+        SDL_AtomicSet(&m_CaptureActive, 0);
+
         if (m_FakeCaptureActive) {
             // Display the cursor again
             SDL_ShowCursor(SDL_ENABLE);
@@ -445,6 +546,9 @@ void SdlInputHandler::setCaptureActive(bool active)
 
     // Now update the keyboard grab
     updateKeyboardGrabState();
+
+    // Publish the new mouse grab state for the input thread
+    updateWindowState();
 }
 
 void SdlInputHandler::handleTouchFingerEvent(SDL_TouchFingerEvent* event)
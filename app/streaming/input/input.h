@@ -5,9 +5,17 @@
 
 #include <SDL.h>
 
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
 #define SDL_CODE_HIDE_CURSOR 1
 #define SDL_CODE_SHOW_CURSOR 2
 #define SDL_CODE_UNCAPTURE_MOUSE 3
+#define SDL_CODE_CAPTURE_MOUSE 4
+#define SDL_CODE_SPECIAL_KEY_COMBO 5
+#define SDL_CODE_INPUT_ACTIVITY 6
+#define SDL_CODE_MOUSE_EMULATION_MODE 7
 
 struct GamepadState {
     SDL_GameController* controller;
@@ -20,16 +28,32 @@ struct GamepadState {
     int hapticEffectId;
 #endif
 
-    SDL_TimerID mouseEmulationTimer;
+    bool mouseEmulationActive;
+    uint32_t nextMouseEmulationTime;
     uint32_t lastStartDownTime;
 
     short buttons;
     short lsX, lsY;
     short rsX, rsY;
     unsigned char lt, rt;
+
+    // Last state sent to the host, used to suppress duplicate packets
+    struct {
+        bool valid;
+        int gamepadMask;
+        short buttons;
+        short lsX, lsY;
+        short rsX, rsY;
+        unsigned char lt, rt;
+    } lastSentState;
+    uint32_t lastSendTime;
+    bool sendPending;
 };
 
 #define MAX_GAMEPADS 4
+
+// How long between polling the gamepad to send virtual mouse input
+#define MOUSE_EMULATION_POLLING_INTERVAL 50
 #define MAX_FINGERS 2
 
 #define GAMEPAD_HAPTIC_METHOD_NONE 0
@@ -93,6 +117,12 @@ public:
 
     void updateKeyboardGrabState();
 
+    void updateWindowState();
+
+    void handleSpecialKeyComboEvent(SDL_UserEvent* event);
+
+    void handleInputActivityEvent(SDL_UserEvent* event);
+
     static
     QString getUnmappedGamepads();
 
@@ -112,7 +142,37 @@ private:
     GamepadState*
     findStateForGamepad(SDL_JoystickID id);
 
-    void sendGamepadState(GamepadState* state);
+    void sendGamepadState(GamepadState* state, bool immediate);
+
+    void flushGamepadState(GamepadState* state);
+
+    Uint32 runGamepadScheduler();
+
+    bool updateControllerAxisState(GamepadState* state, SDL_ControllerAxisEvent* event);
+
+    void installInputEventFilter();
+
+    void detachInputEventFilter();
+
+    void startInputThread();
+
+    void stopInputThread();
+
+    bool coalesceInputEvent(const SDL_Event* event);
+
+    void dispatchInputEvents(QQueue<SDL_Event>& events);
+
+    static
+    bool isThreadedInputEvent(Uint32 type);
+
+    static
+    bool isCoalescableInputEvent(Uint32 type);
+
+    static
+    int SDLCALL inputEventFilter(void* userdata, SDL_Event* event);
+
+    static
+    int inputThreadProc(void* context);
 
     void handleAbsoluteFingerEvent(SDL_TouchFingerEvent* event);
 
@@ -120,6 +180,16 @@ private:
 
     void performSpecialKeyCombo(KeyCombo combo);
 
+    void requestSpecialKeyCombo(KeyCombo combo);
+
+    void notifyInputActivity();
+
+    void notifyMouseEmulationMode(bool enabled);
+
+    void getWindowState(int* width, int* height, Uint32* flags);
+
+    bool isOnMainThread();
+
     static
     Uint32 longPressTimerCallback(Uint32 interval, void* param);
 
@@ -127,7 +197,10 @@ private:
     Uint32 mouseMoveTimerCallback(Uint32 interval, void* param);
 
     static
-    Uint32 mouseEmulationTimerCallback(Uint32 interval, void* param);
+    void sendMouseEmulationMotion(GamepadState* gamepad);
+
+    static
+    Uint32 gamepadSchedulerTimerCallback(Uint32 interval, void* param);
 
     static
     Uint32 releaseLeftButtonTimerCallback(Uint32 interval, void* param);
@@ -159,6 +232,11 @@ private:
 
     int m_GamepadMask;
     GamepadState m_GamepadState[MAX_GAMEPADS];
+    Uint32 m_GamepadSendInterval;
+    SDL_TimerID m_GamepadSchedulerTimer;
+    int m_GamepadPacketsSent;
+    int m_GamepadPacketsDuplicate;
+    int m_GamepadPacketsDeferred;
     QSet<short> m_KeysDown;
     bool m_FakeCaptureActive;
     QString m_OldIgnoreDevices;
@@ -178,7 +256,7 @@ private:
     SDL_TimerID m_LongPressTimer;
     int m_StreamWidth;
     int m_StreamHeight;
-    bool m_AbsoluteMouseMode;
+    SDL_atomic_t m_AbsoluteMouseMode;
     bool m_AbsoluteTouchMode;
 
     SDL_TouchFingerEvent m_TouchDownEvent[MAX_FINGERS];
@@ -188,5 +266,48 @@ private:
     char m_DragButton;
     int m_NumFingersDown;
 
+    SDL_Thread* m_InputThread;
+    QMutex m_InputQueueLock;
+    QWaitCondition m_InputQueueNotEmpty;
+    QQueue<SDL_Event> m_InputQueue;
+    bool m_InputThreadStopping;
+    bool m_InputFilterInstalled;
+    int m_InputEventsQueued;
+    int m_InputEventsCoalesced;
+    SDL_threadID m_MainThreadId;
+
+    // Set while an SDL_CODE_INPUT_ACTIVITY event is waiting for the main
+    // thread, so a burst of input wakes it only once
+    SDL_atomic_t m_InputActivityPending;
+
+    // Guards gamepad state shared by the input thread and the main thread,
+    // which handles device arrival and removal
+    QMutex m_GamepadStateLock;
+
+    // Guards m_KeysDown, since raiseAllKeys() is called on the main thread
+    QMutex m_KeysDownLock;
+
+    // Published by the main thread so the input thread never has to call
+    // SDL video functions or touch m_Window
+    SDL_SpinLock m_WindowStateLock;
+    struct {
+        int width, height;
+        Uint32 flags;
+    } m_WindowState;
+    SDL_atomic_t m_CaptureActive;
+
+    // Tracked from the mouse events we handle, rather than using
+    // SDL_GetMouseState() off the main thread
+    SDL_atomic_t m_MouseButtonState;
+    SDL_atomic_t m_MouseX;
+    SDL_atomic_t m_MouseY;
+
+    // The event filter stays installed once set, because removing it
+    // with SDL_SetEventFilter() discards every pending event
+    static QMutex s_InputFilterLock;
+    static SdlInputHandler* s_InputFilterTarget;
+    static SDL_EventFilter s_OldEventFilter;
+    static void* s_OldEventFilterUserdata;
+
     static const int k_ButtonMap[];
 };
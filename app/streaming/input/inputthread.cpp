@@ -0,0 +1,369 @@
+#include "streaming/session.h"
+
+#include <Limelight.h>
+#include <SDL.h>
+
+QMutex SdlInputHandler::s_InputFilterLock;
+SdlInputHandler* SdlInputHandler::s_InputFilterTarget;
+SDL_EventFilter SdlInputHandler::s_OldEventFilter;
+void* SdlInputHandler::s_OldEventFilterUserdata;
+
+bool SdlInputHandler::isThreadedInputEvent(Uint32 type)
+{
+    switch (type) {
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+    case SDL_MOUSEMOTION:
+    case SDL_MOUSEWHEEL:
+    case SDL_CONTROLLERAXISMOTION:
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP:
+        return true;
+    default:
+        // Gamepad arrival and removal stay on the main thread, since opening
+        // and closing gamepads isn't safe elsewhere. Touch events also stay
+        // on the main thread because our touch handlers query SDL's live
+        // finger state, which is only consistent on the thread pumping events.
+        return false;
+    }
+}
+
+bool SdlInputHandler::isCoalescableInputEvent(Uint32 type)
+{
+    switch (type) {
+    case SDL_MOUSEMOTION:
+    case SDL_MOUSEWHEEL:
+    case SDL_CONTROLLERAXISMOTION:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void SdlInputHandler::installInputEventFilter()
+{
+    SDL_EventFilter filter;
+    void* userdata;
+
+    SDL_assert(!m_InputFilterInstalled);
+
+    // Our filter stays installed after the first session, because removing it
+    // would discard all pending events (including a pending SDL_QUIT). It's
+    // reset if the SDL events subsystem is shut down.
+    SDL_GetEventFilter(&filter, &userdata);
+    if (filter != SdlInputHandler::inputEventFilter) {
+        // NB: SDL_SetEventFilter() discards all pending events, so this must
+        // be called before we initialize the joystick and gamecontroller
+        // subsystems that generate our initial gamepad arrival events.
+        s_OldEventFilter = filter;
+        s_OldEventFilterUserdata = userdata;
+        SDL_SetEventFilter(SdlInputHandler::inputEventFilter, nullptr);
+    }
+
+    s_InputFilterLock.lock();
+    SDL_assert(s_InputFilterTarget == nullptr);
+    s_InputFilterTarget = this;
+    s_InputFilterLock.unlock();
+
+    m_InputFilterInstalled = true;
+}
+
+void SdlInputHandler::detachInputEventFilter()
+{
+    if (!m_InputFilterInstalled) {
+        return;
+    }
+
+    // Once this returns, no further events can be delivered to our queue.
+    // The filter passes everything through to the main loop until the next
+    // SdlInputHandler is created.
+    s_InputFilterLock.lock();
+    SDL_assert(s_InputFilterTarget == this);
+    s_InputFilterTarget = nullptr;
+    s_InputFilterLock.unlock();
+
+    m_InputFilterInstalled = false;
+}
+
+void SdlInputHandler::startInputThread()
+{
+    if (!m_InputFilterInstalled) {
+        return;
+    }
+
+    m_InputThread = SDL_CreateThread(SdlInputHandler::inputThreadProc, "InputHandler", this);
+    if (m_InputThread == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to create input thread: %s",
+                     SDL_GetError());
+
+        // Fall back to handling input on the main thread. We must push back
+        // any events we've captured so far, since nobody will drain them.
+        detachInputEventFilter();
+
+        while (!m_InputQueue.isEmpty()) {
+            SDL_Event event = m_InputQueue.dequeue();
+            SDL_PushEvent(&event);
+        }
+
+        // Drive mouse emulation from an SDL timer instead. Without the input
+        // thread, there's nobody to deliver rate limited gamepad state, so we
+        // must send all gamepad updates immediately.
+        m_GamepadSendInterval = 0;
+        m_GamepadSchedulerTimer = SDL_AddTimer(MOUSE_EMULATION_POLLING_INTERVAL,
+                                               SdlInputHandler::gamepadSchedulerTimerCallback,
+                                               this);
+    }
+}
+
+void SdlInputHandler::stopInputThread()
+{
+    detachInputEventFilter();
+
+    if (m_InputThread != nullptr) {
+        m_InputQueueLock.lock();
+        m_InputThreadStopping = true;
+        m_InputQueueNotEmpty.wakeOne();
+        m_InputQueueLock.unlock();
+
+        SDL_WaitThread(m_InputThread, nullptr);
+        m_InputThread = nullptr;
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Input thread received %d events (%d coalesced)",
+                    m_InputEventsQueued,
+                    m_InputEventsCoalesced);
+    }
+}
+
+// Must be called with m_InputQueueLock held
+bool SdlInputHandler::coalesceInputEvent(const SDL_Event* event)
+{
+    if (!isCoalescableInputEvent(event->type)) {
+        return false;
+    }
+
+    // Walk back from the tail of the queue looking for a pending event with the same
+    // source that we can merge into. Any event that isn't coalescable (like a key or
+    // button press) is a barrier, so motion is never reordered across it.
+    for (int i = m_InputQueue.size() - 1; i >= 0; i--) {
+        SDL_Event& queued = m_InputQueue[i];
+
+        if (!isCoalescableInputEvent(queued.type)) {
+            return false;
+        }
+        else if (queued.type != event->type) {
+            continue;
+        }
+
+        switch (event->type) {
+        case SDL_MOUSEMOTION:
+            if (queued.motion.which != event->motion.which) {
+                continue;
+            }
+
+            // Keep the latest absolute position and accumulate relative motion
+            queued.motion.timestamp = event->motion.timestamp;
+            queued.motion.state = event->motion.state;
+            queued.motion.x = event->motion.x;
+            queued.motion.y = event->motion.y;
+            queued.motion.xrel += event->motion.xrel;
+            queued.motion.yrel += event->motion.yrel;
+            break;
+
+        case SDL_MOUSEWHEEL:
+            if (queued.wheel.which != event->wheel.which ||
+                    queued.wheel.direction != event->wheel.direction) {
+                continue;
+            }
+
+            queued.wheel.timestamp = event->wheel.timestamp;
+            queued.wheel.x += event->wheel.x;
+            queued.wheel.y += event->wheel.y;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+            queued.wheel.preciseX += event->wheel.preciseX;
+            queued.wheel.preciseY += event->wheel.preciseY;
+#endif
+            break;
+
+        case SDL_CONTROLLERAXISMOTION:
+            if (queued.caxis.which != event->caxis.which ||
+                    queued.caxis.axis != event->caxis.axis) {
+                continue;
+            }
+
+            // Only the latest axis value matters
+            queued.caxis.timestamp = event->caxis.timestamp;
+            queued.caxis.value = event->caxis.value;
+            break;
+
+        default:
+            SDL_assert(false);
+            return false;
+        }
+
+        m_InputEventsCoalesced++;
+        return true;
+    }
+
+    return false;
+}
+
+int SdlInputHandler::inputEventFilter(void*, SDL_Event* event)
+{
+    // Give any previously installed filter the first look
+    if (s_OldEventFilter != nullptr && !s_OldEventFilter(s_OldEventFilterUserdata, event)) {
+        return 0;
+    }
+
+    if (!isThreadedInputEvent(event->type)) {
+        // Let the main thread handle this event
+        return 1;
+    }
+
+    // This filter may be invoked on any thread that is pushing events.
+    // Holding s_InputFilterLock keeps the handler alive while we queue.
+    QMutexLocker locker(&s_InputFilterLock);
+    SdlInputHandler* me = s_InputFilterTarget;
+    if (me == nullptr) {
+        // No input thread, so the main loop handles this event
+        return 1;
+    }
+
+    me->m_InputQueueLock.lock();
+    me->m_InputEventsQueued++;
+    if (!me->coalesceInputEvent(event)) {
+        me->m_InputQueue.enqueue(*event);
+        me->m_InputQueueNotEmpty.wakeOne();
+    }
+    me->m_InputQueueLock.unlock();
+
+    // Drop the event from the SDL event queue
+    return 0;
+}
+
+int SdlInputHandler::inputThreadProc(void* context)
+{
+    auto me = reinterpret_cast<SdlInputHandler*>(context);
+    QQueue<SDL_Event> events;
+    bool stopping;
+
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+
+    do {
+        // The input thread also acts as the scheduler for rate limited
+        // gamepad updates and mouse emulation, so we wake up early for those.
+        Uint32 timeout = me->runGamepadScheduler();
+
+        me->m_InputQueueLock.lock();
+        if (me->m_InputQueue.isEmpty() && !me->m_InputThreadStopping) {
+            me->m_InputQueueNotEmpty.wait(&me->m_InputQueueLock,
+                                          timeout == SDL_MAX_UINT32 ? ULONG_MAX : timeout);
+        }
+
+        // Take the whole batch so producers aren't blocked while we dispatch
+        events.swap(me->m_InputQueue);
+        stopping = me->m_InputThreadStopping;
+        me->m_InputQueueLock.unlock();
+
+        me->dispatchInputEvents(events);
+    } while (!stopping);
+
+    return 0;
+}
+
+void SdlInputHandler::dispatchInputEvents(QQueue<SDL_Event>& events)
+{
+    while (!events.isEmpty()) {
+        SDL_Event event = events.dequeue();
+
+        switch (event.type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            notifyInputActivity();
+            handleKeyEvent(&event.key);
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            notifyInputActivity();
+            handleMouseButtonEvent(&event.button);
+            break;
+        case SDL_MOUSEMOTION:
+            handleMouseMotionEvent(&event.motion);
+            break;
+        case SDL_MOUSEWHEEL:
+            handleMouseWheelEvent(&event.wheel);
+            break;
+        case SDL_CONTROLLERAXISMOTION:
+        {
+            QMutexLocker locker(&m_GamepadStateLock);
+
+            GamepadState* state = findStateForGamepad(event.caxis.which);
+            if (state == nullptr) {
+                break;
+            }
+
+            // Batch consecutive axis events for this gamepad into a single update
+            bool updated = updateControllerAxisState(state, &event.caxis);
+            while (!events.isEmpty() &&
+                   events.head().type == SDL_CONTROLLERAXISMOTION &&
+                   events.head().caxis.which == event.caxis.which) {
+                SDL_Event nextEvent = events.dequeue();
+                updated |= updateControllerAxisState(state, &nextEvent.caxis);
+            }
+
+            // Only send the gamepad state to the host if it's not in mouse emulation mode
+            if (updated && !state->mouseEmulationActive) {
+                sendGamepadState(state, false);
+            }
+            break;
+        }
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP:
+            notifyInputActivity();
+            handleControllerButtonEvent(&event.cbutton);
+            break;
+        default:
+            SDL_assert(false);
+            break;
+        }
+    }
+}
+
+void SdlInputHandler::notifyInputActivity()
+{
+    // The main loop runs the rich presence callbacks when it sees input. Only
+    // post a new event once the main thread has picked up the last one.
+    if (SDL_AtomicCAS(&m_InputActivityPending, 0, 1)) {
+        SDL_Event event;
+        event.type = SDL_USEREVENT;
+        event.user.code = SDL_CODE_INPUT_ACTIVITY;
+        SDL_PushEvent(&event);
+    }
+}
+
+void SdlInputHandler::handleInputActivityEvent(SDL_UserEvent* event)
+{
+    SDL_assert(event->code == SDL_CODE_INPUT_ACTIVITY);
+    SDL_AtomicSet(&m_InputActivityPending, 0);
+}
+
+void SdlInputHandler::notifyMouseEmulationMode(bool enabled)
+{
+    if (isOnMainThread() && m_InputThread == nullptr) {
+        Session::get()->notifyMouseEmulationMode(enabled);
+    }
+    else {
+        // The notification updates the overlays, which are only safe to
+        // change from the main thread. While the input thread is running,
+        // the main thread's own notifications are queued too, so they stay
+        // ordered after any the input thread has already posted.
+        SDL_Event event;
+        event.type = SDL_USEREVENT;
+        event.user.code = SDL_CODE_MOUSE_EMULATION_MODE;
+        event.user.data1 = (void*)(intptr_t)enabled;
+        SDL_PushEvent(&event);
+    }
+}
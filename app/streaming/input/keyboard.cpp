@@ -66,7 +66,7 @@ void SdlInputHandler::performSpecialKeyCombo(KeyCombo combo)
         setCaptureActive(false);
 
         // Toggle mouse mode
-        m_AbsoluteMouseMode = !m_AbsoluteMouseMode;
+        SDL_AtomicSet(&m_AbsoluteMouseMode, !SDL_AtomicGet(&m_AbsoluteMouseMode));
 
         // Recapture input
         setCaptureActive(true);
@@ -131,6 +131,28 @@ void SdlInputHandler::performSpecialKeyCombo(KeyCombo combo)
     }
 }
 
+void SdlInputHandler::requestSpecialKeyCombo(KeyCombo combo)
+{
+    if (isOnMainThread()) {
+        performSpecialKeyCombo(combo);
+    }
+    else {
+        // Key combos change window and capture state, so they must be
+        // performed on the main thread.
+        SDL_Event event;
+        event.type = SDL_USEREVENT;
+        event.user.code = SDL_CODE_SPECIAL_KEY_COMBO;
+        event.user.data1 = (void*)(intptr_t)combo;
+        SDL_PushEvent(&event);
+    }
+}
+
+void SdlInputHandler::handleSpecialKeyComboEvent(SDL_UserEvent* event)
+{
+    SDL_assert(event->code == SDL_CODE_SPECIAL_KEY_COMBO);
+    performSpecialKeyCombo((KeyCombo)(intptr_t)event->data1);
+}
+
 void SdlInputHandler::handleKeyEvent(SDL_KeyboardEvent* event)
 {
     short keyCode;
@@ -160,14 +182,14 @@ void SdlInputHandler::handleKeyEvent(SDL_KeyboardEvent* event)
 
         for (int i = 0; i < KeyComboMax; i++) {
             if (m_SpecialKeyCombos[i].enabled && event->keysym.sym == m_SpecialKeyCombos[i].keyCode) {
-                performSpecialKeyCombo(m_SpecialKeyCombos[i].keyCombo);
+                requestSpecialKeyCombo(m_SpecialKeyCombos[i].keyCombo);
                 return;
             }
         }
 
         for (int i = 0; i < KeyComboMax; i++) {
             if (m_SpecialKeyCombos[i].enabled && event->keysym.scancode == m_SpecialKeyCombos[i].scanCode) {
-                performSpecialKeyCombo(m_SpecialKeyCombos[i].keyCombo);
+                requestSpecialKeyCombo(m_SpecialKeyCombos[i].keyCombo);
                 return;
             }
         }
@@ -406,7 +428,9 @@ void SdlInputHandler::handleKeyEvent(SDL_KeyboardEvent* event)
         }
     }
 
-    // Track the key state so we always know which keys are down
+    // Track the key state so we always know which keys are down. The lock
+    // keeps this ordered with raiseAllKeys() calls from the main thread.
+    QMutexLocker locker(&m_KeysDownLock);
     if (event->state == SDL_PRESSED) {
         m_KeysDown.insert(keyCode);
     }
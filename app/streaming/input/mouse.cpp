@@ -8,6 +8,17 @@ void SdlInputHandler::handleMouseButtonEvent(SDL_MouseButtonEvent* event)
 {
     int button;
 
+    // Track the button state ourselves, since SDL_GetMouseState()
+    // isn't safe to call from the input thread
+    if (event->state == SDL_PRESSED) {
+        SDL_AtomicSet(&m_MouseButtonState, SDL_AtomicGet(&m_MouseButtonState) | SDL_BUTTON(event->button));
+    }
+    else {
+        SDL_AtomicSet(&m_MouseButtonState, SDL_AtomicGet(&m_MouseButtonState) & ~SDL_BUTTON(event->button));
+    }
+    SDL_AtomicSet(&m_MouseX, event->x);
+    SDL_AtomicSet(&m_MouseY, event->y);
+
     if (event->which == SDL_TOUCH_MOUSEID) {
         // Ignore synthetic mouse events
         return;
@@ -20,13 +31,22 @@ void SdlInputHandler::handleMouseButtonEvent(SDL_MouseButtonEvent* event)
             // pressed to avoid sending an errant mouse button released
             // event to the host when clicking into our window (since
             // the pressed event was consumed by this code).
-            setCaptureActive(true);
+            if (!isOnMainThread()) {
+                // Capture must be changed on the main thread
+                SDL_Event event;
+                event.type = SDL_USEREVENT;
+                event.user.code = SDL_CODE_CAPTURE_MOUSE;
+                SDL_PushEvent(&event);
+            }
+            else {
+                setCaptureActive(true);
+            }
         }
 
         // Not capturing
         return;
     }
-    else if (m_AbsoluteMouseMode && !isMouseInVideoRegion(event->x, event->y) && event->state == SDL_PRESSED) {
+    else if (SDL_AtomicGet(&m_AbsoluteMouseMode) && !isMouseInVideoRegion(event->x, event->y) && event->state == SDL_PRESSED) {
         // Ignore button presses outside the video region, but allow button releases
         return;
     }
@@ -82,8 +102,8 @@ void SdlInputHandler::updateMousePositionReport(int mouseX, int mouseY)
 {
     int windowWidth, windowHeight;
 
-    // Call SDL_GetWindowSize() before entering the spinlock
-    SDL_GetWindowSize(m_Window, &windowWidth, &windowHeight);
+    // Read the window size before entering the spinlock
+    getWindowState(&windowWidth, &windowHeight, nullptr);
 
     SDL_AtomicLock(&m_MousePositionLock);
     m_MousePositionReport.x = mouseX;
@@ -131,7 +151,7 @@ void SdlInputHandler::flushMousePositionUpdate()
             // a) it is in the video region now
             // b) it just left the video region (to ensure the mouse is clamped to the video boundary)
             // c) a mouse button is still down from before the cursor left the video region (to allow smooth dragging)
-            Uint32 buttonState = SDL_GetMouseState(nullptr, nullptr);
+            Uint32 buttonState = (Uint32)SDL_AtomicGet(&m_MouseButtonState);
             if (buttonState == 0) {
                 if (m_PendingMouseButtonsAllUpOnVideoRegionLeave) {
                     // Tell the main thread to stop capturing the mouse now
@@ -172,6 +192,10 @@ void SdlInputHandler::flushMousePositionUpdate()
 
 void SdlInputHandler::handleMouseMotionEvent(SDL_MouseMotionEvent* event)
 {
+    SDL_AtomicSet(&m_MouseButtonState, event->state);
+    SDL_AtomicSet(&m_MouseX, event->x);
+    SDL_AtomicSet(&m_MouseY, event->y);
+
     if (!isCaptureActive()) {
         // Not capturing
         return;
@@ -183,7 +207,7 @@ void SdlInputHandler::handleMouseMotionEvent(SDL_MouseMotionEvent* event)
 
     // Batch until the next mouse polling window or we'll get awful
     // input lag everything except GFE 3.14 and 3.15.
-    if (m_AbsoluteMouseMode) {
+    if (SDL_AtomicGet(&m_AbsoluteMouseMode)) {
         updateMousePositionReport(event->x, event->y);
     }
     else {
@@ -203,10 +227,8 @@ void SdlInputHandler::handleMouseWheelEvent(SDL_MouseWheelEvent* event)
         return;
     }
 
-    if (m_AbsoluteMouseMode) {
-        int mouseX, mouseY;
-        SDL_GetMouseState(&mouseX, &mouseY);
-        if (!isMouseInVideoRegion(mouseX, mouseY)) {
+    if (SDL_AtomicGet(&m_AbsoluteMouseMode)) {
+        if (!isMouseInVideoRegion(SDL_AtomicGet(&m_MouseX), SDL_AtomicGet(&m_MouseY))) {
             // Ignore scroll events outside the video region
             return;
         }
@@ -238,7 +260,7 @@ bool SdlInputHandler::isMouseInVideoRegion(int mouseX, int mouseY, int windowWid
     SDL_Rect src, dst;
 
     if (windowWidth < 0 || windowHeight < 0) {
-        SDL_GetWindowSize(m_Window, &windowWidth, &windowHeight);
+        getWindowState(&windowWidth, &windowHeight, nullptr);
     }
 
     src.x = src.y = 0;
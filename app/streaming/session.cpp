@@ -1,6 +1,7 @@
 #include "session.h"
 #include "settings/streamingpreferences.h"
 #include "streaming/streamutils.h"
+#include "streaming/threadroles.h"
 #include "backend/richpresencemanager.h"
 
 #include <Limelight.h>
@@ -50,6 +51,7 @@ CONNECTION_LISTENER_CALLBACKS Session::k_ConnCallbacks = {
 
 Session* Session::s_ActiveSession;
 QSemaphore Session::s_ActiveSessionSemaphore(1);
+Session::WarmResources Session::s_WarmResources;
 
 void Session::clStageStarting(int stage)
 {
@@ -177,7 +179,8 @@ void Session::clConnectionStatusUpdate(int connectionStatus)
 
 bool Session::chooseDecoder(StreamingPreferences::VideoDecoderSelection vds,
                             SDL_Window* window, int videoFormat, int width, int height,
-                            int frameRate, bool enableVsync, bool enableFramePacing, bool testOnly, IVideoDecoder*& chosenDecoder)
+                            int frameRate, bool enableVsync, bool enableFramePacing, bool headless,
+                            bool testOnly, IVideoDecoder*& chosenDecoder)
 {
     DECODER_PARAMETERS params;
 
@@ -193,6 +196,7 @@ bool Session::chooseDecoder(StreamingPreferences::VideoDecoderSelection vds,
     params.window = window;
     params.enableVsync = enableVsync;
     params.enableFramePacing = enableFramePacing;
+    params.headless = headless;
     params.vds = vds;
 
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
@@ -264,32 +268,265 @@ int Session::drSubmitDecodeUnit(PDECODE_UNIT du)
     // safely return DR_OK and wait for m_NeedsIdr to be set by
     // the decoder reinitialization code.
 
-    if (SDL_AtomicTryLock(&s_ActiveSession->m_DecoderLock)) {
+    if (!SDL_AtomicGet(&s_ActiveSession->m_DecoderResetPending) &&
+            s_ActiveSession->m_DecoderLock.tryLock()) {
         if (s_ActiveSession->m_NeedsIdr) {
             // If we reset our decoder, we'll need to request an IDR frame
             s_ActiveSession->m_NeedsIdr = false;
-            SDL_AtomicUnlock(&s_ActiveSession->m_DecoderLock);
+            s_ActiveSession->m_DecoderLock.unlock();
             return DR_NEED_IDR;
         }
 
+        // This is always called on the decoder thread
+        if (!s_ActiveSession->m_DecoderThreadRoleApplied) {
+            ThreadRoles::applyToCurrentThread(ThreadRoles::RoleDecoder);
+            s_ActiveSession->m_DecoderThreadRoleApplied = true;
+        }
+
         IVideoDecoder* decoder = s_ActiveSession->m_VideoDecoder;
         if (decoder != nullptr) {
             int ret = decoder->submitDecodeUnit(du);
-            SDL_AtomicUnlock(&s_ActiveSession->m_DecoderLock);
+
+            if (ret == DR_OK && !s_ActiveSession->m_FirstFrameDecoded) {
+                s_ActiveSession->m_FirstFrameDecoded = true;
+                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                            "Time from launch to first decoded frame: %.2f ms (%s start)",
+                            (SDL_GetPerformanceCounter() - s_ActiveSession->m_LaunchTime) * 1000.0 / SDL_GetPerformanceFrequency(),
+                            s_ActiveSession->m_UsedWarmResources ? "warm" : "cold");
+            }
+
+            s_ActiveSession->m_DecoderLock.unlock();
             return ret;
         }
         else {
-            SDL_AtomicUnlock(&s_ActiveSession->m_DecoderLock);
+            s_ActiveSession->m_DecoderLock.unlock();
             return DR_OK;
         }
     }
     else {
         // Decoder is going away. Ignore anything coming in until
         // the lock is released.
+        SDL_AtomicIncRef(&s_ActiveSession->m_DecodeUnitsDroppedForReset);
         return DR_OK;
     }
 }
 
+void Session::lockDecoder()
+{
+    // Stop the decoder thread from starting any new decode units
+    SDL_AtomicSet(&m_DecoderResetPending, 1);
+
+    if (!m_DecoderLock.tryLock()) {
+        // Sleep until the in-flight decode unit is finished
+        Uint64 waitStartTime = SDL_GetPerformanceCounter();
+        m_DecoderLock.lock();
+        m_DecoderLockWaitTimeUs += (SDL_GetPerformanceCounter() - waitStartTime) * 1000000 / SDL_GetPerformanceFrequency();
+        m_DecoderLockContentions++;
+    }
+
+    m_DecoderLockCount++;
+    m_DecoderLockAcquiredTime = SDL_GetPerformanceCounter();
+}
+
+void Session::unlockDecoder()
+{
+    Uint64 heldTimeUs = (SDL_GetPerformanceCounter() - m_DecoderLockAcquiredTime) * 1000000 / SDL_GetPerformanceFrequency();
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Decoder was unavailable for %.2f ms",
+                heldTimeUs / 1000.0);
+    m_DecoderLockHeldTimeUs += heldTimeUs;
+
+    m_DecoderLock.unlock();
+    SDL_AtomicSet(&m_DecoderResetPending, 0);
+}
+
+void Session::logDecoderLockStats()
+{
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Decoder handoff: main thread waited %.2f ms for in-flight decodes (%d of %d acquisitions contended); "
+                "decoder thread dropped %d decode units during %.2f ms of decoder resets",
+                m_DecoderLockWaitTimeUs / 1000.0,
+                m_DecoderLockContentions,
+                m_DecoderLockCount,
+                SDL_AtomicGet(&m_DecodeUnitsDroppedForReset),
+                m_DecoderLockHeldTimeUs / 1000.0);
+}
+
+bool Session::isWarmSessionEnabled()
+{
+    // Opt-in because the hidden window, decoder and audio device stay
+    // allocated while we're back in the UI waiting for the next session
+    return qEnvironmentVariableIntValue("ML_WARM_SESSIONS") != 0;
+}
+
+// Drops events left over from the previous session: frame ready events
+// for its decoder and events for the warm window while it was hidden
+static int filterStaleWarmWindowEvents(void* userdata, SDL_Event* event)
+{
+    Uint32 windowId = (Uint32)(uintptr_t)userdata;
+
+    if (event->type == SDL_USEREVENT && event->user.code == SDL_CODE_FRAME_READY) {
+        return 0;
+    }
+    else if (event->type == SDL_WINDOWEVENT && event->window.windowID == windowId) {
+        return 0;
+    }
+
+    return 1;
+}
+
+bool Session::claimWarmWindow(Uint32 windowFlags)
+{
+    if (s_WarmResources.window == nullptr) {
+        return false;
+    }
+
+    // Switching a hidden window between full-screen modes or into a
+    // headless session isn't worth the trouble, so start cold instead.
+    if (s_WarmResources.windowFlags != windowFlags) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Discarding incompatible warm window");
+        releaseWarmVideo();
+        return false;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Reusing warm window from the previous session");
+
+    // The warm window keeps its reference on the video subsystem, so
+    // drop the one that initialize() took for us.
+    m_Window = s_WarmResources.window;
+    s_WarmResources.window = nullptr;
+    SDL_QuitSubSystem(SDL_INIT_VIDEO);
+
+    // The event queue survived too, so discard what the previous session
+    // left behind. Everything else must stay, since our input handler
+    // is already waiting on gamepad arrival events and we can't lose a
+    // quit request.
+    SDL_PumpEvents();
+    SDL_FilterEvents(filterStaleWarmWindowEvents, (void*)(uintptr_t)SDL_GetWindowID(m_Window));
+
+    m_UsedWarmResources = true;
+    return true;
+}
+
+bool Session::claimWarmVideoDecoder(const DECODER_PARAMETERS& params)
+{
+    IVideoDecoder* decoder = s_WarmResources.videoDecoder;
+    const DECODER_PARAMETERS& warmParams = s_WarmResources.videoDecoderParams;
+
+    if (decoder == nullptr) {
+        return false;
+    }
+
+    s_WarmResources.videoDecoder = nullptr;
+
+    if (warmParams.window != params.window ||
+            warmParams.vds != params.vds ||
+            warmParams.videoFormat != params.videoFormat ||
+            warmParams.width != params.width ||
+            warmParams.height != params.height ||
+            warmParams.frameRate != params.frameRate ||
+            warmParams.enableVsync != params.enableVsync ||
+            warmParams.enableFramePacing != params.enableFramePacing ||
+            warmParams.headless != params.headless) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Discarding incompatible warm video decoder");
+        delete decoder;
+        return false;
+    }
+
+    if (!decoder->attachToSession()) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Failed to attach warm video decoder");
+        delete decoder;
+        return false;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Reusing warm video decoder from the previous session");
+
+    m_VideoDecoder = decoder;
+    m_UsedWarmResources = true;
+    return true;
+}
+
+IAudioRenderer* Session::claimWarmAudioRenderer(const POPUS_MULTISTREAM_CONFIGURATION opusConfig)
+{
+    IAudioRenderer* audioRenderer = s_WarmResources.audioRenderer;
+
+    if (audioRenderer == nullptr) {
+        return nullptr;
+    }
+
+    s_WarmResources.audioRenderer = nullptr;
+
+    // We saved the configuration after the renderer remapped it
+    OPUS_MULTISTREAM_CONFIGURATION remappedConfig;
+    SDL_memcpy(&remappedConfig, opusConfig, sizeof(remappedConfig));
+    audioRenderer->remapChannels(&remappedConfig);
+
+    if (SDL_memcmp(&remappedConfig, &s_WarmResources.audioConfig, sizeof(remappedConfig)) != 0) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Discarding incompatible warm audio renderer");
+        delete audioRenderer;
+        return nullptr;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Reusing warm audio renderer from the previous session");
+
+    // Don't play the tail end of the previous session
+    audioRenderer->clearQueuedAudio();
+    return audioRenderer;
+}
+
+bool Session::probeWarmAudioRenderer(const POPUS_MULTISTREAM_CONFIGURATION opusConfig)
+{
+    if (s_WarmResources.audioRenderer == nullptr) {
+        return false;
+    }
+
+    // The warm renderer holds the audio device, so it must answer for any
+    // renderer that we would create. If it can't, release the device.
+    if (s_WarmResources.audioHeadless == m_Preferences->headless &&
+            s_WarmResources.audioConfig.sampleRate == opusConfig->sampleRate &&
+            s_WarmResources.audioConfig.channelCount == opusConfig->channelCount) {
+        return true;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Discarding incompatible warm audio renderer");
+    releaseWarmAudio();
+    return false;
+}
+
+void Session::releaseWarmAudio()
+{
+    delete s_WarmResources.audioRenderer;
+    s_WarmResources.audioRenderer = nullptr;
+}
+
+void Session::releaseWarmVideo()
+{
+    // The decoder must be destroyed before the window it renders to
+    delete s_WarmResources.videoDecoder;
+    s_WarmResources.videoDecoder = nullptr;
+
+    if (s_WarmResources.window != nullptr) {
+        SDL_DestroyWindow(s_WarmResources.window);
+        s_WarmResources.window = nullptr;
+        SDL_QuitSubSystem(SDL_INIT_VIDEO);
+    }
+}
+
+void Session::releaseWarmResources()
+{
+    releaseWarmVideo();
+    releaseWarmAudio();
+}
+
 void Session::getDecoderInfo(SDL_Window* window,
                              bool& isHardwareAccelerated, bool& isFullScreenOnly, QSize& maxResolution)
 {
@@ -297,7 +534,7 @@ void Session::getDecoderInfo(SDL_Window* window,
 
     if (!chooseDecoder(StreamingPreferences::VDS_AUTO,
                        window, VIDEO_FORMAT_H264, 1920, 1080, 60,
-                       false, false, true, decoder)) {
+                       false, false, false, true, decoder)) {
         isHardwareAccelerated = isFullScreenOnly = false;
         return;
     }
@@ -315,7 +552,7 @@ bool Session::isHardwareDecodeAvailable(SDL_Window* window,
 {
     IVideoDecoder* decoder;
 
-    if (!chooseDecoder(vds, window, videoFormat, width, height, frameRate, false, false, true, decoder)) {
+    if (!chooseDecoder(vds, window, videoFormat, width, height, frameRate, false, false, false, true, decoder)) {
         return false;
     }
 
@@ -337,7 +574,7 @@ bool Session::populateDecoderProperties(SDL_Window* window)
                        m_StreamConfig.width,
                        m_StreamConfig.height,
                        m_StreamConfig.fps,
-                       false, false, true, decoder)) {
+                       false, false, false, true, decoder)) {
         return false;
     }
 
@@ -361,8 +598,18 @@ Session::Session(NvComputer* computer, NvApp& app, StreamingPreferences *prefere
       m_App(app),
       m_Window(nullptr),
       m_VideoDecoder(nullptr),
-      m_DecoderLock(0),
+      m_VideoDecoderParams{},
+      m_LaunchTime(0),
+      m_FirstFrameDecoded(false),
+      m_UsedWarmResources(false),
+      m_DecoderResetPending{},
       m_NeedsIdr(false),
+      m_DecoderLockCount(0),
+      m_DecoderLockContentions(0),
+      m_DecoderLockWaitTimeUs(0),
+      m_DecoderLockHeldTimeUs(0),
+      m_DecoderLockAcquiredTime(0),
+      m_DecodeUnitsDroppedForReset{},
       m_AudioDisabled(false),
       m_AudioMuted(false),
       m_DisplayOriginX(0),
@@ -378,8 +625,13 @@ Session::Session(NvComputer* computer, NvApp& app, StreamingPreferences *prefere
       m_OpusDecoder(nullptr),
       m_AudioRenderer(nullptr),
       m_AudioSampleCount(0),
-      m_DropAudioEndTime(0)
+      m_DecoderThreadRoleApplied(false),
+      m_DropAudioEndTime(0),
+      m_AudioLatencyMs{},
+      m_AudioTrimMs{},
+      m_AudioMemoryBytes{}
 {
+    SDL_AtomicSet(&m_AudioLatencyMs, -1);
 }
 
 // NB: This may not get destroyed for a long time! Don't put any vital cleanup here.
@@ -392,12 +644,72 @@ Session::~Session()
     s_ActiveSessionSemaphore.release();
 }
 
+bool Session::initializeVideoSubsystem()
+{
+    // Warm resources hold a reference on the video subsystem, which keeps
+    // it on the driver of the previous session. Release them if we need
+    // the other kind of driver.
+    if (s_WarmResources.window != nullptr &&
+            ((s_WarmResources.windowFlags & SDL_WINDOW_HIDDEN) != 0) != m_Preferences->headless) {
+        releaseWarmVideo();
+    }
+
+    if (!m_Preferences->headless) {
+        if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "SDL_InitSubSystem(SDL_INIT_VIDEO) failed: %s",
+                         SDL_GetError());
+            return false;
+        }
+
+        return true;
+    }
+
+    // Headless sessions must run without a display server, so use SDL's
+    // offscreen video driver (or the dummy driver on SDL versions that
+    // lack it) and restore the caller's driver choice afterwards.
+    QByteArray oldVideoDriver = qgetenv("SDL_VIDEODRIVER");
+    bool oldVideoDriverSet = qEnvironmentVariableIsSet("SDL_VIDEODRIVER");
+    bool ret = false;
+
+    for (const char* driver : { "offscreen", "dummy" }) {
+        qputenv("SDL_VIDEODRIVER", driver);
+        if (SDL_InitSubSystem(SDL_INIT_VIDEO) == 0) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Using SDL %s video driver for headless session",
+                        driver);
+            ret = true;
+            break;
+        }
+
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "SDL_InitSubSystem(SDL_INIT_VIDEO) failed with %s driver: %s",
+                    driver,
+                    SDL_GetError());
+    }
+
+    if (oldVideoDriverSet) {
+        qputenv("SDL_VIDEODRIVER", oldVideoDriver);
+    }
+    else {
+        qunsetenv("SDL_VIDEODRIVER");
+    }
+
+    return ret;
+}
+
 bool Session::initialize()
 {
-    if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "SDL_InitSubSystem(SDL_INIT_VIDEO) failed: %s",
-                     SDL_GetError());
+    // Wait for the previous session to finish handing off its warm
+    // resources, since we probe the audio device with them below
+    s_ActiveSessionSemaphore.acquire();
+    s_ActiveSessionSemaphore.release();
+
+    if (!isWarmSessionEnabled()) {
+        releaseWarmResources();
+    }
+
+    if (!initializeVideoSubsystem()) {
         return false;
     }
 
@@ -1114,6 +1426,16 @@ bool Session::startConnectionAsync()
             m_StreamConfig.streamingRemotely = STREAM_CFG_AUTO;
             m_StreamConfig.packetSize = 1392;
         }
+
+        // Shrink packets further if they won't fit in the path MTU
+        int packetSize = NvComputer::getVideoPacketSizeForPath(m_StreamConfig.packetSize,
+                                                               m_Computer->getMaxUdpPayloadSize());
+        if (packetSize != m_StreamConfig.packetSize) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Using packet size of %d bytes for path MTU",
+                        packetSize);
+            m_StreamConfig.packetSize = packetSize;
+        }
     }
 
     int err = LiStartConnection(&hostInfo, &m_StreamConfig, &k_ConnCallbacks,
@@ -1167,6 +1489,7 @@ public:
 
 void Session::exec(int displayOriginX, int displayOriginY)
 {
+    m_LaunchTime = SDL_GetPerformanceCounter();
     m_DisplayOriginX = displayOriginX;
     m_DisplayOriginY = displayOriginY;
 
@@ -1265,12 +1588,27 @@ void Session::execInternal()
     SDL_Delay(500);
 #endif
 
-    m_Window = SDL_CreateWindow("Moonlight",
-                                x,
-                                y,
-                                width,
-                                height,
-                                SDL_WINDOW_ALLOW_HIGHDPI | StreamUtils::getPlatformWindowFlags());
+    // Headless sessions still need a window for the decoder to
+    // initialize against, but it lives on SDL's offscreen driver
+    // and is never shown.
+    Uint32 windowFlags = SDL_WINDOW_ALLOW_HIGHDPI;
+    if (m_Preferences->headless) {
+        windowFlags |= SDL_WINDOW_HIDDEN;
+    }
+
+    if (claimWarmWindow(windowFlags | (m_IsFullScreen ? m_FullScreenFlag : 0))) {
+        if (!m_Preferences->headless) {
+            SDL_ShowWindow(m_Window);
+        }
+    }
+    else {
+        m_Window = SDL_CreateWindow("Moonlight",
+                                    x,
+                                    y,
+                                    width,
+                                    height,
+                                    windowFlags | StreamUtils::getPlatformWindowFlags());
+    }
     if (!m_Window) {
         SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                     "SDL_CreateWindow() failed with platform flags: %s",
@@ -1281,7 +1619,7 @@ void Session::execInternal()
                                     y,
                                     width,
                                     height,
-                                    SDL_WINDOW_ALLOW_HIGHDPI);
+                                    windowFlags);
         if (!m_Window) {
             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                          "SDL_CreateWindow() failed: %s",
@@ -1318,27 +1656,30 @@ void Session::execInternal()
     }
 #endif
 
-    // For non-full screen windows, call getWindowDimensions()
-    // again after creating a window to allow it to account
-    // for window chrome size.
-    if (!m_IsFullScreen) {
-        getWindowDimensions(x, y, width, height);
-
-        // We must set the size before the position because centering
-        // won't work unless it knows the final size of the window.
-        SDL_SetWindowSize(m_Window, width, height);
-        SDL_SetWindowPosition(m_Window, x, y);
-
-        // Passing SDL_WINDOW_RESIZABLE to set this during window
-        // creation causes our window to be full screen for some reason
-        SDL_SetWindowResizable(m_Window, SDL_TRUE);
-    }
-    else {
-        // Update the window display mode based on our current monitor
-        updateOptimalWindowDisplayMode();
+    // Headless windows are never shown, so leave them alone
+    if (!m_Preferences->headless) {
+        // For non-full screen windows, call getWindowDimensions()
+        // again after creating a window to allow it to account
+        // for window chrome size.
+        if (!m_IsFullScreen) {
+            getWindowDimensions(x, y, width, height);
+
+            // We must set the size before the position because centering
+            // won't work unless it knows the final size of the window.
+            SDL_SetWindowSize(m_Window, width, height);
+            SDL_SetWindowPosition(m_Window, x, y);
+
+            // Passing SDL_WINDOW_RESIZABLE to set this during window
+            // creation causes our window to be full screen for some reason
+            SDL_SetWindowResizable(m_Window, SDL_TRUE);
+        }
+        else {
+            // Update the window display mode based on our current monitor
+            updateOptimalWindowDisplayMode();
 
-        // Enter full screen
-        SDL_SetWindowFullscreen(m_Window, m_FullScreenFlag);
+            // Enter full screen
+            SDL_SetWindowFullscreen(m_Window, m_FullScreenFlag);
+        }
     }
 
     bool needsFirstEnterCapture = false;
@@ -1347,14 +1688,17 @@ void Session::execInternal()
     // HACK: For Wayland, we wait until we get the first SDL_WINDOWEVENT_ENTER
     // event where it seems to work consistently on GNOME. For other platforms,
     // especially where SDL may call SDL_RecreateWindow(), we must only capture
-    // after the decoder is created.
-    if (strcmp(SDL_GetCurrentVideoDriver(), "wayland") == 0) {
-        // Native Wayland: Capture on SDL_WINDOWEVENT_ENTER
-        needsFirstEnterCapture = true;
-    }
-    else {
-        // X11/XWayland: Capture after decoder creation
-        needsPostDecoderCreationCapture = true;
+    // after the decoder is created. Headless windows are never
+    // visible, so they never capture input.
+    if (!m_Preferences->headless) {
+        if (strcmp(SDL_GetCurrentVideoDriver(), "wayland") == 0) {
+            // Native Wayland: Capture on SDL_WINDOWEVENT_ENTER
+            needsFirstEnterCapture = true;
+        }
+        else {
+            // X11/XWayland: Capture after decoder creation
+            needsPostDecoderCreationCapture = true;
+        }
     }
 
     // Stop text input. SDL enables it by default
@@ -1385,8 +1729,40 @@ void Session::execInternal()
     // Start rich presence to indicate we're in game
     RichPresenceManager presence(*m_Preferences, m_App.name);
 
+    Uint64 headlessStartTime = 0, headlessStartUserTimeUs = 0, headlessStartKernelTimeUs = 0;
+    if (m_Preferences->headless) {
+        // The decoder is normally created when the window is first shown,
+        // but a hidden window never is, so we must fake that event.
+        SDL_Event shownEvent = {};
+        shownEvent.type = SDL_WINDOWEVENT;
+        shownEvent.window.event = SDL_WINDOWEVENT_SHOWN;
+        shownEvent.window.windowID = SDL_GetWindowID(m_Window);
+        SDL_PushEvent(&shownEvent);
+
+        headlessStartTime = SDL_GetPerformanceCounter();
+        StreamUtils::getProcessCpuTime(headlessStartUserTimeUs, headlessStartKernelTimeUs);
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Streaming in headless mode. Send SIGINT or SIGTERM to end the session.");
+    }
+
+    if (StreamUtils::isLowMemoryProfileEnabled()) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Using low memory profile (%d MB of system RAM)",
+                    SDL_GetSystemRAM());
+    }
+    else if (SDL_GetSystemRAM() <= 2048) {
+        // Boards with 2 GB or less are prone to OOM kills during 4K streaming
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Only %d MB of system RAM. Set ML_LOW_MEMORY=1 if streaming runs out of memory.",
+                    SDL_GetSystemRAM());
+    }
+
     // Hijack this thread to be the SDL main thread. We have to do this
     // because we want to suspend all Qt processing until the stream is over.
+    // Its scheduling policy is restored once we return to the Qt GUI.
+    ThreadRoles::SavedState mainThreadState;
+    ThreadRoles::applyToCurrentThread(ThreadRoles::RoleMain, &mainThreadState);
     SDL_Event event;
     for (;;) {
 #if SDL_VERSION_ATLEAST(2, 0, 16) && !defined(STEAM_LINK)
@@ -1435,6 +1811,19 @@ void Session::execInternal()
             case SDL_CODE_UNCAPTURE_MOUSE:
                 SDL_CaptureMouse(SDL_FALSE);
                 break;
+            case SDL_CODE_CAPTURE_MOUSE:
+                m_InputHandler->setCaptureActive(true);
+                break;
+            case SDL_CODE_SPECIAL_KEY_COMBO:
+                m_InputHandler->handleSpecialKeyComboEvent(&event.user);
+                break;
+            case SDL_CODE_INPUT_ACTIVITY:
+                m_InputHandler->handleInputActivityEvent(&event.user);
+                presence.runCallbacks();
+                break;
+            case SDL_CODE_MOUSE_EMULATION_MODE:
+                notifyMouseEmulationMode(event.user.data1 != nullptr);
+                break;
             case SDL_CODE_FLUSH_WINDOW_EVENT_BARRIER:
                 m_FlushingWindowEventsRef--;
                 break;
@@ -1444,6 +1833,9 @@ void Session::execInternal()
             break;
 
         case SDL_WINDOWEVENT:
+            // Publish the latest window size and focus for the input thread
+            m_InputHandler->updateWindowState();
+
             // Early handling of some events
             switch (event.window.event) {
             case SDL_WINDOWEVENT_FOCUS_LOST:
@@ -1516,7 +1908,7 @@ void Session::execInternal()
         case SDL_RENDER_DEVICE_RESET:
         case SDL_RENDER_TARGETS_RESET:
 
-            SDL_AtomicLock(&m_DecoderLock);
+            lockDecoder();
 
             // Destroy the old decoder
             delete m_VideoDecoder;
@@ -1544,22 +1936,38 @@ void Session::execInternal()
                 // than the display.
                 int displayHz = StreamUtils::getDisplayRefreshRate(m_Window);
                 bool enableVsync = m_Preferences->enableVsync;
-                if (displayHz + 5 < m_StreamConfig.fps) {
+                if (m_Preferences->headless) {
+                    // There's no display to synchronize with
+                    enableVsync = false;
+                }
+                else if (displayHz + 5 < m_StreamConfig.fps) {
                     SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                                 "Disabling V-sync because refresh rate limit exceeded");
                     enableVsync = false;
                 }
 
+                m_VideoDecoderParams.window = m_Window;
+                m_VideoDecoderParams.vds = m_Preferences->videoDecoderSelection;
+                m_VideoDecoderParams.videoFormat = m_ActiveVideoFormat;
+                m_VideoDecoderParams.width = m_ActiveVideoWidth;
+                m_VideoDecoderParams.height = m_ActiveVideoHeight;
+                m_VideoDecoderParams.frameRate = m_ActiveVideoFrameRate;
+                m_VideoDecoderParams.enableVsync = enableVsync;
+                m_VideoDecoderParams.enableFramePacing = enableVsync && m_Preferences->framePacing;
+                m_VideoDecoderParams.headless = m_Preferences->headless;
+
                 // Choose a new decoder (hopefully the same one, but possibly
                 // not if a GPU was removed or something).
-                if (!chooseDecoder(m_Preferences->videoDecoderSelection,
-                                   m_Window, m_ActiveVideoFormat, m_ActiveVideoWidth,
-                                   m_ActiveVideoHeight, m_ActiveVideoFrameRate,
-                                   enableVsync,
-                                   enableVsync && m_Preferences->framePacing,
-                                   false,
-                                   s_ActiveSession->m_VideoDecoder)) {
-                    SDL_AtomicUnlock(&m_DecoderLock);
+                if (!claimWarmVideoDecoder(m_VideoDecoderParams) &&
+                        !chooseDecoder(m_VideoDecoderParams.vds,
+                                       m_Window, m_VideoDecoderParams.videoFormat, m_VideoDecoderParams.width,
+                                       m_VideoDecoderParams.height, m_VideoDecoderParams.frameRate,
+                                       m_VideoDecoderParams.enableVsync,
+                                       m_VideoDecoderParams.enableFramePacing,
+                                       m_VideoDecoderParams.headless,
+                                       false,
+                                       s_ActiveSession->m_VideoDecoder)) {
+                    unlockDecoder();
                     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                                  "Failed to recreate decoder after reset");
                     emit displayLaunchError(tr("Unable to initialize video decoder. Please check your streaming settings and try again."));
@@ -1578,9 +1986,12 @@ void Session::execInternal()
             // Request an IDR frame to complete the reset
             m_NeedsIdr = true;
 
-            SDL_AtomicUnlock(&m_DecoderLock);
+            unlockDecoder();
             break;
 
+        // Keyboard, mouse, and gamepad button and axis events are normally
+        // delivered to the input thread by SdlInputHandler's event filter.
+        // We only see them here if the input thread couldn't be started.
         case SDL_KEYUP:
         case SDL_KEYDOWN:
             presence.runCallbacks();
@@ -1626,6 +2037,7 @@ DispatchDeferredCleanup:
     m_InputHandler->setCaptureActive(false);
     SDL_EnableScreenSaver();
     SDL_SetHint(SDL_HINT_TIMER_RESOLUTION, "0");
+    ThreadRoles::restoreCurrentThread(mainThreadState);
     if (QGuiApplication::platformName() == "eglfs") {
         QGuiApplication::restoreOverrideCursor();
     }
@@ -1642,21 +2054,74 @@ DispatchDeferredCleanup:
     m_InputHandler = nullptr;
     SDL_AtomicUnlock(&m_InputHandlerLock);
 
-    // Destroy the decoder, since this must be done on the main thread
-    SDL_AtomicLock(&m_DecoderLock);
-    delete m_VideoDecoder;
+    // Sessions that end cleanly can leave their window, decoder, and
+    // audio renderer for the next session to skip recreating them.
+    bool keepWarm = isWarmSessionEnabled() && !m_UnexpectedTermination;
+
+    // Destroy the decoder, since this must be done on the main thread.
+    // This also logs the global video stats for the session.
+    lockDecoder();
+    if (keepWarm && m_VideoDecoder != nullptr && m_VideoDecoder->detachFromSession()) {
+        s_WarmResources.videoDecoder = m_VideoDecoder;
+        s_WarmResources.videoDecoderParams = m_VideoDecoderParams;
+    }
+    else {
+        delete m_VideoDecoder;
+    }
     m_VideoDecoder = nullptr;
-    SDL_AtomicUnlock(&m_DecoderLock);
+    unlockDecoder();
+
+    logDecoderLockStats();
+
+    if (m_Preferences->headless) {
+        Uint64 userTimeUs, kernelTimeUs;
+        double elapsedSecs = (double)(SDL_GetPerformanceCounter() - headlessStartTime) / SDL_GetPerformanceFrequency();
+
+        if (StreamUtils::getProcessCpuTime(userTimeUs, kernelTimeUs)) {
+            double userSecs = (userTimeUs - headlessStartUserTimeUs) / 1000000.0;
+            double kernelSecs = (kernelTimeUs - headlessStartKernelTimeUs) / 1000000.0;
+
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Headless session ran for %.2f seconds using %.2f seconds of user CPU time and %.2f seconds of kernel CPU time (%.1f%% of one core)",
+                        elapsedSecs,
+                        userSecs,
+                        kernelSecs,
+                        elapsedSecs > 0 ? (userSecs + kernelSecs) / elapsedSecs * 100 : 0.0);
+        }
 
-    // This must be called after the decoder is deleted, because
-    // the renderer may want to interact with the window
-    SDL_DestroyWindow(m_Window);
+        Uint64 peakRssBytes;
+        if (StreamUtils::getProcessPeakMemory(peakRssBytes)) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Headless session peak resident memory: %.1f MB",
+                        peakRssBytes / (1024.0 * 1024.0));
+        }
+    }
+
+    if (keepWarm) {
+        // The warm window holds on to our video subsystem reference
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Keeping warm resources for the next session");
+        s_WarmResources.windowFlags = windowFlags | (SDL_GetWindowFlags(m_Window) & SDL_WINDOW_FULLSCREEN_DESKTOP);
+        SDL_HideWindow(m_Window);
+        s_WarmResources.window = m_Window;
+    }
+    else {
+        // A warm decoder that we never claimed renders to this window too.
+        // Release warm audio along with it, so nothing is left behind.
+        releaseWarmResources();
+
+        // This must be called after the decoder is deleted, because
+        // the renderer may want to interact with the window
+        SDL_DestroyWindow(m_Window);
+    }
 
     if (iconSurface != nullptr) {
         SDL_FreeSurface(iconSurface);
     }
 
-    SDL_QuitSubSystem(SDL_INIT_VIDEO);
+    if (!keepWarm) {
+        SDL_QuitSubSystem(SDL_INIT_VIDEO);
+    }
 
     // Cleanup can take a while, so dispatch it to a worker thread.
     // When it is complete, it will release our s_ActiveSessionSemaphore
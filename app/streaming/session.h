@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QMutex>
 #include <QSemaphore>
 
 #include <Limelight.h>
@@ -30,6 +31,12 @@ public:
     void getDecoderInfo(SDL_Window* window,
                        bool& isHardwareAccelerated, bool& isFullScreenOnly, QSize& maxResolution);
 
+    // Destroys the window, decoder and audio renderer that the last
+    // session kept warm. Must be called on the main thread with no
+    // session running.
+    static
+    void releaseWarmResources();
+
     static Session* get()
     {
         return s_ActiveSession;
@@ -42,6 +49,25 @@ public:
 
     void flushWindowEvents();
 
+    // Estimated time from an audio packet arriving until it is played,
+    // or -1 if it isn't known
+    int getAudioLatencyMs()
+    {
+        return SDL_AtomicGet(&m_AudioLatencyMs);
+    }
+
+    // Bytes of audio buffers owned by the audio renderer
+    int getAudioMemoryUsage()
+    {
+        return SDL_AtomicGet(&m_AudioMemoryBytes);
+    }
+
+    // Drops the next durationMs of audio to bring it back in sync with video
+    void trimAudio(int durationMs)
+    {
+        SDL_AtomicSet(&m_AudioTrimMs, durationMs);
+    }
+
 signals:
     void stageStarting(QString stage);
 
@@ -62,6 +88,8 @@ private:
 
     bool initialize();
 
+    bool initializeVideoSubsystem();
+
     bool startConnectionAsync();
 
     bool validateLaunch(SDL_Window* testWindow);
@@ -85,6 +113,30 @@ private:
 
     void updateOptimalWindowDisplayMode();
 
+    void lockDecoder();
+
+    void unlockDecoder();
+
+    void logDecoderLockStats();
+
+    static
+    bool isWarmSessionEnabled();
+
+    bool claimWarmWindow(Uint32 windowFlags);
+
+    bool claimWarmVideoDecoder(const DECODER_PARAMETERS& params);
+
+    static
+    IAudioRenderer* claimWarmAudioRenderer(const POPUS_MULTISTREAM_CONFIGURATION opusConfig);
+
+    bool probeWarmAudioRenderer(const POPUS_MULTISTREAM_CONFIGURATION opusConfig);
+
+    static
+    void releaseWarmVideo();
+
+    static
+    void releaseWarmAudio();
+
     static
     bool isHardwareDecodeAvailable(SDL_Window* window,
                                    StreamingPreferences::VideoDecoderSelection vds,
@@ -94,7 +146,7 @@ private:
     bool chooseDecoder(StreamingPreferences::VideoDecoderSelection vds,
                        SDL_Window* window, int videoFormat, int width, int height,
                        int frameRate, bool enableVsync, bool enableFramePacing,
-                       bool testOnly,
+                       bool headless, bool testOnly,
                        IVideoDecoder*& chosenDecoder);
 
     static
@@ -144,8 +196,28 @@ private:
     NvApp m_App;
     SDL_Window* m_Window;
     IVideoDecoder* m_VideoDecoder;
-    SDL_SpinLock m_DecoderLock;
+    DECODER_PARAMETERS m_VideoDecoderParams;
+
+    // Time to first frame, for comparing warm and cold starts
+    Uint64 m_LaunchTime;
+    bool m_FirstFrameDecoded;
+    bool m_UsedWarmResources;
+
+    // The decoder thread only ever try-locks this, dropping decode units
+    // rather than waiting while the main thread replaces the decoder.
+    // m_DecoderResetPending keeps it from winning the lock back while the
+    // main thread is sleeping until an in-flight decode finishes.
+    QMutex m_DecoderLock;
+    SDL_atomic_t m_DecoderResetPending;
     bool m_NeedsIdr;
+
+    // Decoder handoff stats
+    int m_DecoderLockCount;
+    int m_DecoderLockContentions;
+    Uint64 m_DecoderLockWaitTimeUs;
+    Uint64 m_DecoderLockHeldTimeUs;
+    Uint64 m_DecoderLockAcquiredTime;
+    SDL_atomic_t m_DecodeUnitsDroppedForReset;
     bool m_AudioDisabled;
     bool m_AudioMuted;
     Uint32 m_FullScreenFlag;
@@ -171,11 +243,30 @@ private:
     IAudioRenderer* m_AudioRenderer;
     OPUS_MULTISTREAM_CONFIGURATION m_AudioConfig;
     int m_AudioSampleCount;
+    bool m_DecoderThreadRoleApplied;
     Uint32 m_DropAudioEndTime;
+    SDL_atomic_t m_AudioLatencyMs;
+    SDL_atomic_t m_AudioTrimMs;
+    SDL_atomic_t m_AudioMemoryBytes;
 
     Overlay::OverlayManager m_OverlayManager;
 
     static CONNECTION_LISTENER_CALLBACKS k_ConnCallbacks;
     static Session* s_ActiveSession;
     static QSemaphore s_ActiveSessionSemaphore;
+
+    // Resources that a session left behind for the next one when warm
+    // sessions are enabled. These are only touched while holding
+    // s_ActiveSessionSemaphore, which orders one session's cleanup
+    // before the next session's startup.
+    struct WarmResources {
+        SDL_Window* window;
+        Uint32 windowFlags;
+        IVideoDecoder* videoDecoder;
+        DECODER_PARAMETERS videoDecoderParams;
+        IAudioRenderer* audioRenderer;
+        OPUS_MULTISTREAM_CONFIGURATION audioConfig;
+        bool audioHeadless;
+    };
+    static WarmResources s_WarmResources;
 };
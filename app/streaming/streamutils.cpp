@@ -6,6 +6,14 @@
 #include <ApplicationServices/ApplicationServices.h>
 #endif
 
+#ifdef Q_OS_WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <errno.h>
+#endif
+
 Uint32 StreamUtils::getPlatformWindowFlags()
 {
 #ifdef Q_OS_DARWIN
@@ -132,3 +140,75 @@ bool StreamUtils::getRealDesktopMode(int displayIndex, SDL_DisplayMode* mode)
 
     return true;
 }
+
+bool StreamUtils::getProcessCpuTime(Uint64& userTimeUs, Uint64& kernelTimeUs)
+{
+#ifdef Q_OS_WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "GetProcessTimes() failed: %d",
+                     GetLastError());
+        return false;
+    }
+
+    // FILETIME is in 100 ns units
+    userTimeUs = (((Uint64)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime) / 10;
+    kernelTimeUs = (((Uint64)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) / 10;
+    return true;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "getrusage() failed: %d",
+                     errno);
+        return false;
+    }
+
+    userTimeUs = (Uint64)usage.ru_utime.tv_sec * 1000000 + usage.ru_utime.tv_usec;
+    kernelTimeUs = (Uint64)usage.ru_stime.tv_sec * 1000000 + usage.ru_stime.tv_usec;
+    return true;
+#endif
+}
+
+bool StreamUtils::getProcessPeakMemory(Uint64& peakRssBytes)
+{
+#ifdef Q_OS_WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "GetProcessMemoryInfo() failed: %d",
+                     GetLastError());
+        return false;
+    }
+
+    peakRssBytes = counters.PeakWorkingSetSize;
+    return true;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "getrusage() failed: %d",
+                     errno);
+        return false;
+    }
+
+#ifdef Q_OS_DARWIN
+    // macOS reports this in bytes rather than KB
+    peakRssBytes = (Uint64)usage.ru_maxrss;
+#else
+    peakRssBytes = (Uint64)usage.ru_maxrss * 1024;
+#endif
+    return true;
+#endif
+}
+
+bool StreamUtils::isLowMemoryProfileEnabled()
+{
+    // This trades smoothness for memory, so it's only used when asked for
+    return qEnvironmentVariableIntValue("ML_LOW_MEMORY") != 0;
+}
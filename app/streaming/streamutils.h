@@ -16,4 +16,17 @@ public:
 
     static
     int getDisplayRefreshRate(SDL_Window* window);
+
+    // Returns the user and kernel CPU time consumed by this process
+    static
+    bool getProcessCpuTime(Uint64& userTimeUs, Uint64& kernelTimeUs);
+
+    // Returns the peak resident set size of this process
+    static
+    bool getProcessPeakMemory(Uint64& peakRssBytes);
+
+    // Returns true if the user asked for small queue depths and buffer
+    // pools to fit on devices with little RAM
+    static
+    bool isLowMemoryProfileEnabled();
 };
@@ -0,0 +1,327 @@
+#include "threadroles.h"
+
+#include <QList>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* ThreadRoles::getRoleName(Role role)
+{
+    switch (role) {
+    case RoleMain:
+        return "MAIN";
+    case RoleDecoder:
+        return "DECODER";
+    case RoleRender:
+        return "RENDER";
+    case RoleAudio:
+        return "AUDIO";
+    default:
+        SDL_assert(false);
+        return "UNKNOWN";
+    }
+}
+
+QByteArray ThreadRoles::getRoleVariable(Role role, const char* setting)
+{
+    return qgetenv(QString("ML_THREAD_%1_%2").arg(getRoleName(role), setting).toUtf8().constData());
+}
+
+bool ThreadRoles::parseSchedPolicy(const QByteArray& sched, SchedPolicy* policy, int* value)
+{
+    QList<QByteArray> schedParts = sched.split(':');
+    bool ok;
+
+    if (schedParts.size() != 2) {
+        return false;
+    }
+
+    *value = schedParts[1].toInt(&ok);
+    if (!ok) {
+        return false;
+    }
+
+    if (schedParts[0] == "fifo") {
+        *policy = SchedFifo;
+    }
+    else if (schedParts[0] == "rr") {
+        *policy = SchedRoundRobin;
+    }
+    else if (schedParts[0] == "nice") {
+        *policy = SchedNice;
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
+bool ThreadRoles::parseTimerSlack(const QByteArray& timerSlack, int* timerSlackNs)
+{
+    bool ok;
+
+    *timerSlackNs = timerSlack.toInt(&ok);
+    return ok && *timerSlackNs > 0;
+}
+
+#ifdef Q_OS_LINUX
+
+static pid_t getCurrentThreadId()
+{
+    return (pid_t)syscall(SYS_gettid);
+}
+
+bool ThreadRoles::parseCpuList(const QByteArray& cpuList, cpu_set_t* cpuSet)
+{
+    CPU_ZERO(cpuSet);
+
+    for (const QByteArray& range : cpuList.split(',')) {
+        QList<QByteArray> bounds = range.trimmed().split('-');
+        bool ok1, ok2 = true;
+        int first, last;
+
+        if (bounds.size() > 2) {
+            return false;
+        }
+
+        first = bounds[0].toInt(&ok1);
+        last = bounds.size() == 2 ? bounds[1].toInt(&ok2) : first;
+        if (!ok1 || !ok2 || first < 0 || last < first || last >= CPU_SETSIZE) {
+            return false;
+        }
+
+        for (int cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, cpuSet);
+        }
+    }
+
+    return CPU_COUNT(cpuSet) > 0;
+}
+
+QString ThreadRoles::formatCpuList(const cpu_set_t* cpuSet)
+{
+    QString cpuList;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, cpuSet)) {
+            continue;
+        }
+
+        // Collapse consecutive CPUs into a range
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, cpuSet)) {
+            last++;
+        }
+
+        if (!cpuList.isEmpty()) {
+            cpuList += ',';
+        }
+        cpuList += last == cpu ? QString::number(cpu) : QString("%1-%2").arg(cpu).arg(last);
+        cpu = last;
+    }
+
+    return cpuList;
+}
+
+#endif
+
+void ThreadRoles::applyToCurrentThread(Role role, SavedState* savedState)
+{
+    const char* roleName = getRoleName(role);
+    QByteArray affinity = getRoleVariable(role, "AFFINITY");
+    QByteArray sched = getRoleVariable(role, "SCHED");
+    QByteArray timerSlack = getRoleVariable(role, "TIMER_SLACK_NS");
+
+    if (savedState != nullptr) {
+        savedState->valid = false;
+#ifdef Q_OS_LINUX
+        savedState->affinityValid = sched_getaffinity(0, sizeof(savedState->affinity), &savedState->affinity) == 0;
+        if (pthread_getschedparam(pthread_self(), &savedState->policy, &savedState->param) == 0) {
+            errno = 0;
+            savedState->nice = getpriority(PRIO_PROCESS, getCurrentThreadId());
+            savedState->timerSlackNs = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+            savedState->valid = errno == 0 && savedState->timerSlackNs >= 0;
+        }
+#endif
+    }
+
+    if (sched.isEmpty()) {
+        // Apply the default priority hint for this role
+        SDL_ThreadPriority priority;
+        switch (role) {
+        case RoleRender:
+            priority = SDL_THREAD_PRIORITY_HIGH;
+            break;
+        case RoleAudio:
+#ifdef STEAM_LINK
+            // On Steam Link, this causes starvation of other threads due to
+            // severely restricted CPU time available, so we will skip it.
+            priority = SDL_THREAD_PRIORITY_NORMAL;
+#else
+            priority = SDL_THREAD_PRIORITY_HIGH;
+#endif
+            break;
+        default:
+            priority = SDL_THREAD_PRIORITY_NORMAL;
+            break;
+        }
+
+        if (priority != SDL_THREAD_PRIORITY_NORMAL && SDL_SetThreadPriority(priority) < 0) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Unable to set %s thread to high priority: %s",
+                        roleName,
+                        SDL_GetError());
+        }
+    }
+
+#ifdef Q_OS_LINUX
+    if (!affinity.isEmpty()) {
+        cpu_set_t cpuSet;
+
+        if (!parseCpuList(affinity, &cpuSet)) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Invalid %s thread affinity: %s",
+                        roleName,
+                        affinity.constData());
+        }
+        else if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) < 0) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Unable to set %s thread affinity to %s: %d",
+                        roleName,
+                        affinity.constData(),
+                        errno);
+        }
+    }
+
+    if (!sched.isEmpty()) {
+        SchedPolicy schedPolicy;
+        int value;
+
+        if (!parseSchedPolicy(sched, &schedPolicy, &value)) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Invalid %s thread scheduling policy: %s",
+                        roleName,
+                        sched.constData());
+        }
+        else if (schedPolicy == SchedFifo || schedPolicy == SchedRoundRobin) {
+            struct sched_param param = {};
+            int policy = schedPolicy == SchedFifo ? SCHED_FIFO : SCHED_RR;
+
+            // This requires CAP_SYS_NICE or an RLIMIT_RTPRIO allowance
+            param.sched_priority = qBound(sched_get_priority_min(policy), value, sched_get_priority_max(policy));
+            int err = pthread_setschedparam(pthread_self(), policy, &param);
+            if (err != 0) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "Unable to set %s thread scheduling policy to %s: %d",
+                            roleName,
+                            sched.constData(),
+                            err);
+            }
+        }
+        else {
+            // Linux applies nice values per-thread when given a TID
+            if (setpriority(PRIO_PROCESS, getCurrentThreadId(), value) < 0) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "Unable to set %s thread nice value to %d: %d",
+                            roleName,
+                            value,
+                            errno);
+            }
+        }
+    }
+
+    if (!timerSlack.isEmpty()) {
+        int timerSlackNs;
+
+        if (!parseTimerSlack(timerSlack, &timerSlackNs)) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Invalid %s thread timer slack: %s",
+                        roleName,
+                        timerSlack.constData());
+        }
+        else if (prctl(PR_SET_TIMERSLACK, (unsigned long)timerSlackNs, 0, 0, 0) < 0) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Unable to set %s thread timer slack to %d ns: %d",
+                        roleName,
+                        timerSlackNs,
+                        errno);
+        }
+    }
+#else
+    if (!affinity.isEmpty() || !sched.isEmpty() || !timerSlack.isEmpty()) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Thread role configuration for %s is not supported on this platform",
+                    roleName);
+    }
+#endif
+
+    logCurrentThread(role);
+}
+
+void ThreadRoles::restoreCurrentThread(const SavedState& savedState)
+{
+    if (!savedState.valid) {
+        return;
+    }
+
+#ifdef Q_OS_LINUX
+    if (savedState.affinityValid) {
+        sched_setaffinity(0, sizeof(savedState.affinity), &savedState.affinity);
+    }
+    pthread_setschedparam(pthread_self(), savedState.policy, &savedState.param);
+    setpriority(PRIO_PROCESS, getCurrentThreadId(), savedState.nice);
+    prctl(PR_SET_TIMERSLACK, (unsigned long)savedState.timerSlackNs, 0, 0, 0);
+#endif
+}
+
+void ThreadRoles::logCurrentThread(Role role)
+{
+#ifdef Q_OS_LINUX
+    // Read everything back, since requested policies may be silently
+    // clamped or overridden by the kernel, cgroups, or rtkit.
+    cpu_set_t cpuSet;
+    QString cpuList = sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0 ? formatCpuList(&cpuSet) : QString("unknown");
+
+    int policy = SCHED_OTHER;
+    struct sched_param param = {};
+    pthread_getschedparam(pthread_self(), &policy, &param);
+
+    const char* policyName;
+    switch (policy) {
+    case SCHED_FIFO:
+        policyName = "SCHED_FIFO";
+        break;
+    case SCHED_RR:
+        policyName = "SCHED_RR";
+        break;
+    case SCHED_OTHER:
+        policyName = "SCHED_OTHER";
+        break;
+    default:
+        policyName = "other";
+        break;
+    }
+
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, getCurrentThreadId());
+    int timerSlackNs = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "%s thread: CPUs %s, %s priority %d, nice %d, timer slack %d ns",
+                getRoleName(role),
+                qPrintable(cpuList),
+                policyName,
+                param.sched_priority,
+                errno == 0 ? nice : 0,
+                timerSlackNs);
+#else
+    Q_UNUSED(role);
+#endif
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <QByteArray>
+#include <QString>
+
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#endif
+
+// Applies per-role scheduling policy to streaming threads. Each role
+// can be configured with these environment variables (ROLE is one of
+// MAIN, DECODER, RENDER, or AUDIO):
+//
+// ML_THREAD_<ROLE>_AFFINITY - CPU list like "2-3,6"
+// ML_THREAD_<ROLE>_SCHED - "fifo:<priority>", "rr:<priority>", or "nice:<value>"
+// ML_THREAD_<ROLE>_TIMER_SLACK_NS - Timer slack in nanoseconds
+//
+// Roles without a configured scheduling policy get the default SDL
+// thread priority hint that they have always used.
+class ThreadRoles
+{
+public:
+    enum Role {
+        RoleMain,
+        RoleDecoder,
+        RoleRender,
+        RoleAudio,
+        RoleMax
+    };
+
+    // Scheduling state of a thread before a role was applied to it
+    struct SavedState {
+        bool valid;
+#ifdef Q_OS_LINUX
+        bool affinityValid;
+        cpu_set_t affinity;
+        int policy;
+        struct sched_param param;
+        int nice;
+        int timerSlackNs;
+#endif
+    };
+
+    // Applies the role's configuration to the calling thread and logs which
+    // parts of it actually took effect. If savedState is provided, it receives
+    // what is needed to undo this with restoreCurrentThread().
+    static
+    void applyToCurrentThread(Role role, SavedState* savedState = nullptr);
+
+    static
+    void restoreCurrentThread(const SavedState& savedState);
+
+    enum SchedPolicy {
+        SchedFifo,
+        SchedRoundRobin,
+        SchedNice
+    };
+
+    // Returns the value of ML_THREAD_<ROLE>_<setting>
+    static
+    QByteArray getRoleVariable(Role role, const char* setting);
+
+    // Parses ML_THREAD_<ROLE>_SCHED into a policy and its priority or nice value
+    static
+    bool parseSchedPolicy(const QByteArray& sched, SchedPolicy* policy, int* value);
+
+    static
+    bool parseTimerSlack(const QByteArray& timerSlack, int* timerSlackNs);
+
+#ifdef Q_OS_LINUX
+    static
+    bool parseCpuList(const QByteArray& cpuList, cpu_set_t* cpuSet);
+
+    static
+    QString formatCpuList(const cpu_set_t* cpuSet);
+#endif
+
+private:
+    static
+    const char* getRoleName(Role role);
+
+    static
+    void logCurrentThread(Role role);
+};
@@ -19,6 +19,17 @@ typedef struct _VIDEO_STATS {
     uint32_t totalDecodeTime;
     uint32_t totalPacerTime;
     uint32_t totalRenderTime;
+    uint64_t totalRenderWaitTimeUs;
+    uint64_t totalOutputLatencyUs;
+    uint32_t totalPacingDepth;
+    uint32_t renderDeadlineMisses;
+    uint32_t hwSurfaceStalls;
+    uint64_t totalHwSurfaceWaitUs;
+    uint32_t totalAudioLatency;
+    uint32_t audioLatencySamples;
+    uint32_t videoMemoryKb;
+    uint32_t audioMemoryKb;
+    uint32_t overlayMemoryKb;
     uint32_t lastRtt;
     uint32_t lastRttVariance;
     float totalFps;
@@ -38,6 +49,7 @@ typedef struct _DECODER_PARAMETERS {
     int frameRate;
     bool enableVsync;
     bool enableFramePacing;
+    bool headless;
 } DECODER_PARAMETERS, *PDECODER_PARAMETERS;
 
 class IVideoDecoder {
@@ -51,4 +63,13 @@ public:
     virtual QSize getDecoderMaxResolution() = 0;
     virtual int submitDecodeUnit(PDECODE_UNIT du) = 0;
     virtual void renderFrameOnMainThread() = 0;
+
+    // Prepares the decoder to outlive the session that is ending, so a
+    // following session with the same parameters can reuse it. Returns
+    // false if the decoder must be destroyed instead.
+    virtual bool detachFromSession() { return false; }
+
+    // Binds a detached decoder to the now active session. Returns false
+    // if the decoder can't be reused and must be destroyed.
+    virtual bool attachToSession() { return false; }
 };
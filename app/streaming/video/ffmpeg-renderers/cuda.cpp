@@ -40,6 +40,11 @@ bool CUDARenderer::prepareDecoderContext(AVCodecContext* context, AVDictionary**
     return true;
 }
 
+bool CUDARenderer::canRecreateDecoderContext()
+{
+    return true;
+}
+
 void CUDARenderer::renderFrame(AVFrame*)
 {
     // We only support indirect rendering
@@ -14,6 +14,7 @@ public:
     virtual ~CUDARenderer() override;
     virtual bool initialize(PDECODER_PARAMETERS) override;
     virtual bool prepareDecoderContext(AVCodecContext* context, AVDictionary** options) override;
+    virtual bool canRecreateDecoderContext() override;
     virtual void renderFrame(AVFrame* frame) override;
     virtual bool needsTestFrame() override;
     virtual bool isDirectRenderingSupported() override;
@@ -63,6 +63,11 @@ bool DrmRenderer::prepareDecoderContext(AVCodecContext* context, AVDictionary**
     return true;
 }
 
+bool DrmRenderer::canRecreateDecoderContext()
+{
+    return true;
+}
+
 bool DrmRenderer::initialize(PDECODER_PARAMETERS params)
 {
     int i;
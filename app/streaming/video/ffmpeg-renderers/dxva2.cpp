@@ -38,7 +38,8 @@ DXVA2Renderer::DXVA2Renderer() :
     m_ProcService(nullptr),
     m_Processor(nullptr),
     m_FrameIndex(0),
-    m_BlockingPresent(false)
+    m_BlockingPresent(false),
+    m_LastRenderWaitTimeUs(0)
 {
     RtlZeroMemory(m_DecSurfaces, sizeof(m_DecSurfaces));
     RtlZeroMemory(&m_DXVAContext, sizeof(m_DXVAContext));
@@ -987,6 +988,11 @@ Exit:
     overlayVertexBuffer->Release();
 }
 
+Uint64 DXVA2Renderer::getLastRenderWaitTimeUs()
+{
+    return m_LastRenderWaitTimeUs;
+}
+
 int DXVA2Renderer::getDecoderColorspace()
 {
     if (isDXVideoProcessorAPIBlacklisted()) {
@@ -1011,6 +1017,8 @@ void DXVA2Renderer::renderFrame(AVFrame *frame)
     IDirect3DSurface9* surface = reinterpret_cast<IDirect3DSurface9*>(frame->data[3]);
     HRESULT hr;
 
+    m_LastRenderWaitTimeUs = 0;
+
     switch (frame->color_range) {
     case AVCOL_RANGE_JPEG:
         m_Desc.SampleFormat.NominalRange = DXVA2_NominalRange_0_255;
@@ -1205,6 +1213,8 @@ void DXVA2Renderer::renderFrame(AVFrame *frame)
         return;
     }
 
+    // Time spent retrying is time spent waiting for V-sync, not rendering
+    Uint64 waitStart = SDL_GetPerformanceCounter();
     do {
         // Use D3DPRESENT_DONOTWAIT if present may block in order to avoid holding the giant
         // lock around this D3D device for excessive lengths of time (blocking concurrent decoding tasks).
@@ -1213,6 +1223,7 @@ void DXVA2Renderer::renderFrame(AVFrame *frame)
             SDL_Delay(1);
         }
     } while (hr == D3DERR_WASSTILLDRAWING);
+    m_LastRenderWaitTimeUs = (SDL_GetPerformanceCounter() - waitStart) * 1000000 / SDL_GetPerformanceFrequency();
     if (FAILED(hr)) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "PresentEx() failed: %x",
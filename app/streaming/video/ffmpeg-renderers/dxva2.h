@@ -20,6 +20,7 @@ public:
     virtual void renderFrame(AVFrame* frame) override;
     virtual void notifyOverlayUpdated(Overlay::OverlayType type) override;
     virtual int getDecoderColorspace() override;
+    virtual Uint64 getLastRenderWaitTimeUs() override;
 
 private:
     bool initializeDecoder();
@@ -68,4 +69,5 @@ private:
     DXVA2_VideoDesc m_Desc;
     REFERENCE_TIME m_FrameIndex;
     bool m_BlockingPresent;
+    Uint64 m_LastRenderWaitTimeUs;
 };
@@ -5,7 +5,10 @@
 #include "streaming/session.h"
 #include "streaming/streamutils.h"
 
+#include <QCryptographicHash>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 
 #include <Limelight.h>
 #include <unistd.h>
@@ -55,6 +58,11 @@ typedef struct _OVERLAY_VERTEX
         SDL_LOG_CATEGORY_APPLICATION, \
         "EGLRenderer: " __VA_ARGS__)
 
+// Number of swapped frames the GPU may still be working on before
+// fence-based swap throttling blocks the render thread
+#define DEFAULT_MAX_FRAMES_IN_FLIGHT 1
+#define MAX_MAX_FRAMES_IN_FLIGHT 4
+
 SDL_Window* EGLRenderer::s_LastFailedWindow = nullptr;
 
 EGLRenderer::EGLRenderer(IFFmpegRenderer *backendRenderer)
@@ -72,11 +80,19 @@ EGLRenderer::EGLRenderer(IFFmpegRenderer *backendRenderer)
         m_Backend(backendRenderer),
         m_VAO(0),
         m_BlockingSwapBuffers(false),
+        m_SwapThrottleMode(SwapThrottleFinish),
+        m_MaxFramesInFlight(DEFAULT_MAX_FRAMES_IN_FLIGHT),
+        m_LastRenderWaitTimeUs(0),
         m_LastFrame(av_frame_alloc()),
         m_glEGLImageTargetTexture2DOES(nullptr),
         m_glGenVertexArraysOES(nullptr),
         m_glBindVertexArrayOES(nullptr),
         m_glDeleteVertexArraysOES(nullptr),
+        m_glGetProgramBinaryOES(nullptr),
+        m_glProgramBinaryOES(nullptr),
+        m_eglCreateSyncKHR(nullptr),
+        m_eglClientWaitSyncKHR(nullptr),
+        m_eglDestroySyncKHR(nullptr),
         m_DummyRenderer(nullptr)
 {
     SDL_assert(backendRenderer);
@@ -116,6 +132,10 @@ EGLRenderer::~EGLRenderer()
                 glDeleteBuffers(1, &m_OverlayVbos[i]);
             }
         }
+        while (!m_FramesInFlight.isEmpty()) {
+            releaseFrameInFlight(m_FramesInFlight.head(), EGL_SYNC_FLUSH_COMMANDS_BIT_KHR);
+            m_FramesInFlight.dequeue();
+        }
         SDL_GL_DeleteContext(m_Context);
     }
 
@@ -254,14 +274,14 @@ void EGLRenderer::renderOverlay(Overlay::OverlayType type)
 }
 
 int EGLRenderer::loadAndBuildShader(int shaderType,
-                                    const char *file) {
+                                    const char *file,
+                                    const QByteArray& sourceData) {
     GLuint shader = glCreateShader(shaderType);
     if (!shader || shader == GL_INVALID_ENUM) {
         EGL_LOG(Error, "Can't create shader: %d", glGetError());
         return 0;
     }
 
-    auto sourceData = Path::readDataFile(file);
     GLint len = sourceData.size();
     const char *buf = sourceData.data();
 
@@ -327,14 +347,113 @@ bool EGLRenderer::openDisplay(unsigned int platform, void* nativeDisplay)
     return m_EGLDisplay != EGL_NO_DISPLAY;
 }
 
+QString EGLRenderer::getProgramCacheFileName(const QByteArray& vertexShaderSource,
+                                             const QByteArray& fragmentShaderSource) {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+
+    // Program binaries are only valid for the exact driver that produced them
+    hash.addData((const char*)glGetString(GL_VENDOR));
+    hash.addData((const char*)glGetString(GL_RENDERER));
+    hash.addData((const char*)glGetString(GL_VERSION));
+    hash.addData(vertexShaderSource);
+    hash.addData(fragmentShaderSource);
+
+    return "eglprogram-" + QString::fromLatin1(hash.result().toHex()) + ".bin";
+}
+
+unsigned EGLRenderer::loadCachedProgram(const QString& cacheFileName) {
+    QFileInfo cacheFileInfo = Path::getCacheFileInfo(cacheFileName);
+    if (!cacheFileInfo.exists()) {
+        return 0;
+    }
+
+    QFile cacheFile(cacheFileInfo.absoluteFilePath());
+    if (!cacheFile.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    // The file is the binary format followed by the program binary itself
+    QByteArray data = cacheFile.readAll();
+    GLenum binaryFormat;
+    if (data.size() <= (int)sizeof(binaryFormat)) {
+        Path::deleteCacheFile(cacheFileName);
+        return 0;
+    }
+    memcpy(&binaryFormat, data.constData(), sizeof(binaryFormat));
+
+    unsigned program = glCreateProgram();
+    if (!program) {
+        return 0;
+    }
+
+    m_glProgramBinaryOES(program, binaryFormat,
+                         data.constData() + sizeof(binaryFormat),
+                         data.size() - sizeof(binaryFormat));
+
+    // The driver may reject binaries from an older build of itself
+    // even if it reports the same version string.
+    int status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        EGL_LOG(Warn, "Discarding invalid program binary: %s", cacheFileName.toUtf8().constData());
+        glDeleteProgram(program);
+        Path::deleteCacheFile(cacheFileName);
+        return 0;
+    }
+
+    return program;
+}
+
+void EGLRenderer::saveCachedProgram(unsigned program, const QString& cacheFileName) {
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    GLenum binaryFormat;
+    QByteArray data(sizeof(binaryFormat) + length, 0);
+    m_glGetProgramBinaryOES(program, length, &length, &binaryFormat,
+                            data.data() + sizeof(binaryFormat));
+    if (glGetError() != GL_NO_ERROR || length <= 0) {
+        EGL_LOG(Warn, "Failed to retrieve program binary");
+        return;
+    }
+
+    memcpy(data.data(), &binaryFormat, sizeof(binaryFormat));
+    data.truncate(sizeof(binaryFormat) + length);
+
+    Path::writeCacheFile(cacheFileName, data);
+}
+
 unsigned EGLRenderer::compileShader(const char* vertexShaderSrc, const char* fragmentShaderSrc) {
     unsigned shader = 0;
+    QElapsedTimer compileTimer;
+    QString cacheFileName;
+    GLuint vertexShader, fragmentShader;
+
+    compileTimer.start();
+
+    QByteArray vertexShaderSource = Path::readDataFile(vertexShaderSrc);
+    QByteArray fragmentShaderSource = Path::readDataFile(fragmentShaderSrc);
+
+    // Try to skip the shader compiler entirely with a cached program binary
+    if (m_glProgramBinaryOES != nullptr) {
+        cacheFileName = getProgramCacheFileName(vertexShaderSource, fragmentShaderSource);
+        shader = loadCachedProgram(cacheFileName);
+        if (shader) {
+            EGL_LOG(Info, "Loaded cached program for %s and %s in %lld ms",
+                    vertexShaderSrc, fragmentShaderSrc,
+                    (long long)compileTimer.elapsed());
+            return shader;
+        }
+    }
 
-    GLuint vertexShader = loadAndBuildShader(GL_VERTEX_SHADER, vertexShaderSrc);
+    vertexShader = loadAndBuildShader(GL_VERTEX_SHADER, vertexShaderSrc, vertexShaderSource);
     if (!vertexShader)
         return false;
 
-    GLuint fragmentShader = loadAndBuildShader(GL_FRAGMENT_SHADER, fragmentShaderSrc);
+    fragmentShader = loadAndBuildShader(GL_FRAGMENT_SHADER, fragmentShaderSrc, fragmentShaderSource);
     if (!fragmentShader)
         goto fragError;
 
@@ -356,6 +475,15 @@ unsigned EGLRenderer::compileShader(const char* vertexShaderSrc, const char* fra
         glDeleteProgram(shader);
         shader = 0;
     }
+    else {
+        EGL_LOG(Info, "Compiled program for %s and %s in %lld ms",
+                vertexShaderSrc, fragmentShaderSrc,
+                (long long)compileTimer.elapsed());
+
+        if (m_glGetProgramBinaryOES != nullptr) {
+            saveCachedProgram(shader, cacheFileName);
+        }
+    }
 
 progFailCreate:
     glDeleteShader(fragmentShader);
@@ -553,6 +681,22 @@ bool EGLRenderer::initialize(PDECODER_PARAMETERS params)
         return false;
     }
 
+    // Program binaries let us skip shader compilation on subsequent runs.
+    // Some drivers expose the extension but don't support any formats.
+    if (SDL_GL_ExtensionSupported("GL_OES_get_program_binary")) {
+        int formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formatCount);
+        if (formatCount > 0) {
+            m_glGetProgramBinaryOES = (typeof(m_glGetProgramBinaryOES))eglGetProcAddress("glGetProgramBinaryOES");
+            m_glProgramBinaryOES = (typeof(m_glProgramBinaryOES))eglGetProcAddress("glProgramBinaryOES");
+        }
+
+        if (!m_glGetProgramBinaryOES || !m_glProgramBinaryOES) {
+            m_glGetProgramBinaryOES = nullptr;
+            m_glProgramBinaryOES = nullptr;
+        }
+    }
+
     /* Compute the video region size in order to keep the aspect ratio of the
      * video stream.
      */
@@ -583,6 +727,7 @@ bool EGLRenderer::initialize(PDECODER_PARAMETERS params)
 #endif
         {
             m_BlockingSwapBuffers = true;
+            initializeSwapThrottle();
         }
     } else {
         SDL_GL_SetSwapInterval(0);
@@ -754,7 +899,7 @@ bool EGLRenderer::specialize() {
 
 void EGLRenderer::renderFrame(AVFrame* frame)
 {
-    EGLImage imgs[EGL_MAX_PLANES];
+    EGLImage imgs[EGL_MAX_PLANES] = {};
 
     if (frame == nullptr) {
         // End of stream - unbind the GL context
@@ -815,16 +960,15 @@ void EGLRenderer::renderFrame(AVFrame* frame)
 
     SDL_GL_SwapWindow(m_Window);
 
+    if (m_BlockingSwapBuffers && m_SwapThrottleMode == SwapThrottleFence) {
+        // The GPU may still be sampling this frame after we return, so the
+        // frame and its EGLImages stay alive until its fence signals.
+        queueFrameInFlight(frame, imgs);
+        return;
+    }
+
     if (m_BlockingSwapBuffers) {
-        // This glClear() forces us to block until the buffer swap is
-        // complete to continue rendering. Mesa won't actually wait
-        // for the swap with just glFinish() alone. Waiting here keeps us
-        // in lock step with the display refresh rate. If we don't wait
-        // here, we'll stall on the first GL call next frame. Doing the
-        // wait here instead allows more time for a newer frame to arrive
-        // for next renderFrame() call.
-        glClear(GL_COLOR_BUFFER_BIT);
-        glFinish();
+        throttleSwap();
     }
 
     m_Backend->freeEGLImages(m_EGLDisplay, imgs);
@@ -838,9 +982,135 @@ void EGLRenderer::renderFrame(AVFrame* frame)
     av_frame_move_ref(m_LastFrame, frame);
 }
 
+void EGLRenderer::initializeSwapThrottle()
+{
+    QByteArray throttleMode = qgetenv("EGL_SWAP_THROTTLE");
+    if (throttleMode.isEmpty() || throttleMode == "finish") {
+        return;
+    }
+    else if (throttleMode != "fence") {
+        EGL_LOG(Warn, "Unknown swap throttle mode: %s", throttleMode.constData());
+        return;
+    }
+
+    const EGLExtensions eglExtensions(m_EGLDisplay);
+    if (!eglExtensions.isSupported("EGL_KHR_fence_sync")) {
+        EGL_LOG(Warn, "EGL_KHR_fence_sync unsupported; using glFinish() swap throttling");
+        return;
+    }
+
+    m_eglCreateSyncKHR = (typeof(m_eglCreateSyncKHR))eglGetProcAddress("eglCreateSyncKHR");
+    m_eglClientWaitSyncKHR = (typeof(m_eglClientWaitSyncKHR))eglGetProcAddress("eglClientWaitSyncKHR");
+    m_eglDestroySyncKHR = (typeof(m_eglDestroySyncKHR))eglGetProcAddress("eglDestroySyncKHR");
+    if (!m_eglCreateSyncKHR || !m_eglClientWaitSyncKHR || !m_eglDestroySyncKHR) {
+        EGL_LOG(Warn, "Failed to find EGL fence sync functions; using glFinish() swap throttling");
+        return;
+    }
+
+    if (qEnvironmentVariableIsSet("EGL_MAX_FRAMES_IN_FLIGHT")) {
+        m_MaxFramesInFlight = qBound(1, qEnvironmentVariableIntValue("EGL_MAX_FRAMES_IN_FLIGHT"), MAX_MAX_FRAMES_IN_FLIGHT);
+        EGL_LOG(Warn, "Using custom max frames in flight: %d", m_MaxFramesInFlight);
+    }
+
+    m_SwapThrottleMode = SwapThrottleFence;
+    EGL_LOG(Info, "Using fence-based swap throttling (%d frames in flight)", m_MaxFramesInFlight);
+}
+
+void EGLRenderer::throttleSwap()
+{
+    Uint64 waitStart = SDL_GetPerformanceCounter();
+
+    // This glClear() forces us to block until the buffer swap is
+    // complete to continue rendering. Mesa won't actually wait
+    // for the swap with just glFinish() alone. Waiting here keeps us
+    // in lock step with the display refresh rate. If we don't wait
+    // here, we'll stall on the first GL call next frame. Doing the
+    // wait here instead allows more time for a newer frame to arrive
+    // for next renderFrame() call.
+    glClear(GL_COLOR_BUFFER_BIT);
+    glFinish();
+
+    m_LastRenderWaitTimeUs = (SDL_GetPerformanceCounter() - waitStart) * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+void EGLRenderer::queueFrameInFlight(AVFrame* frame, EGLImage images[EGL_MAX_PLANES])
+{
+    Uint64 waitStart = SDL_GetPerformanceCounter();
+    InFlightFrame inFlight;
+
+    inFlight.frame = av_frame_alloc();
+    memcpy(inFlight.images, images, sizeof(inFlight.images));
+    inFlight.fence = m_eglCreateSyncKHR(m_EGLDisplay, EGL_SYNC_FENCE_KHR, nullptr);
+    if (inFlight.fence == EGL_NO_SYNC_KHR) {
+        EGL_LOG(Error, "eglCreateSyncKHR() failed: %x", eglGetError());
+    }
+
+    if (inFlight.frame != nullptr && inFlight.fence != EGL_NO_SYNC_KHR) {
+        av_frame_move_ref(inFlight.frame, frame);
+        m_FramesInFlight.enqueue(inFlight);
+
+        // Only block once the GPU falls too far behind. This lets the upload
+        // of the next frame overlap with the GPU finishing the previous ones.
+        // The first wait flushes the context, so later ones need not.
+        EGLint flags = EGL_SYNC_FLUSH_COMMANDS_BIT_KHR;
+        while (m_FramesInFlight.size() > m_MaxFramesInFlight) {
+            releaseFrameInFlight(m_FramesInFlight.head(), flags);
+            m_FramesInFlight.dequeue();
+            flags = 0;
+        }
+    }
+    else {
+        // Without a fence to track this frame, wait for the GPU to finish
+        // everything, then release this frame and all earlier ones. The
+        // caller still owns the frame itself.
+        glFinish();
+
+        while (!m_FramesInFlight.isEmpty()) {
+            releaseFrameInFlight(m_FramesInFlight.head(), 0);
+            m_FramesInFlight.dequeue();
+        }
+
+        if (inFlight.fence != EGL_NO_SYNC_KHR) {
+            m_eglDestroySyncKHR(m_EGLDisplay, inFlight.fence);
+        }
+        m_Backend->freeEGLImages(m_EGLDisplay, inFlight.images);
+        av_frame_free(&inFlight.frame);
+    }
+
+    m_LastRenderWaitTimeUs = (SDL_GetPerformanceCounter() - waitStart) * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+void EGLRenderer::releaseFrameInFlight(InFlightFrame& inFlight, EGLint waitFlags)
+{
+    if (m_eglClientWaitSyncKHR(m_EGLDisplay, inFlight.fence, waitFlags, EGL_FOREVER_KHR) == EGL_FALSE) {
+        EGL_LOG(Error, "eglClientWaitSyncKHR() failed: %x", eglGetError());
+    }
+    m_eglDestroySyncKHR(m_EGLDisplay, inFlight.fence);
+
+    // Only now is it safe for FFmpeg to reuse the surface behind this frame
+    m_Backend->freeEGLImages(m_EGLDisplay, inFlight.images);
+    av_frame_free(&inFlight.frame);
+}
+
+Uint64 EGLRenderer::getLastRenderWaitTimeUs()
+{
+    return m_LastRenderWaitTimeUs;
+}
+
+int EGLRenderer::getMaxHeldFrames()
+{
+    if (m_BlockingSwapBuffers && m_SwapThrottleMode == SwapThrottleFence) {
+        // Frames stay in flight until their fences signal
+        return m_MaxFramesInFlight;
+    }
+
+    // We keep the last frame until the next one is rendered
+    return 1;
+}
+
 bool EGLRenderer::testRenderFrame(AVFrame* frame)
 {
-    EGLImage imgs[EGL_MAX_PLANES];
+    EGLImage imgs[EGL_MAX_PLANES] = {};
 
     // Make sure we can get working EGLImages from the backend renderer.
     // Some devices (Raspberry Pi) will happily decode into DRM formats that
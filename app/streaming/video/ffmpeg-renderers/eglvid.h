@@ -5,6 +5,8 @@
 #include <SDL_opengles2.h>
 #include <SDL_opengles2_gl2ext.h>
 
+#include <QQueue>
+
 class EGLRenderer : public IFFmpegRenderer {
 public:
     EGLRenderer(IFFmpegRenderer *backendRenderer);
@@ -16,17 +18,33 @@ public:
     virtual void notifyOverlayUpdated(Overlay::OverlayType) override;
     virtual bool isPixelFormatSupported(int videoFormat, enum AVPixelFormat pixelFormat) override;
     virtual AVPixelFormat getPreferredPixelFormat(int videoFormat) override;
+    virtual Uint64 getLastRenderWaitTimeUs() override;
+    virtual int getMaxHeldFrames() override;
 
 private:
 
     void renderOverlay(Overlay::OverlayType type);
     unsigned compileShader(const char* vertexShaderSrc, const char* fragmentShaderSrc);
+    QString getProgramCacheFileName(const QByteArray& vertexShaderSource, const QByteArray& fragmentShaderSource);
+    unsigned loadCachedProgram(const QString& cacheFileName);
+    void saveCachedProgram(unsigned program, const QString& cacheFileName);
     bool compileShaders();
     bool specialize();
     const float *getColorOffsets(const AVFrame* frame);
     const float *getColorMatrix(const AVFrame* frame);
-    static int loadAndBuildShader(int shaderType, const char *filename);
+    static int loadAndBuildShader(int shaderType, const char *filename, const QByteArray& sourceData);
     bool openDisplay(unsigned int platform, void* nativeDisplay);
+    void initializeSwapThrottle();
+    void throttleSwap();
+    void queueFrameInFlight(AVFrame* frame, EGLImage images[EGL_MAX_PLANES]);
+
+    // A swapped frame whose source surface the GPU may still be reading
+    struct InFlightFrame {
+        AVFrame* frame;
+        EGLImage images[EGL_MAX_PLANES];
+        EGLSyncKHR fence;
+    };
+    void releaseFrameInFlight(InFlightFrame& inFlight, EGLint waitFlags);
 
     int m_ViewportWidth;
     int m_ViewportHeight;
@@ -44,11 +62,25 @@ private:
     IFFmpegRenderer *m_Backend;
     unsigned int m_VAO;
     bool m_BlockingSwapBuffers;
+
+    enum SwapThrottleMode {
+        SwapThrottleFinish,
+        SwapThrottleFence,
+    };
+    SwapThrottleMode m_SwapThrottleMode;
+    int m_MaxFramesInFlight;
+    QQueue<InFlightFrame> m_FramesInFlight;
+    Uint64 m_LastRenderWaitTimeUs;
     AVFrame* m_LastFrame;
     PFNGLEGLIMAGETARGETTEXTURE2DOESPROC m_glEGLImageTargetTexture2DOES;
     PFNGLGENVERTEXARRAYSOESPROC m_glGenVertexArraysOES;
     PFNGLBINDVERTEXARRAYOESPROC m_glBindVertexArrayOES;
     PFNGLDELETEVERTEXARRAYSOESPROC m_glDeleteVertexArraysOES;
+    PFNGLGETPROGRAMBINARYOESPROC m_glGetProgramBinaryOES;
+    PFNGLPROGRAMBINARYOESPROC m_glProgramBinaryOES;
+    PFNEGLCREATESYNCKHRPROC m_eglCreateSyncKHR;
+    PFNEGLCLIENTWAITSYNCKHRPROC m_eglClientWaitSyncKHR;
+    PFNEGLDESTROYSYNCKHRPROC m_eglDestroySyncKHR;
 
 #define NV12_PARAM_YUVMAT 0
 #define NV12_PARAM_OFFSET 1
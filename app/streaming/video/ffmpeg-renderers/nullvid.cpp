@@ -0,0 +1,124 @@
+#include "nullvid.h"
+
+#include <QtGlobal>
+
+extern "C" {
+#include <libavutil/adler32.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+NullRenderer::NullRenderer()
+    : m_ChecksumFrames(false),
+      m_Checksum(1),
+      m_FramesRendered(0),
+      m_FramesChecksummed(0),
+      m_BytesChecksummed(0),
+      m_FirstFrameTime(0),
+      m_LastFrameTime(0)
+{
+
+}
+
+NullRenderer::~NullRenderer()
+{
+    if (m_FramesRendered == 0) {
+        return;
+    }
+
+    uint32_t elapsedMs = m_LastFrameTime - m_FirstFrameTime;
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Null renderer consumed %u frames in %u ms (%.2f FPS)",
+                m_FramesRendered,
+                elapsedMs,
+                elapsedMs != 0 ? (m_FramesRendered - 1) * 1000.0f / elapsedMs : 0.0f);
+
+    if (m_ChecksumFrames) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Null renderer checksummed %u frames (%llu bytes): %08x",
+                    m_FramesChecksummed,
+                    (unsigned long long)m_BytesChecksummed,
+                    m_Checksum);
+    }
+}
+
+bool NullRenderer::initialize(PDECODER_PARAMETERS)
+{
+    // Checksumming software frames lets us compare decoder output between runs
+    m_ChecksumFrames = qEnvironmentVariableIntValue("NULL_RENDERER_CHECKSUM") != 0;
+    if (m_ChecksumFrames) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Checksumming decoded frames (NULL_RENDERER_CHECKSUM)");
+    }
+
+    return true;
+}
+
+bool NullRenderer::prepareDecoderContext(AVCodecContext*, AVDictionary**)
+{
+    /* Nothing to do */
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Using null renderer");
+
+    return true;
+}
+
+bool NullRenderer::canRecreateDecoderContext()
+{
+    return true;
+}
+
+bool NullRenderer::isPixelFormatSupported(int, AVPixelFormat pixelFormat)
+{
+    // We never look at the pixels (except to checksum them),
+    // so we can take any software format the decoder gives us.
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixelFormat);
+    return desc != nullptr && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL);
+}
+
+void NullRenderer::checksumFrame(AVFrame* frame)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    int rowBytes[4];
+
+    // Hardware frames stay in GPU memory, so there's nothing to checksum
+    if (desc == nullptr || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+        return;
+    }
+
+    if (av_image_fill_linesizes(rowBytes, (AVPixelFormat)frame->format, frame->width) < 0) {
+        return;
+    }
+
+    // Only checksum the visible portion of each row, since the padding
+    // is uninitialized and may differ between runs.
+    for (int i = 0; i < 4 && frame->data[i] != nullptr; i++) {
+        int rows = (i == 1 || i == 2) ?
+                    AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) :
+                    frame->height;
+
+        for (int y = 0; y < rows; y++) {
+            m_Checksum = av_adler32_update(m_Checksum,
+                                           frame->data[i] + (size_t)frame->linesize[i] * y,
+                                           rowBytes[i]);
+        }
+
+        m_BytesChecksummed += (uint64_t)rowBytes[i] * rows;
+    }
+
+    m_FramesChecksummed++;
+}
+
+void NullRenderer::renderFrame(AVFrame* frame)
+{
+    m_LastFrameTime = SDL_GetTicks();
+    if (m_FramesRendered++ == 0) {
+        m_FirstFrameTime = m_LastFrameTime;
+    }
+
+    if (m_ChecksumFrames) {
+        checksumFrame(frame);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "renderer.h"
+
+// Discards decoded frames instead of displaying them. This is used for
+// headless streaming to measure decoder throughput without a display.
+class NullRenderer : public IFFmpegRenderer {
+public:
+    NullRenderer();
+    virtual ~NullRenderer() override;
+    virtual bool initialize(PDECODER_PARAMETERS params) override;
+    virtual bool prepareDecoderContext(AVCodecContext* context, AVDictionary** options) override;
+    virtual bool canRecreateDecoderContext() override;
+    virtual void renderFrame(AVFrame* frame) override;
+    virtual bool isPixelFormatSupported(int videoFormat, enum AVPixelFormat pixelFormat) override;
+
+private:
+    void checksumFrame(AVFrame* frame);
+
+    bool m_ChecksumFrames;
+    uint32_t m_Checksum;
+    uint32_t m_FramesRendered;
+    uint32_t m_FramesChecksummed;
+    uint64_t m_BytesChecksummed;
+    uint32_t m_FirstFrameTime;
+    uint32_t m_LastFrameTime;
+};
@@ -0,0 +1,22 @@
+#include "heldframes.h"
+
+#include <QtGlobal>
+
+int HeldFrames::getMaxHeldFrames(bool vsyncPacing, int maxPacingDepth,
+                                 int maxQueuedFrames, int rendererHeldFrames)
+{
+    int queuedFrames;
+
+    if (vsyncPacing) {
+        // The pacing queue is trimmed down to the pacing depth plus the
+        // leniency, and V-sync moves one frame at a time to the render queue
+        queuedFrames = qMin(maxPacingDepth + PACING_QUEUE_DROP_LENIENCY, maxQueuedFrames) + 1;
+    }
+    else {
+        // Without V-sync pacing, only the render queue holds frames
+        queuedFrames = qMin(PACING_QUEUE_DROP_LENIENCY, maxQueuedFrames);
+    }
+
+    // Add the frame being rendered
+    return queuedFrames + 1 + rendererHeldFrames;
+}
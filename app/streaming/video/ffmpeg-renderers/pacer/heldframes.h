@@ -0,0 +1,20 @@
+#pragma once
+
+// How many frames past their drop target Pacer lets its queues grow before
+// dropping frames, as long as they shrink again soon after. Frames within
+// this leniency hold surfaces from the decoder's pool.
+#define PACING_QUEUE_DROP_LENIENCY 2
+
+// Counts the decoded frames that Pacer and the renderer can hold outside
+// of the decoder. A hardware decoder with a fixed surface pool needs this
+// many surfaces on top of its reference frames, or it has to wait for us
+// to release one before it can decode the next frame.
+class HeldFrames
+{
+public:
+    // vsyncPacing is true if frames wait in the pacing queue for V-sync.
+    // rendererHeldFrames are frames the renderer keeps after rendering.
+    static
+    int getMaxHeldFrames(bool vsyncPacing, int maxPacingDepth,
+                         int maxQueuedFrames, int rendererHeldFrames);
+};
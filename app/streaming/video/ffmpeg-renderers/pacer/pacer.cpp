@@ -1,5 +1,7 @@
 #include "pacer.h"
+#include "heldframes.h"
 #include "streaming/streamutils.h"
+#include "streaming/threadroles.h"
 
 #include "nullthreadedvsyncsource.h"
 
@@ -13,6 +15,7 @@
 // Limit the number of queued frames to prevent excessive memory consumption
 // if the V-Sync source or renderer is blocked for a while.
 #define MAX_QUEUED_FRAMES 8
+#define LOW_MEMORY_MAX_QUEUED_FRAMES 2
 
 // We may be woken up slightly late so don't go all the way
 // up to the next V-sync since we may accidentally step into
@@ -21,16 +24,44 @@
 // V-sync happens.
 #define TIMER_SLACK_MS 3
 
+// The most frames that we'll hold back to absorb frame arrival jitter.
+// Each one adds a frame of latency.
+#define MAX_PACING_DEPTH 4
+#define LOW_MEMORY_MAX_PACING_DEPTH 1
+
+// Bounds for the safety margin that just-in-time render scheduling
+// leaves between the end of rendering and V-sync. The margin grows
+// on each missed V-sync and shrinks after a run of on-time frames.
+#define MIN_JIT_MARGIN_US 1000
+#define JIT_MARGIN_STEP_US 500
+#define JIT_MARGIN_SHRINK_FRAMES 120
+
 Pacer::Pacer(IFFmpegRenderer* renderer, PVIDEO_STATS videoStats) :
+    m_PacingDepthEstimator(nullptr),
+    m_PacingDepth(1),
+    m_PacingQueueFilling(false),
+    m_JitScheduling(false),
+    m_RenderCostUs(0),
+    m_JitMarginUs(TIMER_SLACK_MS * 1000),
+    m_JitOnTimeFrames(0),
+    m_JitReleaseTime(0),
+    m_JitDeadline(0),
     m_RenderThread(nullptr),
     m_Stopping(false),
+    m_MaxQueuedFrames(MAX_QUEUED_FRAMES),
+    m_MaxPacingDepth(MAX_PACING_DEPTH),
     m_VsyncSource(nullptr),
     m_VsyncRenderer(renderer),
     m_MaxVideoFps(0),
     m_DisplayFps(0),
     m_VideoStats(videoStats)
 {
-
+    // Every queued 4K frame costs over 12 MB, so don't buffer
+    // frames for jitter when memory is tight
+    if (StreamUtils::isLowMemoryProfileEnabled()) {
+        m_MaxQueuedFrames = LOW_MEMORY_MAX_QUEUED_FRAMES;
+        m_MaxPacingDepth = LOW_MEMORY_MAX_PACING_DEPTH;
+    }
 }
 
 Pacer::~Pacer()
@@ -59,6 +90,8 @@ Pacer::~Pacer()
         AVFrame* frame = m_PacingQueue.dequeue();
         av_frame_free(&frame);
     }
+
+    delete m_PacingDepthEstimator;
 }
 
 void Pacer::renderOnMainThread()
@@ -83,11 +116,7 @@ int Pacer::renderThread(void* context)
 {
     Pacer* me = reinterpret_cast<Pacer*>(context);
 
-    if (SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH) < 0) {
-        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                    "Unable to set render thread to high priority: %s",
-                    SDL_GetError());
-    }
+    ThreadRoles::applyToCurrentThread(ThreadRoles::RoleRender);
 
     while (!me->m_Stopping) {
         // Acquire the frame queue lock to protect the queue and
@@ -172,21 +201,43 @@ void Pacer::vsyncCallback(int timeUntilNextVsyncMillis)
 
     SDL_assert(timeUntilNextVsyncMillis >= TIMER_SLACK_MS);
 
+    Uint64 nextVsyncTime = SDL_GetPerformanceCounter() + SDL_GetPerformanceFrequency() * timeUntilNextVsyncMillis / 1000;
+    int frameWaitTimeMs = timeUntilNextVsyncMillis - TIMER_SLACK_MS;
+
+    if (m_JitScheduling) {
+        m_FrameQueueLock.lock();
+        int leadTimeUs = m_RenderCostUs + m_JitMarginUs;
+        m_FrameQueueLock.unlock();
+
+        // Sleep until we must start rendering to make the next V-sync.
+        // Any frame that arrives in the meantime can still be displayed
+        // on that V-sync, rather than waiting for the one after it.
+        int sleepTimeMs = (timeUntilNextVsyncMillis * 1000 - leadTimeUs) / 1000;
+        if (sleepTimeMs > 0) {
+            SDL_Delay(sleepTimeMs);
+        }
+
+        // Only wait for a frame as long as it could still make the next V-sync
+        Uint64 now = SDL_GetPerformanceCounter();
+        frameWaitTimeMs = now < nextVsyncTime ?
+                    (int)((nextVsyncTime - now) * 1000 / SDL_GetPerformanceFrequency()) - (leadTimeUs + 999) / 1000 : 0;
+    }
+
     m_FrameQueueLock.lock();
 
     // If the queue length history entries are large, be strict
     // about dropping excess frames.
-    int frameDropTarget = 1;
+    int frameDropTarget = m_PacingDepth;
 
     // If we may get more frames per second than we can display, use
     // frame history to drop frames only if consistently above the
-    // one queued frame mark.
+    // pacing depth.
     if (m_MaxVideoFps >= m_DisplayFps) {
         for (int queueHistoryEntry : m_PacingQueueHistory) {
-            if (queueHistoryEntry <= 1) {
+            if (queueHistoryEntry <= m_PacingDepth) {
                 // Be lenient as long as the queue length
                 // resolves before the end of frame history
-                frameDropTarget = 3;
+                frameDropTarget = m_PacingDepth + PACING_QUEUE_DROP_LENIENCY;
                 break;
             }
         }
@@ -210,23 +261,74 @@ void Pacer::vsyncCallback(int timeUntilNextVsyncMillis)
         m_FrameQueueLock.lock();
     }
 
+    if (m_PacingQueueFilling) {
+        if (m_PacingQueue.count() < m_PacingDepth) {
+            // Show the current frame for another V-sync to let the queue
+            // grow to the new pacing depth. Frames keep arriving at the
+            // stream rate, so it gains a frame for each V-sync we skip.
+            m_FrameQueueLock.unlock();
+            return;
+        }
+
+        m_PacingQueueFilling = false;
+    }
+
     if (m_PacingQueue.isEmpty()) {
         // Wait for a frame to arrive or our V-sync timeout to expire
-        if (!m_PacingQueueNotEmpty.wait(&m_FrameQueueLock, timeUntilNextVsyncMillis - TIMER_SLACK_MS)) {
+        if (frameWaitTimeMs <= 0 || !m_PacingQueueNotEmpty.wait(&m_FrameQueueLock, frameWaitTimeMs)) {
             // Wait timed out - unlock and bail
             m_FrameQueueLock.unlock();
             return;
         }
     }
 
+    // Remember when this frame must be done rendering
+    m_JitReleaseTime = SDL_GetPerformanceCounter();
+    m_JitDeadline = nextVsyncTime;
+
     // Place the first frame on the render queue
     enqueueFrameForRenderingAndUnlock(m_PacingQueue.dequeue());
 }
 
+// Caller must hold m_FrameQueueLock
+void Pacer::updateRenderDeadline(Uint64 frameReadyTime)
+{
+    if (m_JitReleaseTime == 0) {
+        return;
+    }
+
+    // Keep a rolling 1 second window of render costs and schedule for the
+    // worst of them, since a single slow frame costs a whole V-sync period.
+    int renderCostUs = (int)((frameReadyTime - m_JitReleaseTime) * 1000000 / SDL_GetPerformanceFrequency());
+    if (m_RenderCostsUs.count() == m_DisplayFps) {
+        m_RenderCostsUs.dequeue();
+    }
+    m_RenderCostsUs.enqueue(qMin(renderCostUs, 1000000 / m_DisplayFps));
+
+    m_RenderCostUs = 0;
+    for (int cost : m_RenderCostsUs) {
+        m_RenderCostUs = qMax(m_RenderCostUs, cost);
+    }
+
+    if (frameReadyTime > m_JitDeadline) {
+        // We missed V-sync, so back off immediately
+        m_VideoStats->renderDeadlineMisses++;
+        m_JitMarginUs = qMin(m_JitMarginUs + JIT_MARGIN_STEP_US, 500000 / m_DisplayFps);
+        m_JitOnTimeFrames = 0;
+    }
+    else if (++m_JitOnTimeFrames == JIT_MARGIN_SHRINK_FRAMES) {
+        m_JitMarginUs = qMax(m_JitMarginUs - JIT_MARGIN_STEP_US, MIN_JIT_MARGIN_US);
+        m_JitOnTimeFrames = 0;
+    }
+
+    m_JitReleaseTime = 0;
+}
+
 bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing)
 {
     m_MaxVideoFps = maxVideoFps;
     m_DisplayFps = StreamUtils::getDisplayRefreshRate(window);
+    m_PacingDepthEstimator = new PacingDepthEstimator(m_MaxVideoFps, m_MaxPacingDepth);
 
     if (enablePacing) {
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
@@ -244,6 +346,21 @@ bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing)
         // immediately like they used to.
     #endif
 
+        // Rendering just in time requires knowing when V-sync happens
+        m_JitScheduling = m_VsyncSource != nullptr;
+        if (m_JitScheduling && qgetenv("PACER_JIT_SCHEDULING") == "0") {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Just-in-time render scheduling disabled by environment variable");
+            m_JitScheduling = false;
+        }
+        else if (m_JitScheduling && m_VsyncRenderer->isPresentBlocking()) {
+            // We can't tell how long rendering took if the renderer also
+            // waits for V-sync, so every frame would look like a miss
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Just-in-time render scheduling disabled for blocking present");
+            m_JitScheduling = false;
+        }
+
         if (m_VsyncSource != nullptr && !m_VsyncSource->initialize(window, m_DisplayFps)) {
             return false;
         }
@@ -269,21 +386,35 @@ void Pacer::renderFrame(AVFrame* frame)
 
     // Render it
     m_VsyncRenderer->renderFrame(frame);
+    Uint64 renderEndTime = SDL_GetPerformanceCounter();
     Uint32 afterRender = SDL_GetTicks();
 
+    Uint64 renderWaitTimeUs = m_VsyncRenderer->getLastRenderWaitTimeUs();
     m_VideoStats->totalRenderTime += afterRender - beforeRender;
+    m_VideoStats->totalRenderWaitTimeUs += renderWaitTimeUs;
     m_VideoStats->renderedFrames++;
     av_frame_free(&frame);
 
     // Drop frames if we have too many queued up for a while
     m_FrameQueueLock.lock();
 
+    if (m_JitScheduling) {
+        // The frame was ready once the renderer started waiting for the
+        // GPU or V-sync, so that's what must beat the deadline
+        Uint64 renderWaitTime = renderWaitTimeUs * SDL_GetPerformanceFrequency() / 1000000;
+        updateRenderDeadline(renderEndTime - qMin(renderWaitTime, renderEndTime - m_JitReleaseTime));
+    }
+
+    m_VideoStats->totalPacingDepth += m_PacingDepth;
+
+    // The render queue is always drained down to its newest frame, so only
+    // the pacing queue can hold frames back for the pacing depth.
     int frameDropTarget = 0;
     for (int queueHistoryEntry : m_RenderQueueHistory) {
         if (queueHistoryEntry == 0) {
             // Be lenient as long as the queue length
             // resolves before the end of frame history
-            frameDropTarget = 2;
+            frameDropTarget = PACING_QUEUE_DROP_LENIENCY;
             break;
         }
     }
@@ -311,27 +442,123 @@ void Pacer::renderFrame(AVFrame* frame)
 
 void Pacer::dropFrameForEnqueue(QQueue<AVFrame*>& queue)
 {
-    SDL_assert(queue.size() <= MAX_QUEUED_FRAMES);
-    if (queue.size() == MAX_QUEUED_FRAMES) {
+    SDL_assert(queue.size() <= m_MaxQueuedFrames);
+    if (queue.size() == m_MaxQueuedFrames) {
         AVFrame* frame = queue.dequeue();
         av_frame_free(&frame);
     }
 }
 
+// Caller must hold m_FrameQueueLock
+void Pacer::updatePacingDepth(int pacingDepth)
+{
+    int oldPacingDepth = m_PacingDepth;
+
+    m_PacingDepth = pacingDepth;
+    if (m_PacingDepth > oldPacingDepth) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Increasing pacing depth to %d frames (frame arrival jitter: %.2f ms)",
+                    m_PacingDepth,
+                    m_PacingDepthEstimator->getJitterUs() / 1000.0);
+        m_PacingQueueFilling = true;
+    }
+    else if (m_PacingDepth < oldPacingDepth) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Decreasing pacing depth to %d frames",
+                    m_PacingDepth);
+    }
+}
+
+static Uint64 getFrameBytes(const QQueue<AVFrame*>& queue)
+{
+    Uint64 bytes = 0;
+
+    for (const AVFrame* frame : queue) {
+        // Hardware frames belong to the decoder's surface pool
+        if (frame->hw_frames_ctx != nullptr) {
+            continue;
+        }
+
+        for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i] != nullptr; i++) {
+            bytes += frame->buf[i]->size;
+        }
+    }
+
+    return bytes;
+}
+
+// Returns the memory held by software frames waiting in our queues
+Uint64 Pacer::getQueuedFrameBytes()
+{
+    QMutexLocker locker(&m_FrameQueueLock);
+
+    return getFrameBytes(m_PacingQueue) + getFrameBytes(m_RenderQueue);
+}
+
+// Returns the number of surfaces that a hardware decoder needs on top of
+// its reference frames, so the frames that we hold don't starve it.
+// This depends on our V-sync source, so call it after initialize().
+int Pacer::getExtraHwFrames()
+{
+    if (qEnvironmentVariableIsSet("HW_SURFACE_POOL_EXTRA")) {
+        int extraHwFrames = qMax(0, qEnvironmentVariableIntValue("HW_SURFACE_POOL_EXTRA"));
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Using custom extra hardware surface count: %d",
+                    extraHwFrames);
+        return extraHwFrames;
+    }
+
+    return HeldFrames::getMaxHeldFrames(m_VsyncSource != nullptr,
+                                        m_MaxPacingDepth,
+                                        m_MaxQueuedFrames,
+                                        m_VsyncRenderer->getMaxHeldFrames());
+}
+
+// Drops the oldest queued frame if another one is queued behind it
+bool Pacer::dropExcessFrame()
+{
+    QQueue<AVFrame*>& queue = m_VsyncSource != nullptr ? m_PacingQueue : m_RenderQueue;
+
+    m_FrameQueueLock.lock();
+    if (queue.count() <= 1) {
+        m_FrameQueueLock.unlock();
+        return false;
+    }
+
+    AVFrame* frame = queue.dequeue();
+    m_FrameQueueLock.unlock();
+
+    m_VideoStats->pacerDroppedFrames++;
+    av_frame_free(&frame);
+    return true;
+}
+
 void Pacer::submitFrame(AVFrame* frame)
 {
     // Make sure initialize() has been called
     SDL_assert(m_MaxVideoFps != 0);
 
-    // Queue the frame and possibly wake up the render thread
-    m_FrameQueueLock.lock();
     if (m_VsyncSource != nullptr) {
+        // Frames are only submitted by one thread at a time, so we can
+        // estimate the pacing depth without making the V-sync thread
+        // wait on m_FrameQueueLock while we do it.
+        Uint64 now = SDL_GetPerformanceCounter();
+        Uint64 freq = SDL_GetPerformanceFrequency();
+
+        // Split the conversion so large counter values can't overflow
+        int pacingDepth = m_PacingDepthEstimator->addFrameArrival((now / freq) * 1000000 + (now % freq) * 1000000 / freq);
+
+        // Queue the frame and wake up the V-sync thread
+        m_FrameQueueLock.lock();
+        updatePacingDepth(pacingDepth);
         dropFrameForEnqueue(m_PacingQueue);
         m_PacingQueue.enqueue(frame);
         m_FrameQueueLock.unlock();
         m_PacingQueueNotEmpty.wakeOne();
     }
     else {
+        // Queue the frame and possibly wake up the render thread
+        m_FrameQueueLock.lock();
         enqueueFrameForRenderingAndUnlock(frame);
     }
 }
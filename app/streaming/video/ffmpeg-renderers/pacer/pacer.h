@@ -2,6 +2,7 @@
 
 #include "../../decoder.h"
 #include "../renderer.h"
+#include "pacingdepth.h"
 
 #include <QQueue>
 #include <QMutex>
@@ -28,6 +29,12 @@ public:
 
     void renderOnMainThread();
 
+    bool dropExcessFrame();
+
+    Uint64 getQueuedFrameBytes();
+
+    int getExtraHwFrames();
+
 private:
     static int renderThread(void* context);
 
@@ -39,16 +46,42 @@ private:
 
     void dropFrameForEnqueue(QQueue<AVFrame*>& queue);
 
+    void updatePacingDepth(int pacingDepth);
+
+    void updateRenderDeadline(Uint64 frameReadyTime);
+
     QQueue<AVFrame*> m_RenderQueue;
     QQueue<AVFrame*> m_PacingQueue;
     QQueue<int> m_PacingQueueHistory;
     QQueue<int> m_RenderQueueHistory;
+
+    // Number of frames we try to keep in the pacing queue to absorb jitter
+    // in frame arrival times. While m_PacingQueueFilling is set, V-sync
+    // holds frames back until the queue has grown to a new, larger depth.
+    // These are protected by m_FrameQueueLock.
+    PacingDepthEstimator* m_PacingDepthEstimator;
+    int m_PacingDepth;
+    bool m_PacingQueueFilling;
+
+    // Just-in-time render scheduling state. Instead of rendering right
+    // after V-sync, we wait until the estimated render cost plus a safety
+    // margin before the next V-sync, so newer frames can make it in.
+    bool m_JitScheduling;
+    QQueue<int> m_RenderCostsUs;
+    int m_RenderCostUs;
+    int m_JitMarginUs;
+    int m_JitOnTimeFrames;
+    Uint64 m_JitReleaseTime;
+    Uint64 m_JitDeadline;
     QMutex m_FrameQueueLock;
     QWaitCondition m_RenderQueueNotEmpty;
     QWaitCondition m_PacingQueueNotEmpty;
     SDL_Thread* m_RenderThread;
     bool m_Stopping;
 
+    int m_MaxQueuedFrames;
+    int m_MaxPacingDepth;
+
     IVsyncSource* m_VsyncSource;
     IFFmpegRenderer* m_VsyncRenderer;
     int m_MaxVideoFps;
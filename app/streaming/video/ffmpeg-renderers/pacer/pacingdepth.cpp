@@ -0,0 +1,129 @@
+#include "pacingdepth.h"
+
+#include <QVector>
+
+#include <algorithm>
+
+// How long arrival jitter must stay low before we reduce the pacing depth
+#define PACING_DEPTH_SHRINK_DELAY_US 2000000
+
+// A gap this many frame intervals long is more than any pacing depth
+// could cover. It usually means the host stopped sending frames because
+// nothing on screen changed, so we start a new schedule after it.
+#define IDLE_GAP_FRAMES 8
+
+// Jitter over a 1 second window barely moves from one frame to the next,
+// so only refit the schedule this often to keep the per-frame cost low
+#define JITTER_UPDATE_INTERVAL_FRAMES 8
+
+PacingDepthEstimator::PacingDepthEstimator(int maxVideoFps, int maxPacingDepth) :
+    m_MaxVideoFps(maxVideoFps),
+    m_MaxPacingDepth(maxPacingDepth),
+    m_PacingDepth(1),
+    m_JitterUs(0),
+    m_FramesUntilUpdate(0),
+    m_ShrinkStartTimeUs(0)
+{
+
+}
+
+int PacingDepthEstimator::addFrameArrival(Uint64 arrivalTimeUs)
+{
+    if (!m_ArrivalTimesUs.isEmpty() &&
+            arrivalTimeUs - m_ArrivalTimesUs.last() > (Uint64)IDLE_GAP_FRAMES * 1000000 / m_MaxVideoFps) {
+        m_ArrivalTimesUs.clear();
+        m_FramesUntilUpdate = 0;
+    }
+
+    // Keep a rolling 1 second window of arrival times
+    if (m_ArrivalTimesUs.count() == m_MaxVideoFps) {
+        m_ArrivalTimesUs.dequeue();
+    }
+    m_ArrivalTimesUs.enqueue(arrivalTimeUs);
+
+    int count = m_ArrivalTimesUs.count();
+    if (count < m_MaxVideoFps || count < 2) {
+        // Wait until we have a full window
+        return m_PacingDepth;
+    }
+
+    if (m_FramesUntilUpdate > 0) {
+        m_FramesUntilUpdate--;
+        return m_PacingDepth;
+    }
+    m_FramesUntilUpdate = JITTER_UPDATE_INTERVAL_FRAMES - 1;
+
+    // Fit a steady schedule to the window by least squares. Using the
+    // measured frame interval keeps a host clock that runs slightly fast
+    // or slow, or a stream below the maximum frame rate, from looking
+    // like jitter.
+    double meanIndex = (count - 1) / 2.0;
+    double meanTimeUs = 0;
+    for (int i = 0; i < count; i++) {
+        meanTimeUs += (double)(m_ArrivalTimesUs[i] - m_ArrivalTimesUs[0]) / count;
+    }
+
+    double sumXY = 0, sumXX = 0;
+    for (int i = 0; i < count; i++) {
+        double timeUs = (double)(m_ArrivalTimesUs[i] - m_ArrivalTimesUs[0]);
+        sumXY += (i - meanIndex) * (timeUs - meanTimeUs);
+        sumXX += (i - meanIndex) * (i - meanIndex);
+    }
+
+    double frameIntervalUs = sumXY / sumXX;
+    if (frameIntervalUs <= 0) {
+        return m_PacingDepth;
+    }
+
+    QVector<int> deviationsUs(count);
+    for (int i = 0; i < count; i++) {
+        deviationsUs[i] = (int)((double)(m_ArrivalTimesUs[i] - m_ArrivalTimesUs[0]) - i * frameIntervalUs);
+    }
+
+    // Where the schedule starts is arbitrary, so measure how late the
+    // late frames are compared to a typical one
+    auto median = deviationsUs.begin() + count / 2;
+    std::nth_element(deviationsUs.begin(), median, deviationsUs.end());
+    int medianUs = *median;
+
+    auto p95 = deviationsUs.begin() + count * 95 / 100;
+    std::nth_element(deviationsUs.begin(), p95, deviationsUs.end());
+    m_JitterUs = *p95 - medianUs;
+
+    // A frame that arrives N frame intervals late needs N more frames
+    // queued ahead of it to avoid repeating a frame. Lateness of less
+    // than half a frame is absorbed by our V-sync timing slack.
+    int lateFrames = (int)((m_JitterUs + frameIntervalUs / 2) / frameIntervalUs);
+    int pacingDepth = qMin(1 + lateFrames, m_MaxPacingDepth);
+
+    if (pacingDepth > m_PacingDepth) {
+        // Grow right away, since we're already missing frames
+        m_PacingDepth = pacingDepth;
+        m_ShrinkStartTimeUs = 0;
+    }
+    else if (pacingDepth < m_PacingDepth) {
+        // Shrink one frame at a time once jitter has stayed low for a while
+        if (m_ShrinkStartTimeUs == 0) {
+            m_ShrinkStartTimeUs = arrivalTimeUs;
+        }
+        else if (arrivalTimeUs - m_ShrinkStartTimeUs >= PACING_DEPTH_SHRINK_DELAY_US) {
+            m_PacingDepth--;
+            m_ShrinkStartTimeUs = 0;
+        }
+    }
+    else {
+        m_ShrinkStartTimeUs = 0;
+    }
+
+    return m_PacingDepth;
+}
+
+int PacingDepthEstimator::getPacingDepth() const
+{
+    return m_PacingDepth;
+}
+
+int PacingDepthEstimator::getJitterUs() const
+{
+    return m_JitterUs;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <QQueue>
+
+// Chooses how many frames Pacer keeps queued to absorb jitter in frame
+// arrival times. It works only on the arrival times it's given, so it
+// can be driven by a fake clock.
+class PacingDepthEstimator
+{
+public:
+    PacingDepthEstimator(int maxVideoFps, int maxPacingDepth);
+
+    // Records a frame arriving at arrivalTimeUs and returns the new depth.
+    // The depth is only reevaluated every few frames.
+    int addFrameArrival(Uint64 arrivalTimeUs);
+
+    int getPacingDepth() const;
+
+    // The 95th percentile deviation of frame arrivals from their schedule,
+    // relative to the median deviation, as of the last full window
+    int getJitterUs() const;
+
+private:
+    int m_MaxVideoFps;
+    int m_MaxPacingDepth;
+
+    // Arrival times over the last second, without any idle gaps
+    QQueue<Uint64> m_ArrivalTimesUs;
+
+    int m_PacingDepth;
+    int m_JitterUs;
+    int m_FramesUntilUpdate;
+    Uint64 m_ShrinkStartTimeUs;
+};
@@ -134,6 +134,30 @@ public:
         return true;
     }
 
+    virtual bool canRecreateDecoderContext() {
+        // Renderers that keep per-context state from prepareDecoderContext()
+        // can't be attached to a second decoder context. The second context
+        // shares the hardware device created in initialize().
+        return false;
+    }
+
+    virtual Uint64 getLastRenderWaitTimeUs() {
+        // Time spent blocking on the GPU or display during the last
+        // renderFrame() call. Renderers that never wait report nothing.
+        return 0;
+    }
+
+    virtual int getMaxHeldFrames() {
+        // Most renderers are done with a frame once renderFrame() returns
+        return 0;
+    }
+
+    virtual bool isPresentBlocking() {
+        // True if renderFrame() can block until V-sync without reporting
+        // that time in getLastRenderWaitTimeUs()
+        return false;
+    }
+
     virtual AVPixelFormat getPreferredPixelFormat(int videoFormat) {
         if (videoFormat == VIDEO_FORMAT_H265_MAIN10) {
             // 10-bit YUV 4:2:0
@@ -176,7 +200,8 @@ public:
         return -1;
     }
 
-    // Free the ressources allocated during the last `exportEGLImages` call
+    // Free the ressources allocated by an `exportEGLImages` call. Images from
+    // several exports may be outstanding at once while frames are in flight.
     virtual void freeEGLImages(EGLDisplay, EGLImage[EGL_MAX_PLANES]) {}
 #endif
 };
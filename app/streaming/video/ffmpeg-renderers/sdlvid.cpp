@@ -2,14 +2,18 @@
 
 #include "streaming/session.h"
 #include "streaming/streamutils.h"
+#include "streaming/video/planecopy.h"
 
 #include <Limelight.h>
 
 SdlRenderer::SdlRenderer()
     : m_Renderer(nullptr),
-      m_Texture(nullptr),
-      m_SwPixelFormat(AV_PIX_FMT_NONE)
+      m_NextTexture(0),
+      m_SwPixelFormat(AV_PIX_FMT_NONE),
+      m_SoftwareDecoder(false),
+      m_SwFrame(nullptr)
 {
+    SDL_zero(m_Textures);
     SDL_zero(m_OverlayTextures);
 
 #ifdef HAVE_CUDA
@@ -31,18 +35,24 @@ SdlRenderer::~SdlRenderer()
         }
     }
 
-    if (m_Texture != nullptr) {
-        SDL_DestroyTexture(m_Texture);
+    for (int i = 0; i < k_TextureCount; i++) {
+        if (m_Textures[i] != nullptr) {
+            SDL_DestroyTexture(m_Textures[i]);
+        }
     }
 
+    av_frame_free(&m_SwFrame);
+
     if (m_Renderer != nullptr) {
         SDL_DestroyRenderer(m_Renderer);
     }
 }
 
-bool SdlRenderer::prepareDecoderContext(AVCodecContext*, AVDictionary**)
+bool SdlRenderer::prepareDecoderContext(AVCodecContext* context, AVDictionary**)
 {
-    /* Nothing to do */
+    // We're also used with hardware decoders that don't have a dedicated
+    // renderer, and we don't know how those handle missing references.
+    m_SoftwareDecoder = !(context->codec->capabilities & AV_CODEC_CAP_HARDWARE);
 
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                 "Using SDL renderer");
@@ -50,6 +60,32 @@ bool SdlRenderer::prepareDecoderContext(AVCodecContext*, AVDictionary**)
     return true;
 }
 
+bool SdlRenderer::canRecreateDecoderContext()
+{
+    return true;
+}
+
+int SdlRenderer::getDecoderCapabilities()
+{
+    if (m_SoftwareDecoder) {
+        // FFmpeg's software decoders keep the full DPB, so they can
+        // decode frames that were encoded around lost references.
+        int capabilities = CAPABILITY_REFERENCE_FRAME_INVALIDATION_HEVC;
+
+        // H.264 RFI costs us the SPS fixup and its low reordering latency,
+        // so it's opt-in until we can detect failed recoveries reliably
+        if (qEnvironmentVariableIntValue("ENABLE_AVC_RFI") != 0) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Using H.264 reference frame invalidation due to environment variable");
+            capabilities |= CAPABILITY_REFERENCE_FRAME_INVALIDATION_AVC;
+        }
+
+        return capabilities;
+    }
+
+    return 0;
+}
+
 bool SdlRenderer::isRenderThreadSupported()
 {
     SDL_RendererInfo info;
@@ -68,6 +104,15 @@ bool SdlRenderer::isRenderThreadSupported()
     return true;
 }
 
+bool SdlRenderer::isPresentBlocking()
+{
+    SDL_RendererInfo info;
+    SDL_GetRendererInfo(m_Renderer, &info);
+
+    // SDL_RenderPresent() waits for V-sync internally
+    return (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+}
+
 bool SdlRenderer::isPixelFormatSupported(int, AVPixelFormat pixelFormat)
 {
     // Remember to keep this in sync with SdlRenderer::renderFrame()!
@@ -203,10 +248,96 @@ void SdlRenderer::renderOverlay(Overlay::OverlayType type)
     }
 }
 
+AVFrame* SdlRenderer::getReadbackFrame(AVFrame* hwFrame)
+{
+    // Reuse the same read-back frame and buffers for every frame, rather
+    // than allocating new ones each time. We're done with the frame once
+    // renderFrame() returns, so a single frame is sufficient.
+    if (m_SwFrame != nullptr &&
+            (m_SwFrame->width != hwFrame->width || m_SwFrame->height != hwFrame->height)) {
+        av_frame_free(&m_SwFrame);
+    }
+
+    if (m_SwFrame == nullptr) {
+        m_SwFrame = av_frame_alloc();
+        if (m_SwFrame == nullptr) {
+            return nullptr;
+        }
+
+        m_SwFrame->width = hwFrame->width;
+        m_SwFrame->height = hwFrame->height;
+        m_SwFrame->format = m_SwPixelFormat;
+
+        // If the frame has buffers, av_hwframe_transfer_data() will transfer
+        // directly into them instead of allocating new ones.
+        int err = av_frame_get_buffer(m_SwFrame, 0);
+        if (err < 0) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "av_frame_get_buffer() failed: %d",
+                         err);
+            av_frame_free(&m_SwFrame);
+            return nullptr;
+        }
+    }
+
+    return m_SwFrame;
+}
+
+bool SdlRenderer::uploadFrame(SDL_Texture* texture, AVFrame* frame)
+{
+    // SDL_UpdateYUVTexture() and SDL_UpdateNVTexture() hand our planes
+    // straight to the render backend. Copying them ourselves first would
+    // add a copy, so PlaneCopy is only used where we fill the texture.
+    if (frame->format == AV_PIX_FMT_YUV420P) {
+        return SDL_UpdateYUVTexture(texture, nullptr,
+                                    frame->data[0],
+                                    frame->linesize[0],
+                                    frame->data[1],
+                                    frame->linesize[1],
+                                    frame->data[2],
+                                    frame->linesize[2]) == 0;
+    }
+
+#if SDL_VERSION_ATLEAST(2, 0, 15)
+    // SDL_UpdateNVTexture is not supported on all renderer backends,
+    // (notably not DX9), so we must have a fallback in case it's not
+    // supported and for earlier versions of SDL.
+    if (SDL_UpdateNVTexture(texture,
+                            nullptr,
+                            frame->data[0],
+                            frame->linesize[0],
+                            frame->data[1],
+                            frame->linesize[1]) == 0) {
+        return true;
+    }
+#endif
+
+    char* pixels;
+    int pitch;
+
+    int err = SDL_LockTexture(texture, nullptr, (void**)&pixels, &pitch);
+    if (err < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "SDL_LockTexture() failed: %s",
+                     SDL_GetError());
+        return false;
+    }
+
+    // The texture pitch may not match the frame's line size
+    PlaneCopy::copyNV12((Uint8*)pixels, pitch,
+                        (Uint8*)pixels + (pitch * frame->height), pitch,
+                        frame->data[0], frame->linesize[0],
+                        frame->data[1], frame->linesize[1],
+                        frame->width, frame->height, 1);
+
+    SDL_UnlockTexture(texture);
+    return true;
+}
+
 void SdlRenderer::renderFrame(AVFrame* frame)
 {
     int err;
-    AVFrame* swFrame = nullptr;
+    SDL_Texture* texture;
 
     if (frame == nullptr) {
         // End of stream - nothing to do for us
@@ -231,21 +362,17 @@ ReadbackRetry:
                         m_SwPixelFormat);
         }
 
-        swFrame = av_frame_alloc();
+        AVFrame* swFrame = getReadbackFrame(frame);
         if (swFrame == nullptr) {
             return;
         }
 
-        swFrame->width = frame->width;
-        swFrame->height = frame->height;
-        swFrame->format = m_SwPixelFormat;
-
         err = av_hwframe_transfer_data(swFrame, frame, 0);
         if (err != 0) {
             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                          "av_hwframe_transfer_data() failed: %d",
                          err);
-            goto Exit;
+            return;
         }
 
         // av_hwframe_transfer_data() can nuke frame metadata,
@@ -256,7 +383,7 @@ ReadbackRetry:
         frame = swFrame;
     }
 
-    if (m_Texture == nullptr) {
+    if (m_Textures[0] == nullptr) {
         Uint32 sdlFormat;
 
         // Remember to keep this in sync with SdlRenderer::isPixelFormatSupported()!
@@ -274,7 +401,7 @@ ReadbackRetry:
             break;
         default:
             SDL_assert(false);
-            goto Exit;
+            return;
         }
 
         switch (frame->colorspace)
@@ -289,16 +416,23 @@ ReadbackRetry:
             break;
         }
 
-        m_Texture = SDL_CreateTexture(m_Renderer,
-                                      sdlFormat,
-                                      SDL_TEXTUREACCESS_STREAMING,
-                                      frame->width,
-                                      frame->height);
-        if (!m_Texture) {
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                         "SDL_CreateTexture() failed: %s",
-                         SDL_GetError());
-            goto Exit;
+        for (int i = 0; i < k_TextureCount; i++) {
+            m_Textures[i] = SDL_CreateTexture(m_Renderer,
+                                              sdlFormat,
+                                              SDL_TEXTUREACCESS_STREAMING,
+                                              frame->width,
+                                              frame->height);
+            if (!m_Textures[i]) {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                             "SDL_CreateTexture() failed: %s",
+                             SDL_GetError());
+                if (i == 0) {
+                    return;
+                }
+
+                // We can still render with a single texture
+                break;
+            }
         }
 
 #ifdef HAVE_CUDA
@@ -306,76 +440,48 @@ ReadbackRetry:
             SDL_assert(m_CudaGLHelper == nullptr);
             m_CudaGLHelper = new CUDAGLInteropHelper(((AVHWFramesContext*)frame->hw_frames_ctx->data)->device_ctx);
 
-            SDL_GL_BindTexture(m_Texture, nullptr, nullptr);
+            SDL_GL_BindTexture(m_Textures[0], nullptr, nullptr);
             if (!m_CudaGLHelper->registerBoundTextures()) {
                 // If we can't register textures, fall back to normal read-back rendering
                 delete m_CudaGLHelper;
                 m_CudaGLHelper = nullptr;
             }
-            SDL_GL_UnbindTexture(m_Texture);
+            SDL_GL_UnbindTexture(m_Textures[0]);
         }
 #endif
     }
 
     if (frame->format == AV_PIX_FMT_CUDA) {
 #ifdef HAVE_CUDA
+        // CUDA interop is only registered with our first texture
+        texture = m_Textures[0];
         if (m_CudaGLHelper == nullptr || !m_CudaGLHelper->copyCudaFrameToTextures(frame)) {
             goto ReadbackRetry;
         }
 #else
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "Got CUDA frame, but not built with CUDA support!");
-        goto Exit;
+        return;
 #endif
     }
-    else if (frame->format == AV_PIX_FMT_YUV420P) {
-        SDL_UpdateYUVTexture(m_Texture, nullptr,
-                             frame->data[0],
-                             frame->linesize[0],
-                             frame->data[1],
-                             frame->linesize[1],
-                             frame->data[2],
-                             frame->linesize[2]);
-    }
     else {
-#if SDL_VERSION_ATLEAST(2, 0, 15)
-        // SDL_UpdateNVTexture is not supported on all renderer backends,
-        // (notably not DX9), so we must have a fallback in case it's not
-        // supported and for earlier versions of SDL.
-        if (SDL_UpdateNVTexture(m_Texture,
-                                nullptr,
-                                frame->data[0],
-                                frame->linesize[0],
-                                frame->data[1],
-                                frame->linesize[1]) != 0)
-#endif
-        {
-            char* pixels;
-            int pitch;
-
-            err = SDL_LockTexture(m_Texture, nullptr, (void**)&pixels, &pitch);
-            if (err < 0) {
-                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                             "SDL_LockTexture() failed: %s",
-                             SDL_GetError());
-                goto Exit;
-            }
-
-            memcpy(pixels,
-                   frame->data[0],
-                   frame->linesize[0] * frame->height);
-            memcpy(pixels + (frame->linesize[0] * frame->height),
-                   frame->data[1],
-                   frame->linesize[1] * frame->height / 2);
+        // Alternate between our textures if we have more than one
+        texture = m_Textures[m_NextTexture];
+        if (texture == nullptr) {
+            m_NextTexture = 0;
+            texture = m_Textures[0];
+        }
+        m_NextTexture = (m_NextTexture + 1) % k_TextureCount;
 
-            SDL_UnlockTexture(m_Texture);
+        if (!uploadFrame(texture, frame)) {
+            return;
         }
     }
 
     SDL_RenderClear(m_Renderer);
 
     // Draw the video content itself
-    SDL_RenderCopy(m_Renderer, m_Texture, nullptr, nullptr);
+    SDL_RenderCopy(m_Renderer, texture, nullptr, nullptr);
 
     // Draw the overlays
     for (int i = 0; i < Overlay::OverlayMax; i++) {
@@ -383,11 +489,6 @@ ReadbackRetry:
     }
 
     SDL_RenderPresent(m_Renderer);
-
-Exit:
-    if (swFrame != nullptr) {
-        av_frame_free(&swFrame);
-    }
 }
 
 bool SdlRenderer::testRenderFrame(AVFrame* frame)
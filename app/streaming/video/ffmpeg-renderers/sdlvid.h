@@ -12,17 +12,29 @@ public:
     virtual ~SdlRenderer() override;
     virtual bool initialize(PDECODER_PARAMETERS params) override;
     virtual bool prepareDecoderContext(AVCodecContext* context, AVDictionary** options) override;
+    virtual bool canRecreateDecoderContext() override;
     virtual void renderFrame(AVFrame* frame) override;
     virtual bool isRenderThreadSupported() override;
+    virtual bool isPresentBlocking() override;
+    virtual int getDecoderCapabilities() override;
     virtual bool isPixelFormatSupported(int videoFormat, enum AVPixelFormat pixelFormat) override;
     virtual bool testRenderFrame(AVFrame* frame) override;
 
 private:
     void renderOverlay(Overlay::OverlayType type);
+    AVFrame* getReadbackFrame(AVFrame* hwFrame);
+    bool uploadFrame(SDL_Texture* texture, AVFrame* frame);
+
+    // Frames are uploaded into alternating textures, so updating the texture
+    // for frame N doesn't have to wait for the GPU to finish drawing frame N-1.
+    static const int k_TextureCount = 2;
 
     SDL_Renderer* m_Renderer;
-    SDL_Texture* m_Texture;
+    SDL_Texture* m_Textures[k_TextureCount];
+    int m_NextTexture;
     int m_SwPixelFormat;
+    bool m_SoftwareDecoder;
+    AVFrame* m_SwFrame;
     SDL_Texture* m_OverlayTextures[Overlay::OverlayMax];
     SDL_Rect m_OverlayRects[Overlay::OverlayMax];
 
@@ -14,8 +14,6 @@ VAAPIRenderer::VAAPIRenderer()
       m_BlacklistedForDirectRendering(false)
 {
 #ifdef HAVE_EGL
-    m_PrimeDescriptor.num_layers = 0;
-    m_PrimeDescriptor.num_objects = 0;
     m_EGLExtDmaBuf = false;
 
     m_eglCreateImage = nullptr;
@@ -285,6 +283,12 @@ VAAPIRenderer::prepareDecoderContext(AVCodecContext* context, AVDictionary**)
     return true;
 }
 
+bool
+VAAPIRenderer::canRecreateDecoderContext()
+{
+    return true;
+}
+
 bool
 VAAPIRenderer::needsTestFrame()
 {
@@ -342,6 +346,29 @@ int VAAPIRenderer::getDecoderColorspace()
     return COLORSPACE_REC_601;
 }
 
+int VAAPIRenderer::getDecoderCapabilities()
+{
+    if (qgetenv("VAAPI_DISABLE_RFI") == "1") {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Reference frame invalidation disabled due to environment variable");
+        return 0;
+    }
+
+    // FFmpeg manages the reference picture lists for VAAPI hwaccels just
+    // like it does for software decoding, so missing references are handled
+    // the same way regardless of the driver.
+    int capabilities = CAPABILITY_REFERENCE_FRAME_INVALIDATION_HEVC;
+
+    // See SdlRenderer::getDecoderCapabilities()
+    if (qEnvironmentVariableIntValue("ENABLE_AVC_RFI") != 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Using H.264 reference frame invalidation due to environment variable");
+        capabilities |= CAPABILITY_REFERENCE_FRAME_INVALIDATION_AVC;
+    }
+
+    return capabilities;
+}
+
 void
 VAAPIRenderer::renderFrame(AVFrame* frame)
 {
@@ -519,31 +546,37 @@ VAAPIRenderer::exportEGLImages(AVFrame *frame, EGLDisplay dpy,
     ssize_t count = 0;
     auto hwFrameCtx = (AVHWFramesContext*)frame->hw_frames_ctx->data;
     AVVAAPIDeviceContext* vaDeviceContext = (AVVAAPIDeviceContext*)hwFrameCtx->device_ctx->hwctx;
+    VADRMPRIMESurfaceDescriptor primeDescriptor;
+
+    // The caller may hold images from several exports at once,
+    // so nothing about this export can be kept in the renderer.
+    memset(images, 0, sizeof(EGLImage) * EGL_MAX_PLANES);
 
     VASurfaceID surface_id = (VASurfaceID)(uintptr_t)frame->data[3];
     VAStatus st = vaExportSurfaceHandle(vaDeviceContext->display,
                                         surface_id,
                                         VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
                                         VA_EXPORT_SURFACE_READ_ONLY | VA_EXPORT_SURFACE_SEPARATE_LAYERS,
-                                        &m_PrimeDescriptor);
+                                        &primeDescriptor);
     if (st != VA_STATUS_SUCCESS) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "vaExportSurfaceHandle failed: %d", st);
         return -1;
     }
 
-    SDL_assert(m_PrimeDescriptor.num_layers <= EGL_MAX_PLANES);
+    SDL_assert(primeDescriptor.num_layers <= EGL_MAX_PLANES);
 
     st = vaSyncSurface(vaDeviceContext->display, surface_id);
     if (st != VA_STATUS_SUCCESS) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "vaSyncSurface failed: %d", st);
-        goto sync_fail;
+        count = -1;
+        goto close_fds;
     }
 
-    for (size_t i = 0; i < m_PrimeDescriptor.num_layers; ++i) {
-        const auto &layer = m_PrimeDescriptor.layers[i];
-        const auto &object = m_PrimeDescriptor.objects[layer.object_index[0]];
+    for (size_t i = 0; i < primeDescriptor.num_layers; ++i) {
+        const auto &layer = primeDescriptor.layers[i];
+        const auto &object = primeDescriptor.objects[layer.object_index[0]];
 
         const int EGL_ATTRIB_COUNT = 17;
         EGLAttrib attribs[EGL_ATTRIB_COUNT] = {
@@ -573,7 +606,9 @@ VAAPIRenderer::exportEGLImages(AVFrame *frame, EGLDisplay dpy,
             if (!images[i]) {
                 SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                              "eglCreateImage() Failed: %d", eglGetError());
-                goto create_image_fail;
+                freeEGLImages(dpy, images);
+                count = -1;
+                break;
             }
         }
         else {
@@ -589,36 +624,39 @@ VAAPIRenderer::exportEGLImages(AVFrame *frame, EGLDisplay dpy,
             if (!images[i]) {
                 SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                              "eglCreateImageKHR() Failed: %d", eglGetError());
-                goto create_image_fail;
+                freeEGLImages(dpy, images);
+                count = -1;
+                break;
             }
         }
 
         ++count;
     }
-    return count;
 
-create_image_fail:
-    m_PrimeDescriptor.num_layers = count;
-sync_fail:
-    freeEGLImages(dpy, images);
-    return -1;
+close_fds:
+    // EGL holds its own references to the DMA-BUFs once the images
+    // exist, so the exported FDs are no longer needed either way.
+    for (size_t i = 0; i < primeDescriptor.num_objects; ++i) {
+        close(primeDescriptor.objects[i].fd);
+    }
+    return count;
 }
 
 void
 VAAPIRenderer::freeEGLImages(EGLDisplay dpy, EGLImage images[EGL_MAX_PLANES]) {
-    for (size_t i = 0; i < m_PrimeDescriptor.num_layers; ++i) {
+    for (size_t i = 0; i < EGL_MAX_PLANES; ++i) {
+        if (images[i] == nullptr) {
+            continue;
+        }
+
         if (m_eglDestroyImage) {
             m_eglDestroyImage(dpy, images[i]);
         }
         else {
             m_eglDestroyImageKHR(dpy, images[i]);
         }
+        images[i] = nullptr;
     }
-    for (size_t i = 0; i < m_PrimeDescriptor.num_objects; ++i) {
-        close(m_PrimeDescriptor.objects[i].fd);
-    }
-    m_PrimeDescriptor.num_layers = 0;
-    m_PrimeDescriptor.num_objects = 0;
 }
 
 #endif
@@ -328,6 +328,11 @@ bool VDPAURenderer::prepareDecoderContext(AVCodecContext* context, AVDictionary*
     return true;
 }
 
+bool VDPAURenderer::canRecreateDecoderContext()
+{
+    return true;
+}
+
 void VDPAURenderer::notifyOverlayUpdated(Overlay::OverlayType type)
 {
     VdpStatus status;
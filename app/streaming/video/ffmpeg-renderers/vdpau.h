@@ -15,6 +15,7 @@ public:
     virtual ~VDPAURenderer() override;
     virtual bool initialize(PDECODER_PARAMETERS params) override;
     virtual bool prepareDecoderContext(AVCodecContext* context, AVDictionary** options) override;
+    virtual bool canRecreateDecoderContext() override;
     virtual void notifyOverlayUpdated(Overlay::OverlayType type) override;
     virtual void renderFrame(AVFrame* frame) override;
     virtual bool needsTestFrame() override;
@@ -1,11 +1,19 @@
 #include <Limelight.h>
 #include "ffmpeg.h"
+#include "streaming/avsync.h"
 #include "streaming/streamutils.h"
 #include "streaming/session.h"
+#include "streaming/threadroles.h"
 
 #include <h264_stream.h>
 
+extern "C" {
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
+}
+
 #include "ffmpeg-renderers/sdlvid.h"
+#include "ffmpeg-renderers/nullvid.h"
 
 #ifdef Q_OS_WIN32
 #include "ffmpeg-renderers/dxva2.h"
@@ -48,6 +56,17 @@
 
 #define MAX_RECV_FRAME_RETRIES 100
 
+// How often the output thread polls an asynchronous decoder that
+// has pending input but hasn't produced a frame for it yet
+#define OUTPUT_THREAD_POLL_INTERVAL_MS 1
+
+// Getting a free surface from a fixed pool is normally instant, so a
+// wait this long means the decoder was blocked on frames that we hold
+#define HW_SURFACE_WAIT_THRESHOLD_US 1000
+
+QList<FFmpegVideoDecoder::ValidatedConfig> FFmpegVideoDecoder::s_ValidatedConfigs;
+QMutex FFmpegVideoDecoder::s_ValidatedConfigsLock;
+
 bool FFmpegVideoDecoder::isHardwareAccelerated()
 {
     return m_HwDecodeCfg != nullptr ||
@@ -121,6 +140,26 @@ enum AVPixelFormat FFmpegVideoDecoder::ffGetFormat(AVCodecContext* context,
     return AV_PIX_FMT_NONE;
 }
 
+int FFmpegVideoDecoder::ffGetBuffer2(AVCodecContext* context, AVFrame* frame, int flags)
+{
+    FFmpegVideoDecoder* decoder = (FFmpegVideoDecoder*)context->opaque;
+
+    // Hardware decoders don't use threads, so this runs on the thread that
+    // is decoding with m_DecoderCtxLock held, like our other stats updates.
+    Uint64 startTime = SDL_GetPerformanceCounter();
+    int err = decoder->m_GetBuffer2(context, frame, flags);
+    Uint64 waitTimeUs = (SDL_GetPerformanceCounter() - startTime) * 1000000 / SDL_GetPerformanceFrequency();
+
+    // A fixed pool that's out of surfaces fails the allocation, while one
+    // managed by the driver blocks until a surface is released
+    if (err < 0 || waitTimeUs >= HW_SURFACE_WAIT_THRESHOLD_US) {
+        decoder->m_ActiveWndVideoStats.hwSurfaceStalls++;
+    }
+    decoder->m_ActiveWndVideoStats.totalHwSurfaceWaitUs += waitTimeUs;
+
+    return err;
+}
+
 FFmpegVideoDecoder::FFmpegVideoDecoder(bool testOnly)
     : m_Pkt(av_packet_alloc()),
       m_VideoDecoderCtx(nullptr),
@@ -129,9 +168,21 @@ FFmpegVideoDecoder::FFmpegVideoDecoder(bool testOnly)
       m_BackendRenderer(nullptr),
       m_FrontendRenderer(nullptr),
       m_ConsecutiveFailedDecodes(0),
+      m_Decoder(nullptr),
+      m_RecoveryTier(0),
+      m_RecoveryStartTime(0),
+      m_RecoveryCounts{},
+      m_RecoveryTimeUs{},
       m_Pacer(nullptr),
+      m_GetBuffer2(nullptr),
       m_FramesIn(0),
       m_FramesOut(0),
+      m_OutputThread(nullptr),
+      m_OutputThreadStopping(false),
+      m_OutputThreadMode(OTM_AUTO),
+      m_OutputThreadNeedsIdr{},
+      m_HwSurfacePoolKb{},
+      m_AvSyncTrim(false),
       m_LastFrameNumber(0),
       m_StreamFps(0),
       m_VideoFormat(0),
@@ -142,6 +193,25 @@ FFmpegVideoDecoder::FFmpegVideoDecoder(bool testOnly)
     SDL_zero(m_ActiveWndVideoStats);
     SDL_zero(m_LastWndVideoStats);
     SDL_zero(m_GlobalVideoStats);
+    SDL_zero(m_DecoderParams);
+
+    QByteArray outputThreadMode = qgetenv("DECODER_OUTPUT_THREAD");
+    if (outputThreadMode == "1") {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Using custom decoder output thread mode: always");
+        m_OutputThreadMode = OTM_ALWAYS;
+    }
+    else if (outputThreadMode == "0") {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Using custom decoder output thread mode: never");
+        m_OutputThreadMode = OTM_NEVER;
+    }
+
+    if (qEnvironmentVariableIntValue("AV_SYNC_TRIM") != 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Using A/V sync trimming");
+        m_AvSyncTrim = true;
+    }
 
     // Use linear filtering when renderer scaling is required
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1");
@@ -167,6 +237,9 @@ IFFmpegRenderer* FFmpegVideoDecoder::getBackendRenderer()
 
 void FFmpegVideoDecoder::reset()
 {
+    // The output thread submits frames to Pacer, so it must go first
+    stopOutputThread();
+
     delete m_Pacer;
     m_Pacer = nullptr;
 
@@ -176,6 +249,7 @@ void FFmpegVideoDecoder::reset()
     // since the codec context may be referencing objects that we
     // need to delete in the renderer destructor.
     avcodec_free_context(&m_VideoDecoderCtx);
+    SDL_AtomicSet(&m_HwSurfacePoolKb, 0);
 
     if (!m_TestOnly) {
         Session::get()->getOverlayManager().setOverlayRenderer(nullptr);
@@ -192,6 +266,8 @@ void FFmpegVideoDecoder::reset()
 
     if (!m_TestOnly) {
         logVideoStats(m_GlobalVideoStats, "Global video stats");
+        logRecoveryStats();
+        logRfiStats();
     }
     else {
         // Test-only decoders can't have any frames submitted
@@ -201,6 +277,17 @@ void FFmpegVideoDecoder::reset()
 
 bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool eglOnly)
 {
+    if (params->headless) {
+        // Headless sessions discard every frame, so the frontend is always a
+        // null renderer even if the backend could render directly.
+        if (eglOnly) {
+            return false;
+        }
+
+        m_FrontendRenderer = new NullRenderer();
+        return m_FrontendRenderer->initialize(params);
+    }
+
     if (eglOnly) {
 #ifdef HAVE_EGL
         if (m_BackendRenderer->canExportEGL()) {
@@ -232,27 +319,8 @@ bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool
     return true;
 }
 
-bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, PDECODER_PARAMETERS params, bool testFrame, bool eglOnly)
+bool FFmpegVideoDecoder::createDecoderContext(const AVCodec* decoder, PDECODER_PARAMETERS params)
 {
-    // In test-only mode, we should only see test frames
-    SDL_assert(!m_TestOnly || testFrame);
-
-    // Create the frontend renderer based on the capabilities of the backend renderer
-    if (!createFrontendRenderer(params, eglOnly)) {
-        return false;
-    }
-
-    m_StreamFps = params->frameRate;
-    m_VideoFormat = params->videoFormat;
-
-    // Don't bother initializing Pacer if we're not actually going to render
-    if (!testFrame) {
-        m_Pacer = new Pacer(m_FrontendRenderer, &m_ActiveWndVideoStats);
-        if (!m_Pacer->initialize(params->window, params->frameRate, params->enableFramePacing)) {
-            return false;
-        }
-    }
-
     m_VideoDecoderCtx = avcodec_alloc_context3(decoder);
     if (!m_VideoDecoderCtx) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -280,6 +348,21 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, PDECODER
     if (!isHardwareAccelerated()) {
         m_VideoDecoderCtx->thread_type = FF_THREAD_SLICE;
         m_VideoDecoderCtx->thread_count = qMin(MAX_SLICES, SDL_GetCPUCount());
+
+        // Frame threading adds latency, but it turns a software decoder into
+        // an asynchronous one, which is useful to exercise the output thread.
+        if (qEnvironmentVariableIntValue("SW_DECODER_FRAME_THREADS") > 0 && StreamUtils::isLowMemoryProfileEnabled()) {
+            // Each frame thread holds its own set of reference frames
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Ignoring software decoder frame threads in low memory profile");
+        }
+        else if (qEnvironmentVariableIntValue("SW_DECODER_FRAME_THREADS") > 0) {
+            m_VideoDecoderCtx->thread_type = FF_THREAD_FRAME;
+            m_VideoDecoderCtx->thread_count = qEnvironmentVariableIntValue("SW_DECODER_FRAME_THREADS");
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Using custom software decoder frame threads: %d",
+                        m_VideoDecoderCtx->thread_count);
+        }
     }
     else {
         // No threading for HW decode
@@ -292,6 +375,13 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, PDECODER
     m_VideoDecoderCtx->pix_fmt = m_FrontendRenderer->getPreferredPixelFormat(params->videoFormat);
     m_VideoDecoderCtx->get_format = ffGetFormat;
 
+    // FFmpeg sizes fixed hardware surface pools for the codec's reference
+    // frames. Frames that the pacer and renderer hold come out of the same
+    // pool, so reserve room for them. Test frames aren't held by anyone.
+    if (m_Pacer != nullptr) {
+        m_VideoDecoderCtx->extra_hw_frames = m_Pacer->getExtraHwFrames();
+    }
+
     AVDictionary* options = nullptr;
 
     // Allow the backend renderer to attach data to this decoder
@@ -302,6 +392,13 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, PDECODER
     // Nobody must override our ffGetFormat
     SDL_assert(m_VideoDecoderCtx->get_format == ffGetFormat);
 
+    // Time surface allocations to catch the decoder waiting on frames we
+    // hold. Wrap whatever the backend renderer installed.
+    if (isHardwareAccelerated()) {
+        m_GetBuffer2 = m_VideoDecoderCtx->get_buffer2;
+        m_VideoDecoderCtx->get_buffer2 = ffGetBuffer2;
+    }
+
     // Stash a pointer to this object in the context
     SDL_assert(m_VideoDecoderCtx->opaque == nullptr);
     m_VideoDecoderCtx->opaque = this;
@@ -315,6 +412,38 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, PDECODER
         return false;
     }
 
+    // Keep what we need to recreate this context during decoder recovery
+    m_Decoder = decoder;
+    m_DecoderParams = *params;
+
+    return true;
+}
+
+bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, PDECODER_PARAMETERS params, bool testFrame, bool eglOnly)
+{
+    // In test-only mode, we should only see test frames
+    SDL_assert(!m_TestOnly || testFrame);
+
+    // Create the frontend renderer based on the capabilities of the backend renderer
+    if (!createFrontendRenderer(params, eglOnly)) {
+        return false;
+    }
+
+    m_StreamFps = params->frameRate;
+    m_VideoFormat = params->videoFormat;
+
+    // Don't bother initializing Pacer if we're not actually going to render
+    if (!testFrame) {
+        m_Pacer = new Pacer(m_FrontendRenderer, &m_ActiveWndVideoStats);
+        if (!m_Pacer->initialize(params->window, params->frameRate, params->enableFramePacing)) {
+            return false;
+        }
+    }
+
+    if (!createDecoderContext(decoder, params)) {
+        return false;
+    }
+
     // FFMpeg doesn't completely initialize the codec until the codec
     // config data comes in. This would be too late for us to change
     // our minds on the selected video codec, so we'll do a trial run
@@ -341,6 +470,7 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, PDECODER
             return false;
         }
 
+        int err;
         AVFrame* frame = av_frame_alloc();
         if (!frame) {
             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -396,8 +526,22 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, PDECODER
         av_frame_free(&frame);
     }
     else {
-        if ((params->videoFormat & VIDEO_FORMAT_MASK_H264) &&
-                !(m_BackendRenderer->getDecoderCapabilities() & CAPABILITY_REFERENCE_FRAME_INVALIDATION_AVC)) {
+        int capabilities = m_BackendRenderer->getDecoderCapabilities();
+        if (params->videoFormat & VIDEO_FORMAT_MASK_H264) {
+            m_RfiTracker.setActive((capabilities & CAPABILITY_REFERENCE_FRAME_INVALIDATION_AVC) != 0);
+        }
+        else {
+            m_RfiTracker.setActive((capabilities & CAPABILITY_REFERENCE_FRAME_INVALIDATION_HEVC) != 0);
+        }
+
+        if (m_RfiTracker.isActive()) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Using reference frame invalidation");
+        }
+
+        // The SPS fixup limits the decoder to a single reference frame,
+        // which would discard the references that RFI relies on.
+        if ((params->videoFormat & VIDEO_FORMAT_MASK_H264) && !m_RfiTracker.isActive()) {
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                         "Using H.264 SPS fixup");
             m_NeedsSpsFixup = true;
@@ -425,6 +569,19 @@ void FFmpegVideoDecoder::addVideoStats(VIDEO_STATS& src, VIDEO_STATS& dst)
     dst.totalDecodeTime += src.totalDecodeTime;
     dst.totalPacerTime += src.totalPacerTime;
     dst.totalRenderTime += src.totalRenderTime;
+    dst.totalRenderWaitTimeUs += src.totalRenderWaitTimeUs;
+    dst.totalOutputLatencyUs += src.totalOutputLatencyUs;
+    dst.totalPacingDepth += src.totalPacingDepth;
+    dst.renderDeadlineMisses += src.renderDeadlineMisses;
+    dst.hwSurfaceStalls += src.hwSurfaceStalls;
+    dst.totalHwSurfaceWaitUs += src.totalHwSurfaceWaitUs;
+    dst.totalAudioLatency += src.totalAudioLatency;
+    dst.audioLatencySamples += src.audioLatencySamples;
+
+    // Memory use is reported as the peak over the measurement period
+    dst.videoMemoryKb = qMax(dst.videoMemoryKb, src.videoMemoryKb);
+    dst.audioMemoryKb = qMax(dst.audioMemoryKb, src.audioMemoryKb);
+    dst.overlayMemoryKb = qMax(dst.overlayMemoryKb, src.overlayMemoryKb);
 
     if (!LiGetEstimatedRttInfo(&dst.lastRtt, &dst.lastRttVariance)) {
         dst.lastRtt = 0;
@@ -452,12 +609,101 @@ void FFmpegVideoDecoder::addVideoStats(VIDEO_STATS& src, VIDEO_STATS& dst)
     dst.renderedFps = (float)dst.renderedFrames / ((float)(now - dst.measurementStartTimestamp) / 1000);
 }
 
-void FFmpegVideoDecoder::stringifyVideoStats(VIDEO_STATS& stats, char* output)
+// Both latencies start when the data arrives at the client. See AvSync.
+bool FFmpegVideoDecoder::getAvLatencies(VIDEO_STATS& stats, float& videoLatencyMs, float& audioLatencyMs)
+{
+    if (stats.audioLatencySamples == 0 || stats.receivedFrames == 0 ||
+            stats.decodedFrames == 0 || stats.renderedFrames == 0) {
+        return false;
+    }
+
+    videoLatencyMs = AvSync::getVideoLatencyMs((float)stats.totalReassemblyTime / stats.receivedFrames,
+                                               (float)stats.totalDecodeTime / stats.decodedFrames,
+                                               (float)stats.totalPacerTime / stats.renderedFrames,
+                                               (float)stats.totalRenderTime / stats.renderedFrames);
+    audioLatencyMs = (float)stats.totalAudioLatency / stats.audioLatencySamples;
+    return true;
+}
+
+void FFmpegVideoDecoder::trimAvSyncOffset(VIDEO_STATS& stats)
+{
+    float videoLatencyMs, audioLatencyMs;
+    if (!getAvLatencies(stats, videoLatencyMs, audioLatencyMs)) {
+        return;
+    }
+
+    // Trim whichever path has fallen behind the other. Trimming at most
+    // once per stats window gives the new offset time to show up.
+    float offsetMs = videoLatencyMs - audioLatencyMs;
+    int audioTrimMs;
+    switch (AvSync::getTrimAction(offsetMs, audioTrimMs)) {
+    case AvSync::TRIM_VIDEO:
+        if (m_Pacer->dropExcessFrame()) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Dropped a video frame to reduce A/V offset of %.2f ms",
+                        offsetMs);
+        }
+        break;
+
+    case AvSync::TRIM_AUDIO:
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Dropping audio to reduce A/V offset of %.2f ms",
+                    offsetMs);
+        Session::get()->trimAudio(audioTrimMs);
+        break;
+
+    default:
+        break;
+    }
+}
+
+Uint64 FFmpegVideoDecoder::getVideoMemoryUsage()
+{
+    Uint64 bytes = m_DecodeBuffer.capacity();
+
+    if (m_Pacer != nullptr) {
+        bytes += m_Pacer->getQueuedFrameBytes();
+    }
+
+    bytes += (Uint64)SDL_AtomicGet(&m_HwSurfacePoolKb) * 1024;
+
+    return bytes;
+}
+
+void FFmpegVideoDecoder::updateHwSurfacePoolSize(const AVFrame* frame)
+{
+    int poolKb = 0;
+
+    // Hardware surface pools are allocated up front, so count the whole
+    // pool. Decoders that allocate surfaces on demand report a size of 0.
+    if (frame->hw_frames_ctx != nullptr) {
+        auto framesCtx = (AVHWFramesContext*)frame->hw_frames_ctx->data;
+        int frameSize = av_image_get_buffer_size(framesCtx->sw_format, framesCtx->width, framesCtx->height, 1);
+
+        if (frameSize > 0) {
+            poolKb = (int)((Uint64)framesCtx->initial_pool_size * frameSize / 1024);
+        }
+    }
+
+    SDL_AtomicSet(&m_HwSurfacePoolKb, poolKb);
+}
+
+void FFmpegVideoDecoder::sampleMemoryUsage(VIDEO_STATS& stats)
+{
+    // Network buffers are owned by moonlight-common-c and aren't counted here
+    stats.videoMemoryKb = (uint32_t)(getVideoMemoryUsage() / 1024);
+    stats.audioMemoryKb = (uint32_t)Session::get()->getAudioMemoryUsage() / 1024;
+    stats.overlayMemoryKb = (uint32_t)Session::get()->getOverlayManager().getMemoryUsage() / 1024;
+}
+
+void FFmpegVideoDecoder::stringifyVideoStats(VIDEO_STATS& stats, char* output, int length)
 {
     int offset = 0;
+    int ret;
     const char* codecString;
 
-    // Start with an empty string
+    // Start with an empty string. If the buffer fills up, snprintf()
+    // leaves it terminated and we stop adding lines.
     output[offset] = 0;
 
     switch (m_VideoFormat)
@@ -482,54 +728,162 @@ void FFmpegVideoDecoder::stringifyVideoStats(VIDEO_STATS& stats, char* output)
 
     if (stats.receivedFps > 0) {
         if (m_VideoDecoderCtx != nullptr) {
-            offset += sprintf(&output[offset],
-                              "Video stream: %dx%d %.2f FPS (Codec: %s)\n",
-                              m_VideoDecoderCtx->width,
-                              m_VideoDecoderCtx->height,
-                              stats.totalFps,
-                              codecString);
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "Video stream: %dx%d %.2f FPS (Codec: %s)\n",
+                           m_VideoDecoderCtx->width,
+                           m_VideoDecoderCtx->height,
+                           stats.totalFps,
+                           codecString);
+            if (ret < 0 || ret >= length - offset) {
+                return;
+            }
+
+            offset += ret;
+        }
+
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Incoming frame rate from network: %.2f FPS\n"
+                       "Decoding frame rate: %.2f FPS\n"
+                       "Rendering frame rate: %.2f FPS\n",
+                       stats.receivedFps,
+                       stats.decodedFps,
+                       stats.renderedFps);
+        if (ret < 0 || ret >= length - offset) {
+            return;
         }
 
-        offset += sprintf(&output[offset],
-                          "Incoming frame rate from network: %.2f FPS\n"
-                          "Decoding frame rate: %.2f FPS\n"
-                          "Rendering frame rate: %.2f FPS\n",
-                          stats.receivedFps,
-                          stats.decodedFps,
-                          stats.renderedFps);
+        offset += ret;
     }
 
     if (stats.renderedFrames != 0) {
         char rttString[32];
 
         if (stats.lastRtt != 0) {
-            sprintf(rttString, "%u ms (variance: %u ms)", stats.lastRtt, stats.lastRttVariance);
+            snprintf(rttString, sizeof(rttString), "%u ms (variance: %u ms)", stats.lastRtt, stats.lastRttVariance);
         }
         else {
-            sprintf(rttString, "N/A");
-        }
-
-        offset += sprintf(&output[offset],
-                          "Frames dropped by your network connection: %.2f%%\n"
-                          "Frames dropped due to network jitter: %.2f%%\n"
-                          "Average network latency: %s\n"
-                          "Average decoding time: %.2f ms\n"
-                          "Average frame queue delay: %.2f ms\n"
-                          "Average rendering time (including monitor V-sync latency): %.2f ms\n",
-                          (float)stats.networkDroppedFrames / stats.totalFrames * 100,
-                          (float)stats.pacerDroppedFrames / stats.decodedFrames * 100,
-                          rttString,
-                          (float)stats.totalDecodeTime / stats.decodedFrames,
-                          (float)stats.totalPacerTime / stats.renderedFrames,
-                          (float)stats.totalRenderTime / stats.renderedFrames);
+            snprintf(rttString, sizeof(rttString), "N/A");
+        }
+
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Frames dropped by your network connection: %.2f%%\n"
+                       "Frames dropped due to network jitter: %.2f%%\n"
+                       "Average network latency: %s\n"
+                       "Average decoding time: %.2f ms\n"
+                       "Average frame queue delay: %.2f ms\n"
+                       "Average rendering time (including monitor V-sync latency): %.2f ms\n",
+                       (float)stats.networkDroppedFrames / stats.totalFrames * 100,
+                       (float)stats.pacerDroppedFrames / stats.decodedFrames * 100,
+                       rttString,
+                       (float)stats.totalDecodeTime / stats.decodedFrames,
+                       (float)stats.totalPacerTime / stats.renderedFrames,
+                       (float)stats.totalRenderTime / stats.renderedFrames);
+        if (ret < 0 || ret >= length - offset) {
+            return;
+        }
+
+        offset += ret;
+
+        float videoLatencyMs, audioLatencyMs;
+        if (getAvLatencies(stats, videoLatencyMs, audioLatencyMs)) {
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "Audio/video offset: %+.2f ms (video latency: %.2f ms, audio latency: %.2f ms)\n",
+                           videoLatencyMs - audioLatencyMs,
+                           videoLatencyMs,
+                           audioLatencyMs);
+            if (ret < 0 || ret >= length - offset) {
+                return;
+            }
+
+            offset += ret;
+        }
+
+        if (stats.totalOutputLatencyUs != 0) {
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "Average decoder output latency: %.2f ms\n",
+                           (float)stats.totalOutputLatencyUs / 1000 / stats.decodedFrames);
+            if (ret < 0 || ret >= length - offset) {
+                return;
+            }
+
+            offset += ret;
+        }
+
+        if (stats.totalPacingDepth != 0) {
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "Average frame pacing depth: %.2f frames\n",
+                           (float)stats.totalPacingDepth / stats.renderedFrames);
+            if (ret < 0 || ret >= length - offset) {
+                return;
+            }
+
+            offset += ret;
+        }
+
+        if (stats.renderDeadlineMisses != 0) {
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "Frames that missed their V-sync deadline: %.2f%%\n",
+                           (float)stats.renderDeadlineMisses / stats.renderedFrames * 100);
+            if (ret < 0 || ret >= length - offset) {
+                return;
+            }
+
+            offset += ret;
+        }
+
+        if (stats.hwSurfaceStalls != 0) {
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "Frames that waited on a free decoder surface: %.2f%% (average wait %.2f ms)\n",
+                           (float)stats.hwSurfaceStalls / stats.receivedFrames * 100,
+                           (float)stats.totalHwSurfaceWaitUs / 1000 / stats.receivedFrames);
+            if (ret < 0 || ret >= length - offset) {
+                return;
+            }
+
+            offset += ret;
+        }
+
+        if (stats.totalRenderWaitTimeUs != 0) {
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "Average GPU wait time: %.2f ms\n",
+                           (float)stats.totalRenderWaitTimeUs / 1000 / stats.renderedFrames);
+            if (ret < 0 || ret >= length - offset) {
+                return;
+            }
+
+            offset += ret;
+        }
+
+        if (stats.videoMemoryKb != 0) {
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "Peak memory use: video %.1f MB, audio %u KB, overlay %u KB\n",
+                           (float)stats.videoMemoryKb / 1024,
+                           stats.audioMemoryKb,
+                           stats.overlayMemoryKb);
+            if (ret < 0 || ret >= length - offset) {
+                return;
+            }
+
+            offset += ret;
+        }
     }
 }
 
 void FFmpegVideoDecoder::logVideoStats(VIDEO_STATS& stats, const char* title)
 {
     if (stats.renderedFps > 0 || stats.renderedFrames != 0) {
-        char videoStatsStr[512];
-        stringifyVideoStats(stats, videoStatsStr);
+        char videoStatsStr[1024];
+        stringifyVideoStats(stats, videoStatsStr, sizeof(videoStatsStr));
 
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                     "%s", title);
@@ -610,7 +964,8 @@ bool FFmpegVideoDecoder::tryInitializeRenderer(const AVCodec* decoder,
                 completeInitialization(decoder, params, m_TestOnly || m_BackendRenderer->needsTestFrame(), i == 0 /* EGL */)) {
             if (m_TestOnly) {
                 // This decoder is only for testing capabilities, so don't bother
-                // creating a usable renderer
+                // creating a usable renderer. Remember what worked for the real one.
+                saveValidatedConfig(decoder, params, hwConfig, createRendererFunc, i == 0 /* EGL */);
                 return true;
             }
 
@@ -620,6 +975,7 @@ bool FFmpegVideoDecoder::tryInitializeRenderer(const AVCodec* decoder,
                 if ((m_BackendRenderer = createRendererFunc()) != nullptr &&
                         m_BackendRenderer->initialize(params) &&
                         completeInitialization(decoder, params, false, i == 0 /* EGL */)) {
+                    saveValidatedConfig(decoder, params, hwConfig, createRendererFunc, i == 0 /* EGL */);
                     return true;
                 }
                 else {
@@ -630,6 +986,7 @@ bool FFmpegVideoDecoder::tryInitializeRenderer(const AVCodec* decoder,
             }
             else {
                 // No test required. Good to go now.
+                saveValidatedConfig(decoder, params, hwConfig, createRendererFunc, i == 0 /* EGL */);
                 return true;
             }
         }
@@ -644,6 +1001,109 @@ bool FFmpegVideoDecoder::tryInitializeRenderer(const AVCodec* decoder,
     return false;
 }
 
+// Must be called with s_ValidatedConfigsLock held
+int FFmpegVideoDecoder::findValidatedConfig(PDECODER_PARAMETERS params)
+{
+    for (int i = 0; i < s_ValidatedConfigs.size(); i++) {
+        const ValidatedConfig& config = s_ValidatedConfigs[i];
+        if (config.videoFormat == params->videoFormat &&
+                config.width == params->width &&
+                config.height == params->height &&
+                config.vds == params->vds &&
+                config.headless == params->headless) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void FFmpegVideoDecoder::saveValidatedConfig(const AVCodec* decoder,
+                                             PDECODER_PARAMETERS params,
+                                             const AVCodecHWConfig* hwConfig,
+                                             std::function<IFFmpegRenderer*()> createRendererFunc,
+                                             bool eglFrontend)
+{
+    ValidatedConfig config;
+
+    config.videoFormat = params->videoFormat;
+    config.width = params->width;
+    config.height = params->height;
+    config.vds = params->vds;
+    config.headless = params->headless;
+    config.decoder = decoder;
+    config.hwConfig = hwConfig;
+    config.createRendererFunc = createRendererFunc;
+    config.eglFrontend = eglFrontend;
+
+    QMutexLocker locker(&s_ValidatedConfigsLock);
+
+    // Replace any older result for the same stream parameters
+    int index = findValidatedConfig(params);
+    if (index >= 0) {
+        s_ValidatedConfigs[index] = config;
+    }
+    else {
+        s_ValidatedConfigs.append(config);
+    }
+}
+
+bool FFmpegVideoDecoder::tryInitializeValidatedRenderer(PDECODER_PARAMETERS params)
+{
+    ValidatedConfig config;
+
+    {
+        QMutexLocker locker(&s_ValidatedConfigsLock);
+
+        int index = findValidatedConfig(params);
+        if (index < 0) {
+            return false;
+        }
+
+        config = s_ValidatedConfigs[index];
+    }
+
+    // This combination already worked in this process, so we can skip the
+    // search. Renderers that need a test frame still get one, since a new
+    // window or device context can fail where the old one worked.
+    m_HwDecodeCfg = config.hwConfig;
+    if ((m_BackendRenderer = config.createRendererFunc()) != nullptr &&
+            m_BackendRenderer->initialize(params) &&
+            completeInitialization(config.decoder, params, m_BackendRenderer->needsTestFrame(), config.eglFrontend)) {
+        bool ok = true;
+
+        if (m_BackendRenderer->needsTestFrame()) {
+            // The test worked, so now let's initialize it for real
+            reset();
+            ok = (m_BackendRenderer = config.createRendererFunc()) != nullptr &&
+                    m_BackendRenderer->initialize(params) &&
+                    completeInitialization(config.decoder, params, false, config.eglFrontend);
+        }
+
+        if (ok) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Reusing validated decoder configuration for codec %s (%s frontend)",
+                        config.decoder->name,
+                        config.eglFrontend ? "EGL" : "default");
+            return true;
+        }
+    }
+
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "Validated decoder configuration for codec %s failed to initialize",
+                config.decoder->name);
+    reset();
+
+    // Don't try this one again and let the full search run instead
+    QMutexLocker locker(&s_ValidatedConfigsLock);
+    int index = findValidatedConfig(params);
+    if (index >= 0) {
+        s_ValidatedConfigs.removeAt(index);
+    }
+
+    return false;
+}
+
 #define TRY_PREFERRED_PIXEL_FORMAT(RENDERER_TYPE) \
     { \
         RENDERER_TYPE renderer; \
@@ -739,6 +1199,11 @@ bool FFmpegVideoDecoder::initialize(PDECODER_PARAMETERS params)
     // Increase log level until the first frame is decoded
     av_log_set_level(AV_LOG_DEBUG);
 
+    // Use what a test-only decoder already found to work, if anything
+    if (!m_TestOnly && tryInitializeValidatedRenderer(params)) {
+        return true;
+    }
+
     // First try decoders that the user has manually specified via environment variables.
     // These must output surfaces in one of the formats that one of our renderers supports,
     // which is currently:
@@ -857,8 +1322,15 @@ bool FFmpegVideoDecoder::initialize(PDECODER_PARAMETERS params)
     // Fallback to software if no matching hardware decoder was found
     // and if software fallback is allowed
     if (params->vds != StreamingPreferences::VDS_FORCE_HARDWARE) {
-        if (tryInitializeRenderer(decoder, params, nullptr,
-                                  []() -> IFFmpegRenderer* { return new SdlRenderer(); })) {
+        if (params->headless) {
+            // Don't create an SDL renderer that will never draw anything
+            if (tryInitializeRenderer(decoder, params, nullptr,
+                                      []() -> IFFmpegRenderer* { return new NullRenderer(); })) {
+                return true;
+            }
+        }
+        else if (tryInitializeRenderer(decoder, params, nullptr,
+                                       []() -> IFFmpegRenderer* { return new SdlRenderer(); })) {
             return true;
         }
     }
@@ -915,9 +1387,26 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
     PLENTRY entry = du->bufferList;
     int err;
     bool submittedFrame = false;
+    bool needsIdr = false;
 
     SDL_assert(!m_TestOnly);
 
+    // The output thread can recreate m_VideoDecoderCtx and adds to
+    // m_ActiveWndVideoStats, so hold the lock while we use either.
+    QMutexLocker locker(&m_DecoderCtxLock);
+
+    if (m_VideoDecoderCtx == nullptr) {
+        // Decoder recovery failed and we're waiting to be reset
+        return DR_OK;
+    }
+
+    if (SDL_AtomicSet(&m_OutputThreadNeedsIdr, 0)) {
+        // The output thread had to recover the decoder
+        return DR_NEED_IDR;
+    }
+
+    bool rfiInvalidated = m_RfiTracker.addFrame(du->frameNumber, du->frameType == FRAME_TYPE_IDR);
+
     if (!m_LastFrameNumber) {
         m_ActiveWndVideoStats.measurementStartTimestamp = SDL_GetTicks();
         m_LastFrameNumber = du->frameNumber;
@@ -926,21 +1415,38 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
         // Any frame number greater than m_LastFrameNumber + 1 represents a dropped frame
         m_ActiveWndVideoStats.networkDroppedFrames += du->frameNumber - (m_LastFrameNumber + 1);
         m_ActiveWndVideoStats.totalFrames += du->frameNumber - (m_LastFrameNumber + 1);
+
+        if (rfiInvalidated) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Decoding frame %d after reference frame invalidation of frames %d-%d",
+                        du->frameNumber,
+                        m_LastFrameNumber + 1,
+                        du->frameNumber - 1);
+        }
+
         m_LastFrameNumber = du->frameNumber;
     }
 
     // Flip stats windows roughly every second
     if (SDL_TICKS_PASSED(SDL_GetTicks(), m_ActiveWndVideoStats.measurementStartTimestamp + 1000)) {
+        sampleMemoryUsage(m_ActiveWndVideoStats);
+
         // Update overlay stats if it's enabled
         if (Session::get()->getOverlayManager().isOverlayEnabled(Overlay::OverlayDebug)) {
             VIDEO_STATS lastTwoWndStats = {};
             addVideoStats(m_LastWndVideoStats, lastTwoWndStats);
             addVideoStats(m_ActiveWndVideoStats, lastTwoWndStats);
 
-            stringifyVideoStats(lastTwoWndStats, Session::get()->getOverlayManager().getOverlayText(Overlay::OverlayDebug));
+            stringifyVideoStats(lastTwoWndStats,
+                                Session::get()->getOverlayManager().getOverlayText(Overlay::OverlayDebug),
+                                Session::get()->getOverlayManager().getOverlayMaxTextLength());
             Session::get()->getOverlayManager().setOverlayTextUpdated(Overlay::OverlayDebug);
         }
 
+        if (m_AvSyncTrim) {
+            trimAvSyncOffset(m_ActiveWndVideoStats);
+        }
+
         // Accumulate these values into the global stats
         addVideoStats(m_ActiveWndVideoStats, m_GlobalVideoStats);
 
@@ -953,6 +1459,12 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
     m_ActiveWndVideoStats.receivedFrames++;
     m_ActiveWndVideoStats.totalFrames++;
 
+    int audioLatencyMs = Session::get()->getAudioLatencyMs();
+    if (audioLatencyMs >= 0) {
+        m_ActiveWndVideoStats.totalAudioLatency += audioLatencyMs;
+        m_ActiveWndVideoStats.audioLatencySamples++;
+    }
+
     int requiredBufferSize = du->fullLength;
     if (du->frameType == FRAME_TYPE_IDR) {
         // Add some extra space in case we need to do an SPS fixup
@@ -980,6 +1492,13 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
 
     m_ActiveWndVideoStats.totalReassemblyTime += du->enqueueTimeMs - du->receiveTimeMs;
 
+    if (m_OutputThread != nullptr) {
+        // Frames from the output thread can't be matched with their
+        // packets, so we don't check invalidated frames there.
+        m_RfiTracker.skipCheck();
+        return submitPacketToOutputThread(du);
+    }
+
     err = avcodec_send_packet(m_VideoDecoderCtx, m_Pkt);
     if (err < 0) {
         char errorstring[512];
@@ -987,16 +1506,12 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
         SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                     "avcodec_send_packet() failed: %s", errorstring);
 
+        m_RfiTracker.decodeFailed();
+
         // If we've failed a bunch of decodes in a row, the decoder/renderer is
-        // clearly unhealthy, so let's generate a synthetic reset event to trigger
-        // the event loop to destroy and recreate the decoder.
+        // clearly unhealthy, so let's try to recover it.
         if (++m_ConsecutiveFailedDecodes == FAILED_DECODES_RESET_THRESHOLD) {
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                         "Resetting decoder due to consistent failure");
-
-            SDL_Event event;
-            event.type = SDL_RENDER_DEVICE_RESET;
-            SDL_PushEvent(&event);
+            recoverFromFailedDecodes();
         }
 
         return DR_NEED_IDR;
@@ -1029,29 +1544,32 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
             // Reset failed decodes count if we reached this far
             m_ConsecutiveFailedDecodes = 0;
 
-            // Restore default log level after a successful decode
-            av_log_set_level(AV_LOG_INFO);
-
-            // Store the presentation time
-            // FIXME: This is wrong when reading a batch of frames
-            frame->pts = du->presentationTimeMs;
-
-            // Capture a frame timestamp to measuring pacing delay
-            frame->pkt_dts = SDL_GetTicks();
+            if (m_RecoveryTier != 0) {
+                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                            "Decoder recovered %.2f ms after the first recovery attempt",
+                            (SDL_GetPerformanceCounter() - m_RecoveryStartTime) * 1000.0 / SDL_GetPerformanceFrequency());
+                m_RecoveryTier = 0;
+            }
 
             // Count time in avcodec_send_packet() and avcodec_receive_frame()
             // as time spent decoding. Also count time spent in the decode unit
             // queue because that's directly caused by decoder latency.
-            m_ActiveWndVideoStats.totalDecodeTime += LiGetMillis() - du->enqueueTimeMs;
-
+            //
             // Also count the frame-to-frame delay if the decoder is delaying frames
             // until a subsequent frame is submitted.
-            m_ActiveWndVideoStats.totalDecodeTime += (m_FramesIn - m_FramesOut) * (1000 / m_StreamFps);
+            //
+            if (m_RfiTracker.frameDecoded(frame->decode_error_flags != 0 || (frame->flags & AV_FRAME_FLAG_CORRUPT))) {
+                // Display the frame anyway, but fall back to an IDR frame
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "Reference frame invalidation failed; requesting IDR frame");
+                needsIdr = true;
+            }
 
+            m_ActiveWndVideoStats.totalDecodeTime += (uint32_t)(LiGetMillis() - du->enqueueTimeMs) + (m_FramesIn - m_FramesOut) * (1000 / m_StreamFps);
             m_ActiveWndVideoStats.decodedFrames++;
 
-            // Queue the frame for rendering (or render now if pacer is disabled)
-            m_Pacer->submitFrame(frame);
+            // FIXME: The presentation time is wrong when reading a batch of frames
+            submitDecodedFrame(frame, du->presentationTimeMs);
             submittedFrame = true;
 
             // Once we receive a frame, transition out of the Unknown state by determining
@@ -1102,20 +1620,372 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
         }
 
         if (++m_ConsecutiveFailedDecodes == FAILED_DECODES_RESET_THRESHOLD) {
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                         "Resetting decoder due to consistent failure");
+            return recoverFromFailedDecodes();
+        }
+    }
+
+    // Stop polling asynchronous decoders on this thread once we know what they are
+    if (m_OutputThread == nullptr &&
+            ((m_OutputThreadMode == OTM_AUTO && m_CanRetryReceiveFrame == RRF_YES) ||
+             m_OutputThreadMode == OTM_ALWAYS)) {
+        startOutputThread();
+    }
+
+    return needsIdr ? DR_NEED_IDR : DR_OK;
+}
+
+// Must be called with m_DecoderCtxLock held
+int FFmpegVideoDecoder::submitPacketToOutputThread(PDECODE_UNIT du)
+{
+    int err;
+    while ((err = avcodec_send_packet(m_VideoDecoderCtx, m_Pkt)) == AVERROR(EAGAIN)) {
+        // The decoder won't accept more input until the output thread
+        // takes some frames out of it, so wait for that to happen.
+        m_PacketSubmitted.wakeOne();
+        m_FrameReceived.wait(&m_DecoderCtxLock, 100);
+    }
+
+    if (err < 0) {
+        char errorstring[512];
+        av_strerror(err, errorstring, sizeof(errorstring));
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "avcodec_send_packet() failed: %s", errorstring);
 
-            SDL_Event event;
-            event.type = SDL_RENDER_DEVICE_RESET;
-            SDL_PushEvent(&event);
+        if (++m_ConsecutiveFailedDecodes == FAILED_DECODES_RESET_THRESHOLD) {
+            recoverFromFailedDecodes();
         }
+
+        return DR_NEED_IDR;
     }
 
+    PendingPacket packet;
+    packet.presentationTimeMs = du->presentationTimeMs;
+    packet.enqueueTimeMs = du->enqueueTimeMs;
+    packet.submitTime = SDL_GetPerformanceCounter();
+    m_PendingPackets.enqueue(packet);
+    m_FramesIn++;
+
+    m_PacketSubmitted.wakeOne();
     return DR_OK;
 }
 
+void FFmpegVideoDecoder::submitDecodedFrame(AVFrame* frame, unsigned int presentationTimeMs)
+{
+    // Restore default log level after a successful decode
+    av_log_set_level(AV_LOG_INFO);
+
+    // Store the presentation time
+    frame->pts = presentationTimeMs;
+
+    // Capture a frame timestamp to measuring pacing delay
+    frame->pkt_dts = SDL_GetTicks();
+
+    updateHwSurfacePoolSize(frame);
+
+    // Queue the frame for rendering (or render now if pacer is disabled)
+    m_Pacer->submitFrame(frame);
+}
+
+void FFmpegVideoDecoder::startOutputThread()
+{
+    SDL_assert(m_OutputThread == nullptr);
+
+    // Frames still inside the decoder were submitted before we tracked
+    // pending packets, so they'll be reported without latency information.
+    for (int i = m_FramesOut; i < m_FramesIn; i++) {
+        PendingPacket packet = {};
+        packet.enqueueTimeMs = LiGetMillis();
+        m_PendingPackets.enqueue(packet);
+    }
+
+    m_OutputThreadStopping = false;
+    m_OutputThread = SDL_CreateThread(FFmpegVideoDecoder::outputThreadProc, "DecoderOutput", this);
+    if (m_OutputThread == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to create decoder output thread: %s",
+                     SDL_GetError());
+
+        // Keep polling on the decoder thread
+        m_OutputThreadMode = OTM_NEVER;
+        return;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Receiving decoded frames on a dedicated output thread");
+}
+
+void FFmpegVideoDecoder::stopOutputThread()
+{
+    if (m_OutputThread == nullptr) {
+        return;
+    }
+
+    m_DecoderCtxLock.lock();
+    m_OutputThreadStopping = true;
+    m_PacketSubmitted.wakeAll();
+    m_DecoderCtxLock.unlock();
+
+    SDL_WaitThread(m_OutputThread, nullptr);
+    m_OutputThread = nullptr;
+    m_PendingPackets.clear();
+}
+
+int FFmpegVideoDecoder::outputThreadProc(void* context)
+{
+    auto me = reinterpret_cast<FFmpegVideoDecoder*>(context);
+    AVFrame* frame = nullptr;
+
+    ThreadRoles::applyToCurrentThread(ThreadRoles::RoleDecoder);
+
+    me->m_DecoderCtxLock.lock();
+    while (!me->m_OutputThreadStopping) {
+        if (me->m_VideoDecoderCtx == nullptr || me->m_FramesIn == me->m_FramesOut) {
+            // Nothing can come out of the decoder until we give it more input
+            me->m_PacketSubmitted.wait(&me->m_DecoderCtxLock);
+            continue;
+        }
+
+        if (frame == nullptr && (frame = av_frame_alloc()) == nullptr) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Failed to allocate frame");
+            me->m_PacketSubmitted.wait(&me->m_DecoderCtxLock, OUTPUT_THREAD_POLL_INTERVAL_MS);
+            continue;
+        }
+
+        int err = avcodec_receive_frame(me->m_VideoDecoderCtx, frame);
+        if (err == 0) {
+            Uint64 now = SDL_GetPerformanceCounter();
+            PendingPacket packet;
+
+            if (!me->m_PendingPackets.isEmpty()) {
+                packet = me->m_PendingPackets.dequeue();
+            }
+            else {
+                // Some decoders can produce more than one frame per packet
+                packet = {};
+                packet.enqueueTimeMs = LiGetMillis();
+            }
+
+            me->m_FramesOut++;
+            me->m_ConsecutiveFailedDecodes = 0;
+            if (me->m_RecoveryTier != 0) {
+                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                            "Decoder recovered %.2f ms after the first recovery attempt",
+                            (now - me->m_RecoveryStartTime) * 1000.0 / SDL_GetPerformanceFrequency());
+                me->m_RecoveryTier = 0;
+            }
+
+            // The decoder thread flips the stats windows under this lock
+            if (packet.submitTime != 0) {
+                me->m_ActiveWndVideoStats.totalOutputLatencyUs += (now - packet.submitTime) * 1000000 / SDL_GetPerformanceFrequency();
+            }
+            me->m_ActiveWndVideoStats.totalDecodeTime += (uint32_t)(LiGetMillis() - packet.enqueueTimeMs);
+            me->m_ActiveWndVideoStats.decodedFrames++;
+
+            // Let the decoder thread submit more input if it was waiting on us
+            me->m_FrameReceived.wakeOne();
+            me->m_DecoderCtxLock.unlock();
+
+            me->submitDecodedFrame(frame, packet.presentationTimeMs);
+            frame = nullptr;
+
+            me->m_DecoderCtxLock.lock();
+        }
+        else if (err == AVERROR(EAGAIN)) {
+            // FFmpeg can't tell us when an asynchronous decoder has output
+            // ready, so poll it until it does or we get more input.
+            me->m_PacketSubmitted.wait(&me->m_DecoderCtxLock, OUTPUT_THREAD_POLL_INTERVAL_MS);
+        }
+        else {
+            char errorstring[512];
+            av_strerror(err, errorstring, sizeof(errorstring));
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "avcodec_receive_frame() failed: %s", errorstring);
+
+            // Assume this error consumed the oldest pending packet
+            if (!me->m_PendingPackets.isEmpty()) {
+                me->m_PendingPackets.dequeue();
+            }
+            me->m_FramesOut++;
+
+            if (++me->m_ConsecutiveFailedDecodes == FAILED_DECODES_RESET_THRESHOLD) {
+                me->recoverFromFailedDecodes();
+            }
+
+            // We can't return DR_NEED_IDR from here, so have the decoder thread do it
+            SDL_AtomicSet(&me->m_OutputThreadNeedsIdr, 1);
+        }
+    }
+    me->m_DecoderCtxLock.unlock();
+
+    av_frame_free(&frame);
+    return 0;
+}
+
+int FFmpegVideoDecoder::recoverFromFailedDecodes()
+{
+    Uint64 startTime = SDL_GetPerformanceCounter();
+    int tier = m_RecoveryTier;
+
+    if (tier == RT_FLUSH) {
+        m_RecoveryStartTime = startTime;
+    }
+
+    if (tier == RT_RECREATE_CONTEXT && !m_BackendRenderer->canRecreateDecoderContext()) {
+        tier = RT_FULL_RESET;
+    }
+
+    // Nothing we've submitted is coming out of the decoder anymore
+    m_PendingPackets.clear();
+    m_FramesOut = m_FramesIn;
+
+    switch (tier) {
+    case RT_FLUSH:
+        // Drop all references and wait for an IDR frame to resync the decoder
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Flushing decoder due to consistent failure");
+        avcodec_flush_buffers(m_VideoDecoderCtx);
+        break;
+
+    case RT_RECREATE_CONTEXT:
+        // Start over with a new decoder context (and any hwaccel state and
+        // surface pool inside it) while keeping the renderers and Pacer alive.
+        // The new context is attached to the renderer's existing hw_device_ctx.
+        // Renderers tie that device to their display connection, presentation
+        // queue, or GL interop, so it can only be replaced by the full reset.
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Recreating decoder context due to consistent failure");
+        avcodec_free_context(&m_VideoDecoderCtx);
+        if (!createDecoderContext(m_Decoder, &m_DecoderParams)) {
+            // We can't decode anything now, so a full reset is our only option
+            avcodec_free_context(&m_VideoDecoderCtx);
+            tier = RT_FULL_RESET;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if (tier == RT_FULL_RESET) {
+        // Generate a synthetic reset event to trigger the event loop
+        // to destroy and recreate the decoder and renderers.
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Resetting decoder due to consistent failure");
+
+        SDL_Event event;
+        event.type = SDL_RENDER_DEVICE_RESET;
+        SDL_PushEvent(&event);
+
+        // Leave m_ConsecutiveFailedDecodes alone so we
+        // don't push another reset event before it happens.
+    }
+    else {
+        // Give this tier another FAILED_DECODES_RESET_THRESHOLD decodes
+        m_ConsecutiveFailedDecodes = 0;
+    }
+
+    Uint64 elapsedUs = (SDL_GetPerformanceCounter() - startTime) * 1000000 / SDL_GetPerformanceFrequency();
+    m_RecoveryCounts[tier]++;
+    m_RecoveryTimeUs[tier] += elapsedUs;
+    m_RecoveryTier = tier + 1;
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Decoder recovery tier %d took %.2f ms",
+                tier + 1,
+                elapsedUs / 1000.0);
+
+    return DR_NEED_IDR;
+}
+
+void FFmpegVideoDecoder::logRecoveryStats()
+{
+    if (m_RecoveryCounts[RT_FLUSH] == 0 && m_RecoveryCounts[RT_RECREATE_CONTEXT] == 0 && m_RecoveryCounts[RT_FULL_RESET] == 0) {
+        return;
+    }
+
+    // The full reset itself happens on the main thread after this decoder is gone,
+    // so only the time spent requesting it is counted here.
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Decoder recovery: %d flushes (%.2f ms), %d decoder context recreations (%.2f ms), %d full resets",
+                m_RecoveryCounts[RT_FLUSH],
+                m_RecoveryTimeUs[RT_FLUSH] / 1000.0,
+                m_RecoveryCounts[RT_RECREATE_CONTEXT],
+                m_RecoveryTimeUs[RT_RECREATE_CONTEXT] / 1000.0,
+                m_RecoveryCounts[RT_FULL_RESET]);
+}
+
+void FFmpegVideoDecoder::logRfiStats()
+{
+    if (m_RfiTracker.getInvalidations() == 0) {
+        return;
+    }
+
+    // Invalidations that the output thread decoded aren't checked, so
+    // they count as neither recoveries nor fallbacks.
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Reference frame invalidation: %d invalidations, %d recovered, %d fell back to IDR frames",
+                m_RfiTracker.getInvalidations(),
+                m_RfiTracker.getRecoveries(),
+                m_RfiTracker.getFallbacks());
+}
+
 void FFmpegVideoDecoder::renderFrameOnMainThread()
 {
     m_Pacer->renderOnMainThread();
 }
 
+bool FFmpegVideoDecoder::detachFromSession()
+{
+    if (m_VideoDecoderCtx == nullptr) {
+        // Decoder recovery failed, so this isn't worth keeping
+        return false;
+    }
+
+    // The output thread restarts on its own once we're decoding again
+    stopOutputThread();
+
+    // Stop the pacer's V-sync and render threads and free the frames it
+    // still holds. Nothing may render while there's no active session,
+    // and the next session shouldn't show our last frames.
+    delete m_Pacer;
+    m_Pacer = nullptr;
+
+    // The next session starts over with an IDR frame
+    avcodec_flush_buffers(m_VideoDecoderCtx);
+    m_FramesIn = m_FramesOut = 0;
+    m_LastFrameNumber = 0;
+    m_ConsecutiveFailedDecodes = 0;
+    SDL_AtomicSet(&m_OutputThreadNeedsIdr, 0);
+
+    Session::get()->getOverlayManager().setOverlayRenderer(nullptr);
+
+    // We won't be destroyed with this session, so log its stats now
+    logVideoStats(m_GlobalVideoStats, "Global video stats");
+    logRecoveryStats();
+    logRfiStats();
+
+    SDL_zero(m_ActiveWndVideoStats);
+    SDL_zero(m_LastWndVideoStats);
+    SDL_zero(m_GlobalVideoStats);
+    m_RecoveryTier = 0;
+    SDL_zero(m_RecoveryCounts);
+    SDL_zero(m_RecoveryTimeUs);
+    m_RfiTracker.reset();
+
+    return true;
+}
+
+bool FFmpegVideoDecoder::attachToSession()
+{
+    // detachFromSession() destroyed the last session's pacer
+    SDL_assert(m_Pacer == nullptr);
+    m_Pacer = new Pacer(m_FrontendRenderer, &m_ActiveWndVideoStats);
+    if (!m_Pacer->initialize(m_DecoderParams.window, m_DecoderParams.frameRate, m_DecoderParams.enableFramePacing)) {
+        return false;
+    }
+
+    Session::get()->getOverlayManager().setOverlayRenderer(m_FrontendRenderer);
+    return true;
+}
+
@@ -2,7 +2,13 @@
 
 #include <functional>
 
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
 #include "decoder.h"
+#include "rfitracker.h"
 #include "ffmpeg-renderers/renderer.h"
 #include "ffmpeg-renderers/pacer/pacer.h"
 
@@ -22,18 +28,49 @@ public:
     virtual QSize getDecoderMaxResolution() override;
     virtual int submitDecodeUnit(PDECODE_UNIT du) override;
     virtual void renderFrameOnMainThread() override;
+    virtual bool detachFromSession() override;
+    virtual bool attachToSession() override;
 
     virtual IFFmpegRenderer* getBackendRenderer();
 
 private:
+    bool createDecoderContext(const AVCodec* decoder, PDECODER_PARAMETERS params);
+
     bool completeInitialization(const AVCodec* decoder, PDECODER_PARAMETERS params, bool testFrame, bool eglOnly);
 
-    void stringifyVideoStats(VIDEO_STATS& stats, char* output);
+    int recoverFromFailedDecodes();
+
+    int submitPacketToOutputThread(PDECODE_UNIT du);
+
+    void submitDecodedFrame(AVFrame* frame, unsigned int presentationTimeMs);
+
+    void startOutputThread();
+
+    void stopOutputThread();
+
+    static
+    int outputThreadProc(void* context);
+
+    void logRecoveryStats();
+
+    void logRfiStats();
+
+    void stringifyVideoStats(VIDEO_STATS& stats, char* output, int length);
 
     void logVideoStats(VIDEO_STATS& stats, const char* title);
 
     void addVideoStats(VIDEO_STATS& src, VIDEO_STATS& dst);
 
+    bool getAvLatencies(VIDEO_STATS& stats, float& videoLatencyMs, float& audioLatencyMs);
+
+    void trimAvSyncOffset(VIDEO_STATS& stats);
+
+    Uint64 getVideoMemoryUsage();
+
+    void updateHwSurfacePoolSize(const AVFrame* frame);
+
+    void sampleMemoryUsage(VIDEO_STATS& stats);
+
     bool createFrontendRenderer(PDECODER_PARAMETERS params, bool eglOnly);
 
     bool tryInitializeRendererForDecoderByName(const char* decoderName,
@@ -46,6 +83,16 @@ private:
 
     static IFFmpegRenderer* createHwAccelRenderer(const AVCodecHWConfig* hwDecodeCfg, int pass);
 
+    void saveValidatedConfig(const AVCodec* decoder,
+                             PDECODER_PARAMETERS params,
+                             const AVCodecHWConfig* hwConfig,
+                             std::function<IFFmpegRenderer*()> createRendererFunc,
+                             bool eglFrontend);
+
+    bool tryInitializeValidatedRenderer(PDECODER_PARAMETERS params);
+
+    static int findValidatedConfig(PDECODER_PARAMETERS params);
+
     void reset();
 
     void writeBuffer(PLENTRY entry, int& offset);
@@ -54,6 +101,9 @@ private:
     enum AVPixelFormat ffGetFormat(AVCodecContext* context,
                                    const enum AVPixelFormat* pixFmts);
 
+    static
+    int ffGetBuffer2(AVCodecContext* context, AVFrame* frame, int flags);
+
     AVPacket* m_Pkt;
     AVCodecContext* m_VideoDecoderCtx;
     QByteArray m_DecodeBuffer;
@@ -61,7 +111,28 @@ private:
     IFFmpegRenderer* m_BackendRenderer;
     IFFmpegRenderer* m_FrontendRenderer;
     int m_ConsecutiveFailedDecodes;
+
+    // Decoder recovery escalates through these tiers each time
+    // FAILED_DECODES_RESET_THRESHOLD is reached without a good frame.
+    // RT_RECREATE_CONTEXT keeps the renderer's hardware device, so
+    // only RT_FULL_RESET recovers from a lost or wedged device.
+    enum RecoveryTier {
+        RT_FLUSH,
+        RT_RECREATE_CONTEXT,
+        RT_FULL_RESET,
+        RT_MAX
+    };
+    const AVCodec* m_Decoder;
+    DECODER_PARAMETERS m_DecoderParams;
+    int m_RecoveryTier;
+    Uint64 m_RecoveryStartTime;
+    int m_RecoveryCounts[RT_MAX];
+    Uint64 m_RecoveryTimeUs[RT_MAX];
     Pacer* m_Pacer;
+
+    // The get_buffer2() callback that ffGetBuffer2() wraps
+    int (*m_GetBuffer2)(AVCodecContext* context, AVFrame* frame, int flags);
+
     VIDEO_STATS m_ActiveWndVideoStats;
     VIDEO_STATS m_LastWndVideoStats;
     VIDEO_STATS m_GlobalVideoStats;
@@ -69,10 +140,42 @@ private:
     int m_FramesIn;
     int m_FramesOut;
 
+    // m_DecoderCtxLock protects m_VideoDecoderCtx, m_PendingPackets,
+    // m_FramesIn, m_FramesOut, the recovery state, and the decoder's
+    // updates to m_ActiveWndVideoStats. submitDecodeUnit() holds it
+    // for the whole call.
+    struct PendingPacket {
+        unsigned int presentationTimeMs;
+        uint64_t enqueueTimeMs;
+        Uint64 submitTime;
+    };
+    SDL_Thread* m_OutputThread;
+    QMutex m_DecoderCtxLock;
+    QWaitCondition m_PacketSubmitted;
+    QWaitCondition m_FrameReceived;
+    QQueue<PendingPacket> m_PendingPackets;
+    bool m_OutputThreadStopping;
+    enum {
+        OTM_AUTO,
+        OTM_ALWAYS,
+        OTM_NEVER
+    } m_OutputThreadMode;
+    SDL_atomic_t m_OutputThreadNeedsIdr;
+
+    // Size of the hardware surface pool behind the last decoded frame.
+    // FFmpeg can replace the decoder's frames context while decoding, so
+    // this is read from each frame's own reference to it instead.
+    SDL_atomic_t m_HwSurfacePoolKb;
+
+    // Drop audio or video to bring them back in sync
+    bool m_AvSyncTrim;
+
     int m_LastFrameNumber;
     int m_StreamFps;
     int m_VideoFormat;
     bool m_NeedsSpsFixup;
+
+    RfiTracker m_RfiTracker;
     bool m_TestOnly;
     enum {
         RRF_UNKNOWN,
@@ -80,6 +183,27 @@ private:
         RRF_NO
     } m_CanRetryReceiveFrame;
 
+    // Decoder and renderer combinations that passed initialization, keyed by
+    // the stream parameters. Later decoders with the same key reuse them
+    // rather than repeating the whole search across decoders and hwaccel
+    // configs. The key leaves out anything tied to the window, like V-sync
+    // or the display, so the test decoder's results match real sessions.
+    // The reused renderer still gets a test frame on the real window if
+    // it asks for one, and a failed reuse falls back to the full search.
+    struct ValidatedConfig {
+        int videoFormat;
+        int width;
+        int height;
+        StreamingPreferences::VideoDecoderSelection vds;
+        bool headless;
+        const AVCodec* decoder;
+        const AVCodecHWConfig* hwConfig;
+        std::function<IFFmpegRenderer*()> createRendererFunc;
+        bool eglFrontend;
+    };
+    static QList<ValidatedConfig> s_ValidatedConfigs;
+    static QMutex s_ValidatedConfigsLock;
+
     static const uint8_t k_H264TestFrame[];
     static const uint8_t k_HEVCMainTestFrame[];
     static const uint8_t k_HEVCMain10TestFrame[];
@@ -1,11 +1,17 @@
 #include "overlaymanager.h"
 #include "path.h"
 
+// Overlay text wraps at this width (in pixels)
+#define OVERLAY_WRAP_WIDTH 1024
+
 using namespace Overlay;
 
 OverlayManager::OverlayManager() :
     m_Renderer(nullptr),
-    m_FontData(Path::readDataFile("ModeSeven.ttf"))
+    m_FontData(Path::readDataFile("ModeSeven.ttf")),
+    m_RenderThread(nullptr),
+    m_RenderThreadStopping(false),
+    m_MemoryUsage{}
 {
     memset(m_Overlays, 0, sizeof(m_Overlays));
 
@@ -22,14 +28,41 @@ OverlayManager::OverlayManager() :
                     TTF_GetError());
         return;
     }
+
+    // Rasterizing overlay text is slow, so we do it on a low priority thread
+    // to avoid stalling the decoder thread that updates the stats overlay.
+    m_RenderThread = SDL_CreateThread(OverlayManager::renderThreadProc, "OverlayRender", this);
+    if (m_RenderThread == nullptr) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Unable to create overlay render thread: %s",
+                    SDL_GetError());
+    }
 }
 
 OverlayManager::~OverlayManager()
 {
+    if (m_RenderThread != nullptr) {
+        m_RenderLock.lock();
+        m_RenderThreadStopping = true;
+        m_RenderPending.wakeOne();
+        m_RenderLock.unlock();
+
+        SDL_WaitThread(m_RenderThread, nullptr);
+    }
+
     for (int i = 0; i < OverlayType::OverlayMax; i++) {
         if (m_Overlays[i].surface != nullptr) {
             SDL_FreeSurface(m_Overlays[i].surface);
         }
+        for (int j = 0; j < (int)SDL_arraysize(m_Overlays[i].glyphs); j++) {
+            if (m_Overlays[i].glyphs[j] != nullptr) {
+                SDL_FreeSurface(m_Overlays[i].glyphs[j]);
+            }
+        }
+        if (m_Overlays[i].canvas != nullptr) {
+            SDL_FreeSurface(m_Overlays[i].canvas);
+        }
+        SDL_free(m_Overlays[i].canvasCells);
         if (m_Overlays[i].font != nullptr) {
             TTF_CloseFont(m_Overlays[i].font);
         }
@@ -49,6 +82,11 @@ char* OverlayManager::getOverlayText(OverlayType type)
     return m_Overlays[type].text;
 }
 
+int OverlayManager::getOverlayMaxTextLength()
+{
+    return sizeof(m_Overlays[0].text);
+}
+
 int OverlayManager::getOverlayFontSize(OverlayType type)
 {
     return m_Overlays[type].fontSize;
@@ -93,7 +131,10 @@ SDL_Color OverlayManager::getOverlayColor(OverlayType type)
 
 void OverlayManager::setOverlayRenderer(IOverlayRenderer* renderer)
 {
+    // Wait for any in-progress notification on the render thread to finish
+    m_RendererLock.lock();
     m_Renderer = renderer;
+    m_RendererLock.unlock();
 }
 
 void OverlayManager::notifyOverlayUpdated(OverlayType type)
@@ -102,6 +143,212 @@ void OverlayManager::notifyOverlayUpdated(OverlayType type)
         return;
     }
 
+    if (m_RenderThread == nullptr) {
+        // No render thread, so we have to do it synchronously
+        SDL_strlcpy(m_Overlays[type].pendingText, m_Overlays[type].text, sizeof(m_Overlays[type].pendingText));
+        renderOverlay(type);
+        return;
+    }
+
+    // Snapshot the text now, since the caller may keep writing to it
+    // while the render thread is rasterizing.
+    m_RenderLock.lock();
+    SDL_strlcpy(m_Overlays[type].pendingText, m_Overlays[type].text, sizeof(m_Overlays[type].pendingText));
+    m_Overlays[type].renderPending = true;
+    m_RenderPending.wakeOne();
+    m_RenderLock.unlock();
+}
+
+int OverlayManager::renderThreadProc(void* context)
+{
+    auto me = reinterpret_cast<OverlayManager*>(context);
+
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    me->m_RenderLock.lock();
+    while (!me->m_RenderThreadStopping) {
+        bool rendered = false;
+
+        for (int i = 0; i < OverlayType::OverlayMax; i++) {
+            if (me->m_Overlays[i].renderPending) {
+                me->m_Overlays[i].renderPending = false;
+
+                // Don't block new notifications while we rasterize
+                me->m_RenderLock.unlock();
+                me->renderOverlay((OverlayType)i);
+                me->m_RenderLock.lock();
+
+                rendered = true;
+            }
+        }
+
+        if (!rendered) {
+            me->m_RenderPending.wait(&me->m_RenderLock);
+        }
+    }
+    me->m_RenderLock.unlock();
+
+    return 0;
+}
+
+SDL_Surface* OverlayManager::getGlyph(OverlayType type, char ch)
+{
+    if (ch < ' ' || ch > '~') {
+        ch = '?';
+    }
+
+    if (m_Overlays[type].glyphs[(int)ch] == nullptr) {
+        SDL_Surface* glyph = TTF_RenderGlyph_Blended(m_Overlays[type].font, ch, m_Overlays[type].color);
+        if (glyph == nullptr) {
+            return nullptr;
+        }
+
+        // We clear each cell before drawing, so copy the alpha channel as-is
+        SDL_SetSurfaceBlendMode(glyph, SDL_BLENDMODE_NONE);
+        m_Overlays[type].glyphs[(int)ch] = glyph;
+    }
+
+    return m_Overlays[type].glyphs[(int)ch];
+}
+
+SDL_Surface* OverlayManager::renderOverlayText(OverlayType type, const char* text)
+{
+    if (!TTF_FontFaceIsFixedWidth(m_Overlays[type].font)) {
+        // The glyph cache only works for monospace fonts.
+        // The _Wrapped variant is required for line breaks to work.
+        return TTF_RenderText_Blended_Wrapped(m_Overlays[type].font,
+                                              text,
+                                              m_Overlays[type].color,
+                                              OVERLAY_WRAP_WIDTH);
+    }
+
+    if (m_Overlays[type].glyphWidth == 0) {
+        int advance;
+        if (TTF_GlyphMetrics(m_Overlays[type].font, 'M', nullptr, nullptr, nullptr, nullptr, &advance) != 0 || advance <= 0) {
+            return nullptr;
+        }
+
+        m_Overlays[type].glyphWidth = advance;
+        m_Overlays[type].lineHeight = TTF_FontLineSkip(m_Overlays[type].font);
+    }
+
+    int glyphWidth = m_Overlays[type].glyphWidth;
+    int lineHeight = m_Overlays[type].lineHeight;
+    int maxColumns = qMax(OVERLAY_WRAP_WIDTH / glyphWidth, 1);
+
+    // Lay out the text into a grid of character cells
+    int len = (int)strlen(text);
+    while (len > 0 && text[len - 1] == '\n') {
+        len--;
+    }
+    if (len == 0) {
+        return nullptr;
+    }
+
+    int columns = 0, rows = 1, column = 0;
+    for (int i = 0; i < len; i++) {
+        if (text[i] == '\n' || column == maxColumns) {
+            rows++;
+            column = 0;
+            if (text[i] == '\n') {
+                continue;
+            }
+        }
+        column++;
+        columns = qMax(columns, column);
+    }
+
+    if (columns == 0) {
+        return nullptr;
+    }
+
+    // Start over with a fresh canvas if the dimensions changed
+    if (m_Overlays[type].canvas == nullptr ||
+            m_Overlays[type].canvasColumns != columns ||
+            m_Overlays[type].canvasRows != rows) {
+        if (m_Overlays[type].canvas != nullptr) {
+            SDL_FreeSurface(m_Overlays[type].canvas);
+        }
+        SDL_free(m_Overlays[type].canvasCells);
+
+        // Match the format that TTF_RenderText_Blended() produces
+        m_Overlays[type].canvas = SDL_CreateRGBSurfaceWithFormat(0, columns * glyphWidth, rows * lineHeight,
+                                                                 32, SDL_PIXELFORMAT_ARGB8888);
+        m_Overlays[type].canvasCells = (char*)SDL_malloc(columns * rows);
+        if (m_Overlays[type].canvas == nullptr || m_Overlays[type].canvasCells == nullptr) {
+            if (m_Overlays[type].canvas != nullptr) {
+                SDL_FreeSurface(m_Overlays[type].canvas);
+                m_Overlays[type].canvas = nullptr;
+            }
+            SDL_free(m_Overlays[type].canvasCells);
+            m_Overlays[type].canvasCells = nullptr;
+            return nullptr;
+        }
+
+        m_Overlays[type].canvasColumns = columns;
+        m_Overlays[type].canvasRows = rows;
+
+        SDL_Color color = m_Overlays[type].color;
+        SDL_FillRect(m_Overlays[type].canvas, nullptr,
+                     SDL_MapRGBA(m_Overlays[type].canvas->format, color.r, color.g, color.b, 0));
+        SDL_memset(m_Overlays[type].canvasCells, ' ', columns * rows);
+    }
+
+    SDL_Surface* canvas = m_Overlays[type].canvas;
+    char* cells = m_Overlays[type].canvasCells;
+    Uint32 clearColor = SDL_MapRGBA(canvas->format,
+                                    m_Overlays[type].color.r,
+                                    m_Overlays[type].color.g,
+                                    m_Overlays[type].color.b,
+                                    0);
+
+    // Only redraw the cells that changed since the last update. Most of the
+    // stats overlay is static labels, so this is usually a small fraction.
+    int textIndex = 0;
+    for (int row = 0; row < rows; row++) {
+        bool lineEnded = false;
+
+        for (column = 0; column < columns; column++) {
+            char ch = ' ';
+
+            if (!lineEnded && textIndex < len && text[textIndex] != '\n') {
+                ch = text[textIndex++];
+            }
+            else {
+                lineEnded = true;
+            }
+
+            char* cell = &cells[row * columns + column];
+            if (*cell == ch) {
+                continue;
+            }
+
+            SDL_Rect cellRect = { column * glyphWidth, row * lineHeight, glyphWidth, lineHeight };
+            SDL_FillRect(canvas, &cellRect, clearColor);
+
+            if (ch != ' ') {
+                SDL_Surface* glyph = getGlyph(type, ch);
+                if (glyph != nullptr) {
+                    SDL_Rect srcRect = { 0, 0, qMin(glyph->w, glyphWidth), qMin(glyph->h, lineHeight) };
+                    SDL_BlitSurface(glyph, &srcRect, canvas, &cellRect);
+                }
+            }
+
+            *cell = ch;
+        }
+
+        // Consume the line break (if any) that ended this row
+        if (textIndex < len && text[textIndex] == '\n') {
+            textIndex++;
+        }
+    }
+
+    // Renderers take ownership of the surface they receive, so hand out a copy
+    return SDL_ConvertSurface(canvas, canvas->format, 0);
+}
+
+void OverlayManager::renderOverlay(OverlayType type)
+{
     // Construct the required font to render the overlay
     if (m_Overlays[type].font == nullptr) {
         if (m_FontData.isEmpty()) {
@@ -132,14 +379,48 @@ void OverlayManager::notifyOverlayUpdated(OverlayType type)
     }
 
     if (m_Overlays[type].enabled) {
-        // The _Wrapped variant is required for line breaks to work
-        SDL_Surface* surface = TTF_RenderText_Blended_Wrapped(m_Overlays[type].font,
-                                                              m_Overlays[type].text,
-                                                              m_Overlays[type].color,
-                                                              1024);
+        char text[sizeof(m_Overlays[type].pendingText)];
+
+        m_RenderLock.lock();
+        SDL_strlcpy(text, m_Overlays[type].pendingText, sizeof(text));
+        m_RenderLock.unlock();
+
+        SDL_Surface* surface = renderOverlayText(type, text);
         SDL_AtomicSetPtr((void**)&m_Overlays[type].surface, surface);
     }
 
     // Notify the renderer
-    m_Renderer->notifyOverlayUpdated(type);
+    m_RendererLock.lock();
+    if (m_Renderer != nullptr) {
+        m_Renderer->notifyOverlayUpdated(type);
+    }
+    m_RendererLock.unlock();
+
+    updateMemoryUsage();
+}
+
+static int getSurfaceBytes(SDL_Surface* surface)
+{
+    return surface != nullptr ? surface->pitch * surface->h : 0;
+}
+
+void OverlayManager::updateMemoryUsage()
+{
+    int bytes = 0;
+
+    for (int i = 0; i < OverlayType::OverlayMax; i++) {
+        for (int j = 0; j < (int)SDL_arraysize(m_Overlays[i].glyphs); j++) {
+            bytes += getSurfaceBytes(m_Overlays[i].glyphs[j]);
+        }
+
+        // The renderer is handed a copy of the canvas while the overlay is enabled
+        bytes += getSurfaceBytes(m_Overlays[i].canvas) * (m_Overlays[i].enabled ? 2 : 1);
+    }
+
+    SDL_AtomicSet(&m_MemoryUsage, bytes);
+}
+
+int OverlayManager::getMemoryUsage()
+{
+    return SDL_AtomicGet(&m_MemoryUsage);
 }
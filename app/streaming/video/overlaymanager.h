@@ -1,6 +1,9 @@
 #pragma once
 
 #include <QString>
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include <SDL.h>
 #include <SDL_ttf.h>
@@ -29,28 +32,59 @@ public:
 
     bool isOverlayEnabled(OverlayType type);
     char* getOverlayText(OverlayType type);
+    int getOverlayMaxTextLength();
     void setOverlayTextUpdated(OverlayType type);
     void setOverlayState(OverlayType type, bool enabled);
     SDL_Color getOverlayColor(OverlayType type);
     int getOverlayFontSize(OverlayType type);
     SDL_Surface* getUpdatedOverlaySurface(OverlayType type);
 
+    // Approximate bytes held by rasterized glyphs and overlay surfaces
+    int getMemoryUsage();
+
     void setOverlayRenderer(IOverlayRenderer* renderer);
 
 private:
     void notifyOverlayUpdated(OverlayType type);
+    void renderOverlay(OverlayType type);
+    SDL_Surface* renderOverlayText(OverlayType type, const char* text);
+    SDL_Surface* getGlyph(OverlayType type, char ch);
+    void updateMemoryUsage();
+
+    static
+    int renderThreadProc(void* context);
 
     struct {
         bool enabled;
         int fontSize;
         SDL_Color color;
-        char text[512];
+        char text[1024];
 
         TTF_Font* font;
         SDL_Surface* surface;
+
+        // These are protected by m_RenderLock
+        bool renderPending;
+        char pendingText[1024];
+
+        // These are only touched by the render thread
+        SDL_Surface* glyphs[128];
+        int glyphWidth;
+        int lineHeight;
+        SDL_Surface* canvas;
+        char* canvasCells;
+        int canvasColumns;
+        int canvasRows;
     } m_Overlays[OverlayMax];
     IOverlayRenderer* m_Renderer;
+    QMutex m_RendererLock;
     QByteArray m_FontData;
+
+    SDL_Thread* m_RenderThread;
+    QMutex m_RenderLock;
+    QWaitCondition m_RenderPending;
+    bool m_RenderThreadStopping;
+    SDL_atomic_t m_MemoryUsage;
 };
 
 }
@@ -0,0 +1,242 @@
+#include "planecopy.h"
+
+#include <QtGlobal>
+#include <QByteArray>
+
+#include <mutex>
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PLANE_COPY_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+// GCC and Clang require us to explicitly enable instruction sets
+// that aren't part of the baseline for functions that use them.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+// Copies larger than this use non-temporal stores to avoid evicting the
+// entire cache with data that the CPU won't read again (the destination
+// is usually mapped texture memory).
+#define NON_TEMPORAL_THRESHOLD (1024 * 1024)
+
+static void copyRowsC(Uint8* dst, int dstPitch,
+                      const Uint8* src, int srcPitch,
+                      int rowBytes, int rows)
+{
+    for (int y = 0; y < rows; y++) {
+        memcpy(dst + (size_t)dstPitch * y, src + (size_t)srcPitch * y, rowBytes);
+    }
+}
+
+#ifdef PLANE_COPY_X86
+
+TARGET_SSE2
+static void copyRowsSSE2(Uint8* dst, int dstPitch,
+                         const Uint8* src, int srcPitch,
+                         int rowBytes, int rows)
+{
+    bool nonTemporal = (size_t)rowBytes * rows >= NON_TEMPORAL_THRESHOLD;
+
+    for (int y = 0; y < rows; y++) {
+        Uint8* d = dst + (size_t)dstPitch * y;
+        const Uint8* s = src + (size_t)srcPitch * y;
+
+        // Copy up to the first 16 byte aligned destination address
+        int x = qMin((int)((16 - ((uintptr_t)d & 15)) & 15), rowBytes);
+        memcpy(d, s, x);
+
+        if (nonTemporal) {
+            for (; x + 64 <= rowBytes; x += 64) {
+                __m128i v0 = _mm_loadu_si128((const __m128i*)(s + x));
+                __m128i v1 = _mm_loadu_si128((const __m128i*)(s + x + 16));
+                __m128i v2 = _mm_loadu_si128((const __m128i*)(s + x + 32));
+                __m128i v3 = _mm_loadu_si128((const __m128i*)(s + x + 48));
+                _mm_stream_si128((__m128i*)(d + x), v0);
+                _mm_stream_si128((__m128i*)(d + x + 16), v1);
+                _mm_stream_si128((__m128i*)(d + x + 32), v2);
+                _mm_stream_si128((__m128i*)(d + x + 48), v3);
+            }
+        }
+        else {
+            for (; x + 64 <= rowBytes; x += 64) {
+                __m128i v0 = _mm_loadu_si128((const __m128i*)(s + x));
+                __m128i v1 = _mm_loadu_si128((const __m128i*)(s + x + 16));
+                __m128i v2 = _mm_loadu_si128((const __m128i*)(s + x + 32));
+                __m128i v3 = _mm_loadu_si128((const __m128i*)(s + x + 48));
+                _mm_store_si128((__m128i*)(d + x), v0);
+                _mm_store_si128((__m128i*)(d + x + 16), v1);
+                _mm_store_si128((__m128i*)(d + x + 32), v2);
+                _mm_store_si128((__m128i*)(d + x + 48), v3);
+            }
+        }
+
+        // Copy the remainder of the row
+        memcpy(d + x, s + x, rowBytes - x);
+    }
+
+    if (nonTemporal) {
+        // Make our non-temporal stores visible before returning
+        _mm_sfence();
+    }
+}
+
+TARGET_AVX2
+static void copyRowsAVX2(Uint8* dst, int dstPitch,
+                         const Uint8* src, int srcPitch,
+                         int rowBytes, int rows)
+{
+    bool nonTemporal = (size_t)rowBytes * rows >= NON_TEMPORAL_THRESHOLD;
+
+    for (int y = 0; y < rows; y++) {
+        Uint8* d = dst + (size_t)dstPitch * y;
+        const Uint8* s = src + (size_t)srcPitch * y;
+
+        // Copy up to the first 32 byte aligned destination address
+        int x = qMin((int)((32 - ((uintptr_t)d & 31)) & 31), rowBytes);
+        memcpy(d, s, x);
+
+        if (nonTemporal) {
+            for (; x + 128 <= rowBytes; x += 128) {
+                __m256i v0 = _mm256_loadu_si256((const __m256i*)(s + x));
+                __m256i v1 = _mm256_loadu_si256((const __m256i*)(s + x + 32));
+                __m256i v2 = _mm256_loadu_si256((const __m256i*)(s + x + 64));
+                __m256i v3 = _mm256_loadu_si256((const __m256i*)(s + x + 96));
+                _mm256_stream_si256((__m256i*)(d + x), v0);
+                _mm256_stream_si256((__m256i*)(d + x + 32), v1);
+                _mm256_stream_si256((__m256i*)(d + x + 64), v2);
+                _mm256_stream_si256((__m256i*)(d + x + 96), v3);
+            }
+        }
+        else {
+            for (; x + 128 <= rowBytes; x += 128) {
+                __m256i v0 = _mm256_loadu_si256((const __m256i*)(s + x));
+                __m256i v1 = _mm256_loadu_si256((const __m256i*)(s + x + 32));
+                __m256i v2 = _mm256_loadu_si256((const __m256i*)(s + x + 64));
+                __m256i v3 = _mm256_loadu_si256((const __m256i*)(s + x + 96));
+                _mm256_store_si256((__m256i*)(d + x), v0);
+                _mm256_store_si256((__m256i*)(d + x + 32), v1);
+                _mm256_store_si256((__m256i*)(d + x + 64), v2);
+                _mm256_store_si256((__m256i*)(d + x + 96), v3);
+            }
+        }
+
+        // Copy the remainder of the row
+        memcpy(d + x, s + x, rowBytes - x);
+    }
+
+    if (nonTemporal) {
+        // Make our non-temporal stores visible before returning
+        _mm_sfence();
+    }
+}
+
+#endif
+
+QVector<PlaneCopy::Implementation> PlaneCopy::getSupportedImplementations()
+{
+    QVector<Implementation> impls;
+
+    // On ARM, the C library's memcpy() is already vectorized and we've not
+    // found a NEON kernel that beats it, so there's nothing extra to offer.
+    impls.append({ "memcpy", copyRowsC });
+#ifdef PLANE_COPY_X86
+    if (SDL_HasSSE2()) {
+        impls.append({ "sse2", copyRowsSSE2 });
+    }
+    if (SDL_HasAVX2()) {
+        impls.append({ "avx2", copyRowsAVX2 });
+    }
+#endif
+
+    return impls;
+}
+
+const PlaneCopy::Implementation& PlaneCopy::getImplementation()
+{
+    static std::once_flag s_SelectOnce;
+    static Implementation s_Selected;
+
+    // The first copy may happen on any of several threads at once
+    std::call_once(s_SelectOnce, []() {
+        QVector<Implementation> impls = getSupportedImplementations();
+
+        // Implementations are listed in order of preference
+        s_Selected = impls.last();
+
+        QByteArray forcedImpl = qgetenv("PLANE_COPY_IMPL");
+        if (!forcedImpl.isEmpty()) {
+            int i;
+            for (i = 0; i < impls.size(); i++) {
+                if (forcedImpl == impls[i].name) {
+                    s_Selected = impls[i];
+                    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                                "Using custom plane copy implementation: %s",
+                                impls[i].name);
+                    break;
+                }
+            }
+            if (i == impls.size()) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "Unsupported plane copy implementation: %s",
+                            forcedImpl.constData());
+            }
+        }
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Selected plane copy implementation: %s",
+                    s_Selected.name);
+    });
+
+    return s_Selected;
+}
+
+const char* PlaneCopy::getImplementationName()
+{
+    return getImplementation().name;
+}
+
+void PlaneCopy::copyPlane(Uint8* dst, int dstPitch,
+                          const Uint8* src, int srcPitch,
+                          int rowBytes, int rows)
+{
+    CopyRowsFn copyRows = getImplementation().copyRows;
+
+    if (rowBytes <= 0 || rows <= 0) {
+        return;
+    }
+
+    if (dstPitch == rowBytes && srcPitch == rowBytes) {
+        // Both planes are contiguous, so copy them as a single row
+        copyRows(dst, 0, src, 0, rowBytes * rows, 1);
+    }
+    else {
+        copyRows(dst, dstPitch, src, srcPitch, rowBytes, rows);
+    }
+}
+
+void PlaneCopy::copyNV12(Uint8* dstY, int dstYPitch, Uint8* dstUV, int dstUVPitch,
+                         const Uint8* srcY, int srcYPitch, const Uint8* srcUV, int srcUVPitch,
+                         int width, int height, int bytesPerSample)
+{
+    // The interleaved chroma plane has the same row size as luma
+    copyPlane(dstY, dstYPitch, srcY, srcYPitch, width * bytesPerSample, height);
+    copyPlane(dstUV, dstUVPitch, srcUV, srcUVPitch, ((width + 1) & ~1) * bytesPerSample, (height + 1) / 2);
+}
+
+void PlaneCopy::copyYUV420P(Uint8* dstY, int dstYPitch, Uint8* dstU, int dstUPitch, Uint8* dstV, int dstVPitch,
+                            const Uint8* srcY, int srcYPitch, const Uint8* srcU, int srcUPitch, const Uint8* srcV, int srcVPitch,
+                            int width, int height)
+{
+    copyPlane(dstY, dstYPitch, srcY, srcYPitch, width, height);
+    copyPlane(dstU, dstUPitch, srcU, srcUPitch, (width + 1) / 2, (height + 1) / 2);
+    copyPlane(dstV, dstVPitch, srcV, srcVPitch, (width + 1) / 2, (height + 1) / 2);
+}
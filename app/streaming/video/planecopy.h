@@ -0,0 +1,47 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <QVector>
+
+class PlaneCopy
+{
+public:
+    // Copies a plane of rowBytes x rows, converting between pitches
+    static
+    void copyPlane(Uint8* dst, int dstPitch,
+                   const Uint8* src, int srcPitch,
+                   int rowBytes, int rows);
+
+    // Copies NV12 (bytesPerSample = 1) or P010 (bytesPerSample = 2) planes
+    static
+    void copyNV12(Uint8* dstY, int dstYPitch, Uint8* dstUV, int dstUVPitch,
+                  const Uint8* srcY, int srcYPitch, const Uint8* srcUV, int srcUVPitch,
+                  int width, int height, int bytesPerSample);
+
+    static
+    void copyYUV420P(Uint8* dstY, int dstYPitch, Uint8* dstU, int dstUPitch, Uint8* dstV, int dstVPitch,
+                     const Uint8* srcY, int srcYPitch, const Uint8* srcU, int srcUPitch, const Uint8* srcV, int srcVPitch,
+                     int width, int height);
+
+    static
+    const char* getImplementationName();
+
+    typedef void (*CopyRowsFn)(Uint8* dst, int dstPitch,
+                               const Uint8* src, int srcPitch,
+                               int rowBytes, int rows);
+
+    struct Implementation {
+        const char* name;
+        CopyRowsFn copyRows;
+    };
+
+    // Returns the row copy kernels this CPU supports, in order of
+    // preference. The first entry is always plain memcpy().
+    static
+    QVector<Implementation> getSupportedImplementations();
+
+private:
+    static
+    const Implementation& getImplementation();
+};
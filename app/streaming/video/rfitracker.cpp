@@ -0,0 +1,94 @@
+#include "rfitracker.h"
+
+RfiTracker::RfiTracker() :
+    m_Active(false)
+{
+    reset();
+}
+
+void RfiTracker::setActive(bool active)
+{
+    m_Active = active;
+}
+
+bool RfiTracker::isActive() const
+{
+    return m_Active;
+}
+
+bool RfiTracker::addFrame(int frameNumber, bool idrFrame)
+{
+    bool invalidated = false;
+
+    // If we lost frames and this isn't an IDR frame, the host has
+    // invalidated the lost references and encoded around them.
+    if (m_Active && m_LastFrameNumber != 0 &&
+            frameNumber > m_LastFrameNumber + 1 && !idrFrame) {
+        m_AwaitingFrame = true;
+        m_Invalidations++;
+        invalidated = true;
+    }
+    else if (m_AwaitingFrame && idrFrame) {
+        // We got an IDR frame before we could check the invalidated frame
+        m_AwaitingFrame = false;
+        m_Fallbacks++;
+    }
+
+    m_LastFrameNumber = frameNumber;
+    return invalidated;
+}
+
+bool RfiTracker::frameDecoded(bool corrupt)
+{
+    if (!m_AwaitingFrame) {
+        return false;
+    }
+
+    m_AwaitingFrame = false;
+    if (corrupt) {
+        // The frame referenced something we no longer have
+        m_Fallbacks++;
+        return true;
+    }
+
+    m_Recoveries++;
+    return false;
+}
+
+void RfiTracker::decodeFailed()
+{
+    if (m_AwaitingFrame) {
+        // The decoder couldn't use what was left of its references
+        m_AwaitingFrame = false;
+        m_Fallbacks++;
+    }
+}
+
+void RfiTracker::skipCheck()
+{
+    m_AwaitingFrame = false;
+}
+
+void RfiTracker::reset()
+{
+    m_LastFrameNumber = 0;
+    m_AwaitingFrame = false;
+    m_Invalidations = 0;
+    m_Recoveries = 0;
+    m_Fallbacks = 0;
+}
+
+int RfiTracker::getInvalidations() const
+{
+    return m_Invalidations;
+}
+
+int RfiTracker::getRecoveries() const
+{
+    return m_Recoveries;
+}
+
+int RfiTracker::getFallbacks() const
+{
+    return m_Fallbacks;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// Follows reference frame invalidation across a stream. When the renderer
+// supports it, the host encodes around lost frames using references we
+// still have rather than sending an IDR frame. We check the first decoded
+// frame after a loss to see whether that actually worked.
+class RfiTracker
+{
+public:
+    RfiTracker();
+
+    void setActive(bool active);
+
+    bool isActive() const;
+
+    // Records the next frame from the host. Returns true if frames were
+    // lost before it and the host encoded it around them.
+    bool addFrame(int frameNumber, bool idrFrame);
+
+    // Records decoding the last added frame. Returns true if decoding
+    // around the lost frames failed and we need an IDR frame.
+    bool frameDecoded(bool corrupt);
+
+    // Records that the last added frame couldn't be submitted
+    void decodeFailed();
+
+    // Gives up on checking the last added frame, because its decoded
+    // frame can't be matched to it
+    void skipCheck();
+
+    // Starts over with a new stream, keeping whether RFI is active
+    void reset();
+
+    int getInvalidations() const;
+
+    int getRecoveries() const;
+
+    int getFallbacks() const;
+
+private:
+    bool m_Active;
+    int m_LastFrameNumber;
+    bool m_AwaitingFrame;
+    int m_Invalidations;
+    int m_Recoveries;
+    int m_Fallbacks;
+};
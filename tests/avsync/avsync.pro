@@ -0,0 +1,10 @@
+TARGET = tst_avsync
+
+include(../tests.pri)
+
+SOURCES += \
+    tst_avsync.cpp \
+    $$PWD/../../app/streaming/avsync.cpp
+
+HEADERS += \
+    $$PWD/../../app/streaming/avsync.h
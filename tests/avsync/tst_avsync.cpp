@@ -0,0 +1,127 @@
+#include "streaming/avsync.h"
+
+#include <QtTest>
+
+#define TEST_VIDEO_FRAME_INTERVAL_MS 16
+#define TEST_AUDIO_PACKET_DURATION_MS 5
+#define TEST_FRAMES 60
+
+class TestAvSync : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Runs video frames through a fixed delay in each stage on a fake
+    // clock and measures them like FFmpegVideoDecoder and Pacer do
+    static
+    float measureVideoLatencyMs(int reassemblyMs, int decodeMs, int pacerMs, int renderMs)
+    {
+        int totalReassemblyTime = 0, totalDecodeTime = 0;
+        int totalPacerTime = 0, totalRenderTime = 0;
+
+        for (int i = 0; i < TEST_FRAMES; i++) {
+            int receiveTime = i * TEST_VIDEO_FRAME_INTERVAL_MS;
+            int enqueueTime = receiveTime + reassemblyMs;
+            int decodeEndTime = enqueueTime + decodeMs;
+            int renderStartTime = decodeEndTime + pacerMs;
+            int renderEndTime = renderStartTime + renderMs;
+
+            totalReassemblyTime += enqueueTime - receiveTime;
+            totalDecodeTime += decodeEndTime - enqueueTime;
+            totalPacerTime += renderStartTime - decodeEndTime;
+            totalRenderTime += renderEndTime - renderStartTime;
+        }
+
+        return AvSync::getVideoLatencyMs((float)totalReassemblyTime / TEST_FRAMES,
+                                         (float)totalDecodeTime / TEST_FRAMES,
+                                         (float)totalPacerTime / TEST_FRAMES,
+                                         (float)totalRenderTime / TEST_FRAMES);
+    }
+
+    // Runs audio packets through a receive queue and a renderer on a fake
+    // clock. Each packet is decoded receiveQueueMs after it arrives and is
+    // played rendererLatencyMs after that. The latency is sampled when
+    // each packet is decoded, like the audio thread does.
+    static
+    int measureAudioLatencyMs(int receiveQueueMs, int rendererLatencyMs)
+    {
+        int latencyMs = -1;
+
+        for (int i = 0; i < TEST_FRAMES; i++) {
+            int arrivalTime = i * TEST_AUDIO_PACKET_DURATION_MS;
+            int decodeTime = arrivalTime + receiveQueueMs;
+
+            // Packets that arrived after this one are still waiting
+            int pendingPackets = 0;
+            for (int j = i + 1; j * TEST_AUDIO_PACKET_DURATION_MS <= decodeTime; j++) {
+                pendingPackets++;
+            }
+
+            latencyMs = AvSync::getAudioLatencyMs(pendingPackets * TEST_AUDIO_PACKET_DURATION_MS,
+                                                  rendererLatencyMs);
+        }
+
+        return latencyMs;
+    }
+
+private slots:
+    void inSyncStreamsHaveNoOffset()
+    {
+        // Both paths take 40 ms from arriving to playing
+        float videoLatencyMs = measureVideoLatencyMs(8, 12, 14, 6);
+        int audioLatencyMs = measureAudioLatencyMs(15, 25);
+
+        QCOMPARE(videoLatencyMs, 40.0f);
+        QCOMPARE(audioLatencyMs, 40);
+
+        int audioTrimMs;
+        QCOMPARE(AvSync::getTrimAction(videoLatencyMs - audioLatencyMs, audioTrimMs), AvSync::TRIM_NONE);
+    }
+
+    void reassemblyCountsAgainstVideo()
+    {
+        // Frames that take a while to reassemble play late, just like audio
+        // that waits in the receive queue
+        float videoLatencyMs = measureVideoLatencyMs(30, 12, 14, 6);
+        int audioLatencyMs = measureAudioLatencyMs(15, 25);
+
+        int audioTrimMs;
+        QCOMPARE(videoLatencyMs - audioLatencyMs, 22.0f);
+        QCOMPARE(AvSync::getTrimAction(videoLatencyMs - audioLatencyMs, audioTrimMs), AvSync::TRIM_VIDEO);
+        QCOMPARE(audioTrimMs, 0);
+    }
+
+    void unknownAudioLatency()
+    {
+        QCOMPARE(measureAudioLatencyMs(15, -1), -1);
+    }
+
+    void trimAction_data()
+    {
+        QTest::addColumn<float>("offsetMs");
+        QTest::addColumn<int>("action");
+        QTest::addColumn<int>("audioTrimMs");
+
+        QTest::newRow("in sync") << 0.0f << (int)AvSync::TRIM_NONE << 0;
+        QTest::newRow("video slightly behind") << 20.0f << (int)AvSync::TRIM_NONE << 0;
+        QTest::newRow("audio slightly behind") << -20.0f << (int)AvSync::TRIM_NONE << 0;
+        QTest::newRow("video behind") << 35.0f << (int)AvSync::TRIM_VIDEO << 0;
+
+        // Audio is trimmed to the middle of the threshold
+        QTest::newRow("audio behind") << -50.0f << (int)AvSync::TRIM_AUDIO << 40;
+    }
+
+    void trimAction()
+    {
+        QFETCH(float, offsetMs);
+        QFETCH(int, action);
+        QFETCH(int, audioTrimMs);
+
+        int actualAudioTrimMs;
+        QCOMPARE((int)AvSync::getTrimAction(offsetMs, actualAudioTrimMs), action);
+        QCOMPARE(actualAudioTrimMs, audioTrimMs);
+    }
+};
+
+QTEST_APPLESS_MAIN(TestAvSync)
+#include "tst_avsync.moc"
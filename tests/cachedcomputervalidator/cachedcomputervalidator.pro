@@ -0,0 +1,33 @@
+TARGET = tst_cachedcomputervalidator
+CONFIG += test_openssl
+
+include(../tests.pri)
+
+# NvHTTP decodes box art with QImage
+QT += gui network
+
+INCLUDEPATH += \
+    $$PWD/../hostemulator \
+    $$PWD/../../moonlight-common-c/moonlight-common-c/src
+
+win32 {
+    LIBS += ws2_32.lib
+}
+
+SOURCES += \
+    tst_cachedcomputervalidator.cpp \
+    $$PWD/../hostemulator/emulatedhost.cpp \
+    $$PWD/../../app/backend/cachedcomputervalidator.cpp \
+    $$PWD/../../app/backend/identitymanager.cpp \
+    $$PWD/../../app/backend/nvaddress.cpp \
+    $$PWD/../../app/backend/nvapp.cpp \
+    $$PWD/../../app/backend/nvcomputer.cpp \
+    $$PWD/../../app/backend/nvhttp.cpp \
+    $$PWD/../../app/backend/nvpairingmanager.cpp \
+    $$PWD/../../app/settings/compatfetcher.cpp
+
+HEADERS += \
+    $$PWD/../hostemulator/emulatedhost.h \
+    $$PWD/../../app/backend/cachedcomputervalidator.h \
+    $$PWD/../../app/backend/nvhttp.h \
+    $$PWD/../../app/settings/compatfetcher.h
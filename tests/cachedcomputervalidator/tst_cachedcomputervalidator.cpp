@@ -0,0 +1,275 @@
+#include <QtTest>
+#include <QTcpServer>
+
+#include <cstring>
+
+#include "emulatedhost.h"
+#include "backend/cachedcomputervalidator.h"
+#include "backend/nvcomputer.h"
+#include "backend/nvpairingmanager.h"
+
+#define TEST_PIN "1234"
+
+// Longer than NvHTTP's fast fail timeout for serverinfo
+#define VALIDATION_TIMEOUT_MS 10000
+
+// The validation that StartStream::Launcher did before requests were
+// sent to each cached address at once. It tries one address at a time.
+class SerialValidationTask : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    SerialValidationTask(NvComputer* computer)
+        : m_Computer(computer)
+    {
+    }
+
+signals:
+    void validationComplete(bool valid);
+
+private:
+    void run() override
+    {
+        for (const NvAddress& address : m_Computer->uniqueAddresses()) {
+            NvHTTP http(address, 0, m_Computer->serverCert);
+
+            QString serverInfo;
+            try {
+                serverInfo = http.getServerInfo(NvHTTP::NvLogLevel::NVLL_NONE, true);
+            } catch (...) {
+                continue;
+            }
+
+            NvComputer newState(http, serverInfo);
+            if (m_Computer->uuid != newState.uuid) {
+                continue;
+            }
+
+            m_Computer->update(newState);
+            emit validationComplete(true);
+            return;
+        }
+
+        emit validationComplete(false);
+    }
+
+    NvComputer* m_Computer;
+};
+
+// Drives the cached host validation used by `moonlight stream` against
+// emulated hosts
+class TestCachedComputerValidator : public QObject
+{
+    Q_OBJECT
+
+private:
+    static NvAddress hostAddress(const EmulatedHost* host)
+    {
+        return NvAddress(QHostAddress(QHostAddress::LocalHost), host->httpPort());
+    }
+
+    // Returns the persisted state of a host we paired with and streamed from
+    NvComputer* makeCachedComputer()
+    {
+        EmulatedHost* host = m_Emulator->hosts().first();
+        NvHTTP http(hostAddress(host), host->httpsPort(), m_ServerCert);
+        NvComputer* computer = new NvComputer(http, http.getServerInfo(NvHTTP::NVLL_VERBOSE));
+
+        // Only the persisted traits survive a restart
+        computer->serverCert = m_ServerCert;
+        computer->appList = http.getAppList();
+        computer->activeAddress = NvAddress();
+        computer->localAddress = hostAddress(host);
+        computer->state = NvComputer::CS_UNKNOWN;
+        computer->pairState = NvComputer::PS_UNKNOWN;
+        return computer;
+    }
+
+    static bool validate(NvComputer* computer)
+    {
+        CachedComputerValidator validator(computer);
+        QSignalSpy spy(&validator, &CachedComputerValidator::validationComplete);
+
+        validator.start();
+        if (spy.isEmpty() && !spy.wait(VALIDATION_TIMEOUT_MS)) {
+            return false;
+        }
+
+        return spy.count() == 1 && spy.first().first().toBool();
+    }
+
+    // Returns the time from the start of validation to the launch response
+    qint64 timeToLaunch(NvComputer* computer, bool serial)
+    {
+        QElapsedTimer timer;
+        QEventLoop loop;
+        QScopedPointer<CachedComputerValidator> validator;
+        bool valid = false;
+
+        // The serial task signals from a pool thread, so wait for its
+        // result to be queued back to us instead of using QSignalSpy.
+        auto onValidationComplete = [&](bool result) {
+            valid = result;
+            loop.quit();
+        };
+        QTimer::singleShot(VALIDATION_TIMEOUT_MS, &loop, &QEventLoop::quit);
+
+        timer.start();
+        if (serial) {
+            SerialValidationTask* task = new SerialValidationTask(computer);
+            connect(task, &SerialValidationTask::validationComplete,
+                    &loop, onValidationComplete);
+            QThreadPool::globalInstance()->start(task);
+        }
+        else {
+            validator.reset(new CachedComputerValidator(computer));
+            connect(validator.data(), &CachedComputerValidator::validationComplete,
+                    &loop, onValidationComplete);
+            validator->start();
+        }
+
+        loop.exec();
+        if (!valid) {
+            return -1;
+        }
+
+        STREAM_CONFIGURATION streamConfig;
+        memset(&streamConfig, 0, sizeof(streamConfig));
+        streamConfig.width = 1920;
+        streamConfig.height = 1080;
+        streamConfig.fps = 60;
+        streamConfig.audioConfiguration = AUDIO_CONFIGURATION_STEREO;
+
+        NvHTTP http(computer->activeAddress, computer->activeHttpsPort, computer->serverCert);
+        QString rtspSessionUrl;
+        http.launchApp(computer->appList.first().id, &streamConfig, false, false, 1, rtspSessionUrl);
+        qint64 elapsed = timer.elapsed();
+
+        http.quitApp();
+        return elapsed;
+    }
+
+    HostEmulator* m_Emulator = nullptr;
+    QSslCertificate m_ServerCert;
+
+    // Accepts connections but never answers, like a host address
+    // that's no longer routed to the host
+    QTcpServer m_SilentServer;
+
+private slots:
+    void initTestCase()
+    {
+        // Keep the client identity out of the real settings
+        QStandardPaths::setTestModeEnabled(true);
+        QCoreApplication::setOrganizationName("Moonlight Game Streaming Project");
+        QCoreApplication::setApplicationName("tst_cachedcomputervalidator");
+
+        HostBehavior behavior;
+        behavior.pin = TEST_PIN;
+        m_Emulator = new HostEmulator(behavior, this);
+        QVERIFY(m_Emulator->start(1, QHostAddress::LocalHost, 0));
+
+        EmulatedHost* host = m_Emulator->hosts().first();
+        NvHTTP http(hostAddress(host), 0, QSslCertificate());
+        NvComputer computer(http, http.getServerInfo(NvHTTP::NVLL_VERBOSE));
+        NvPairingManager pairingManager(&computer);
+        QCOMPARE(pairingManager.pair(computer.appVersion, TEST_PIN, m_ServerCert), NvPairingManager::PAIRED);
+
+        QVERIFY(m_SilentServer.listen(QHostAddress::LocalHost, 0));
+    }
+
+    void validatesCachedHost()
+    {
+        QScopedPointer<NvComputer> computer(makeCachedComputer());
+        EmulatedHost* host = m_Emulator->hosts().first();
+
+        QVERIFY(validate(computer.data()));
+        QCOMPARE(computer->state, NvComputer::CS_ONLINE);
+        QCOMPARE(computer->pairState, NvComputer::PS_PAIRED);
+        QCOMPARE(computer->activeAddress, hostAddress(host));
+        QCOMPARE(computer->activeHttpsPort, host->httpsPort());
+    }
+
+    void differentHostIsStale()
+    {
+        QScopedPointer<NvComputer> computer(makeCachedComputer());
+
+        // The address now belongs to some other host
+        computer->uuid = QUuid::createUuid().toString().mid(1, 36);
+        QVERIFY(!validate(computer.data()));
+    }
+
+    void unreachableHostIsStale()
+    {
+        QScopedPointer<NvComputer> computer(makeCachedComputer());
+
+        // Nothing is listening on a port we just closed
+        QTcpServer closedServer;
+        QVERIFY(closedServer.listen(QHostAddress::LocalHost, 0));
+        computer->localAddress = NvAddress(QHostAddress(QHostAddress::LocalHost), closedServer.serverPort());
+        closedServer.close();
+
+        QVERIFY(!validate(computer.data()));
+    }
+
+    void staleAddressDoesNotDelayValidation()
+    {
+        QScopedPointer<NvComputer> computer(makeCachedComputer());
+        EmulatedHost* host = m_Emulator->hosts().first();
+
+        // The first cached address has gone stale and never answers
+        computer->remoteAddress = computer->localAddress;
+        computer->localAddress = NvAddress(QHostAddress(QHostAddress::LocalHost), m_SilentServer.serverPort());
+
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(validate(computer.data()));
+        QCOMPARE(computer->activeAddress, hostAddress(host));
+
+        // Waiting on the stale address would take the whole fast fail timeout
+        QVERIFY(timer.elapsed() < 1000);
+    }
+
+    // Compares the time from the start of `moonlight stream` host
+    // validation to the launch response when the first cached address
+    // is stale. Discovery through ComputerManager polling takes longer
+    // than either, since it adds mDNS and an app list request.
+    void timeToLaunch_data()
+    {
+        QTest::addColumn<bool>("staleAddress");
+
+        QTest::newRow("cached address") << false;
+        QTest::newRow("stale first address") << true;
+    }
+
+    void timeToLaunch()
+    {
+        QFETCH(bool, staleAddress);
+
+        QScopedPointer<NvComputer> serialComputer(makeCachedComputer());
+        QScopedPointer<NvComputer> parallelComputer(makeCachedComputer());
+        if (staleAddress) {
+            for (NvComputer* computer : { serialComputer.data(), parallelComputer.data() }) {
+                computer->remoteAddress = computer->localAddress;
+                computer->localAddress = NvAddress(QHostAddress(QHostAddress::LocalHost), m_SilentServer.serverPort());
+            }
+        }
+
+        qint64 serialMs = timeToLaunch(serialComputer.data(), true);
+        qint64 parallelMs = timeToLaunch(parallelComputer.data(), false);
+        QVERIFY(serialMs >= 0);
+        QVERIFY(parallelMs >= 0);
+
+        qInfo("Time to launch: %lld ms validating addresses one at a time, %lld ms validating them at once",
+              serialMs, parallelMs);
+
+        if (staleAddress) {
+            QVERIFY(parallelMs < serialMs);
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(TestCachedComputerValidator)
+
+#include "tst_cachedcomputervalidator.moc"
@@ -0,0 +1,10 @@
+TARGET = tst_heldframes
+
+include(../tests.pri)
+
+SOURCES += \
+    tst_heldframes.cpp \
+    $$PWD/../../app/streaming/video/ffmpeg-renderers/pacer/heldframes.cpp
+
+HEADERS += \
+    $$PWD/../../app/streaming/video/ffmpeg-renderers/pacer/heldframes.h
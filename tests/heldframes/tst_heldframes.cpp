@@ -0,0 +1,64 @@
+#include "streaming/video/ffmpeg-renderers/pacer/heldframes.h"
+
+#include <QtTest>
+
+// Pacer's normal and low memory queue limits
+#define TEST_MAX_PACING_DEPTH 4
+#define TEST_MAX_QUEUED_FRAMES 8
+#define TEST_LOW_MEMORY_MAX_PACING_DEPTH 1
+#define TEST_LOW_MEMORY_MAX_QUEUED_FRAMES 2
+
+class TestHeldFrames : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void maxHeldFrames_data()
+    {
+        QTest::addColumn<bool>("vsyncPacing");
+        QTest::addColumn<int>("maxPacingDepth");
+        QTest::addColumn<int>("maxQueuedFrames");
+        QTest::addColumn<int>("rendererHeldFrames");
+        QTest::addColumn<int>("heldFrames");
+
+        // The render queue plus the frame being rendered
+        QTest::newRow("no pacing")
+                << false << TEST_MAX_PACING_DEPTH << TEST_MAX_QUEUED_FRAMES << 0 << 3;
+        QTest::newRow("no pacing, low memory")
+                << false << TEST_LOW_MEMORY_MAX_PACING_DEPTH << TEST_LOW_MEMORY_MAX_QUEUED_FRAMES << 0 << 3;
+
+        // The pacing queue goes past the pacing depth, up to the queue limit
+        QTest::newRow("V-sync")
+                << true << TEST_MAX_PACING_DEPTH << TEST_MAX_QUEUED_FRAMES << 0 << 8;
+        QTest::newRow("V-sync, low memory")
+                << true << TEST_LOW_MEMORY_MAX_PACING_DEPTH << TEST_LOW_MEMORY_MAX_QUEUED_FRAMES << 0 << 4;
+
+        // EGL keeps its last frame, or every frame in flight when it
+        // throttles swaps with fences
+        QTest::newRow("EGL last frame")
+                << false << TEST_MAX_PACING_DEPTH << TEST_MAX_QUEUED_FRAMES << 1 << 4;
+        QTest::newRow("V-sync, EGL frames in flight")
+                << true << TEST_MAX_PACING_DEPTH << TEST_MAX_QUEUED_FRAMES << 4 << 12;
+    }
+
+    void maxHeldFrames()
+    {
+        QFETCH(bool, vsyncPacing);
+        QFETCH(int, maxPacingDepth);
+        QFETCH(int, maxQueuedFrames);
+        QFETCH(int, rendererHeldFrames);
+        QFETCH(int, heldFrames);
+
+        QCOMPARE(HeldFrames::getMaxHeldFrames(vsyncPacing, maxPacingDepth, maxQueuedFrames, rendererHeldFrames),
+                 heldFrames);
+    }
+
+    void lowMemoryHoldsFewerFrames()
+    {
+        QVERIFY(HeldFrames::getMaxHeldFrames(true, TEST_LOW_MEMORY_MAX_PACING_DEPTH, TEST_LOW_MEMORY_MAX_QUEUED_FRAMES, 0) <
+                HeldFrames::getMaxHeldFrames(true, TEST_MAX_PACING_DEPTH, TEST_MAX_QUEUED_FRAMES, 0));
+    }
+};
+
+QTEST_APPLESS_MAIN(TestHeldFrames)
+#include "tst_heldframes.moc"
@@ -0,0 +1,647 @@
+#include "emulatedhost.h"
+
+#include <QTcpSocket>
+#include <QSslSocket>
+#include <QTimer>
+#include <QUuid>
+#include <QCryptographicHash>
+#include <QTextStream>
+#include <QtDebug>
+
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/x509.h>
+
+#include <stdexcept>
+
+#define APP_VERSION "7.1.431.-1"
+#define GFE_VERSION "3.23.0.74"
+
+// Sunshine/GFE report a running game with a *_SERVER_BUSY state
+#define STATE_FREE "SUNSHINE_SERVER_FREE"
+#define STATE_BUSY "SUNSHINE_SERVER_BUSY"
+
+// Returned from launch and resume. Nothing listens here, so a real client
+// stops at the RTSP handshake after the launch latency has been measured.
+#define RTSP_SESSION_URL "rtsp://127.0.0.1:48010"
+
+// A 1x1 PNG served for every box art request
+static const char k_BoxArtPng[] =
+        "\x89\x50\x4e\x47\x0d\x0a\x1a\x0a\x00\x00\x00\x0d\x49\x48\x44\x52"
+        "\x00\x00\x00\x01\x00\x00\x00\x01\x08\x02\x00\x00\x00\x90\x77\x53"
+        "\xde\x00\x00\x00\x0c\x49\x44\x41\x54\x78\x9c\x63\x28\xdb\xc9\x00"
+        "\x00\x02\xd8\x01\x30\xac\xad\xf0\xa2\x00\x00\x00\x00\x49\x45\x4e"
+        "\x44\xae\x42\x60\x82";
+
+static const struct {
+    int id;
+    const char* title;
+} k_Apps[] = {
+    { 1, "Desktop" },
+    { 2, "Steam Big Picture" },
+    { 3, "Emulated Game" },
+};
+
+#define THROW_BAD_ALLOC_IF_NULL(x) \
+    if ((x) == nullptr) throw std::bad_alloc()
+
+HostCredentials HostCredentials::generate()
+{
+    HostCredentials credentials;
+
+    X509* cert = X509_new();
+    THROW_BAD_ALLOC_IF_NULL(cert);
+
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    THROW_BAD_ALLOC_IF_NULL(ctx);
+
+    EVP_PKEY_keygen_init(ctx);
+    EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048);
+
+    EVP_PKEY* pk = NULL;
+    EVP_PKEY_keygen(ctx, &pk);
+
+    EVP_PKEY_CTX_free(ctx);
+    THROW_BAD_ALLOC_IF_NULL(pk);
+
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 0);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 60 * 60 * 24 * 365); // 1 yr
+    X509_set_pubkey(cert, pk);
+
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<unsigned char *>(const_cast<char*>("Emulated GameStream Host")),
+                               -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+
+    X509_sign(cert, pk, EVP_sha256());
+
+    BIO* bio = BIO_new(BIO_s_mem());
+    THROW_BAD_ALLOC_IF_NULL(bio);
+    PEM_write_bio_PrivateKey(bio, pk, NULL, NULL, 0, NULL, NULL);
+
+    BUF_MEM* mem;
+    BIO_get_mem_ptr(bio, &mem);
+    credentials.pemKey = QByteArray(mem->data, (int)mem->length);
+    BIO_free(bio);
+
+    bio = BIO_new(BIO_s_mem());
+    THROW_BAD_ALLOC_IF_NULL(bio);
+    PEM_write_bio_X509(bio, cert);
+
+    BIO_get_mem_ptr(bio, &mem);
+    credentials.pemCert = QByteArray(mem->data, (int)mem->length);
+    BIO_free(bio);
+
+    X509_free(cert);
+    EVP_PKEY_free(pk);
+
+    credentials.cert = QSslCertificate(credentials.pemCert);
+    credentials.key = QSslKey(credentials.pemKey, QSsl::Rsa);
+
+    return credentials;
+}
+
+HttpsServer::HttpsServer(const HostCredentials& credentials, QObject* parent) :
+    QTcpServer(parent),
+    m_Credentials(credentials)
+{
+
+}
+
+void HttpsServer::incomingConnection(qintptr handle)
+{
+    QSslSocket* socket = new QSslSocket(this);
+    if (!socket->setSocketDescriptor(handle)) {
+        delete socket;
+        return;
+    }
+
+    socket->setLocalCertificate(m_Credentials.cert);
+    socket->setPrivateKey(m_Credentials.key);
+
+    // Clients present self-signed certificates, so ask for one without
+    // validating it. Authorization is done against the paired certificates.
+    socket->setPeerVerifyMode(QSslSocket::QueryPeer);
+
+    connect(socket, QOverload<const QList<QSslError>&>::of(&QSslSocket::sslErrors),
+            socket, QOverload<>::of(&QSslSocket::ignoreSslErrors));
+
+    addPendingConnection(socket);
+    socket->startServerEncryption();
+}
+
+EmulatedHost::EmulatedHost(int index,
+                           const HostCredentials& credentials,
+                           const HostBehavior& behavior,
+                           QObject* parent) :
+    QObject(parent),
+    m_Name(QString("EmulatedHost-%1").arg(index)),
+    m_Uuid(QUuid::createUuid().toString().mid(1, 36)),
+    m_Credentials(credentials),
+    m_Behavior(behavior),
+    m_HttpServer(this),
+    m_HttpsServer(credentials, this),
+    m_RandomEngine(std::random_device()()),
+    m_CurrentGame(0)
+{
+    connect(&m_HttpServer, &QTcpServer::newConnection,
+            this, &EmulatedHost::handleNewConnection);
+    connect(&m_HttpsServer, &QTcpServer::newConnection,
+            this, &EmulatedHost::handleNewConnection);
+}
+
+bool EmulatedHost::listen(const QHostAddress& address, quint16 httpPort, quint16 httpsPort)
+{
+    if (!m_HttpServer.listen(address, httpPort)) {
+        qWarning() << m_Name << "failed to listen on HTTP port" << httpPort << m_HttpServer.errorString();
+        return false;
+    }
+
+    if (!m_HttpsServer.listen(address, httpsPort)) {
+        qWarning() << m_Name << "failed to listen on HTTPS port" << httpsPort << m_HttpsServer.errorString();
+        m_HttpServer.close();
+        return false;
+    }
+
+    return true;
+}
+
+quint16 EmulatedHost::httpPort() const
+{
+    return m_HttpServer.serverPort();
+}
+
+quint16 EmulatedHost::httpsPort() const
+{
+    return m_HttpsServer.serverPort();
+}
+
+QString EmulatedHost::name() const
+{
+    return m_Name;
+}
+
+QString EmulatedHost::uuid() const
+{
+    return m_Uuid;
+}
+
+int EmulatedHost::currentGame() const
+{
+    return m_CurrentGame;
+}
+
+int EmulatedHost::pairedClientCount() const
+{
+    return m_PairedCerts.count();
+}
+
+QHash<QString, int> EmulatedHost::requestCounts() const
+{
+    return m_RequestCounts;
+}
+
+void EmulatedHost::handleNewConnection()
+{
+    QTcpServer* server = static_cast<QTcpServer*>(sender());
+    bool https = server == &m_HttpsServer;
+
+    while (server->hasPendingConnections()) {
+        QTcpSocket* socket = server->nextPendingConnection();
+
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket, https]() {
+            readRequest(socket, https);
+        });
+    }
+}
+
+void EmulatedHost::readRequest(QTcpSocket* socket, bool https)
+{
+    // Consume the request line and headers. We only need the request line
+    // since every GameStream request is a GET with its arguments in the query.
+    while (socket->canReadLine()) {
+        QByteArray line = socket->readLine();
+
+        if (!socket->property("requestLine").isValid()) {
+            socket->setProperty("requestLine", line.trimmed());
+        }
+        else if (line.trimmed().isEmpty()) {
+            disconnect(socket, &QTcpSocket::readyRead, this, nullptr);
+
+            QList<QByteArray> parts = socket->property("requestLine").toByteArray().split(' ');
+            if (parts.count() < 2 || parts.at(0) != "GET") {
+                socket->disconnectFromHost();
+                return;
+            }
+
+            QUrl url = QUrl::fromEncoded(parts.at(1));
+
+            int delayMs = m_Behavior.latencyMs;
+            if (m_Behavior.jitterMs > 0) {
+                std::uniform_int_distribution<int> dist(0, m_Behavior.jitterMs);
+                delayMs += dist(m_RandomEngine);
+            }
+
+            if (delayMs > 0) {
+                QTimer::singleShot(delayMs, socket, [this, socket, https, url]() {
+                    sendResponse(socket, https, url);
+                });
+            }
+            else {
+                sendResponse(socket, https, url);
+            }
+            return;
+        }
+    }
+}
+
+void EmulatedHost::sendResponse(QTcpSocket* socket, bool https, QUrl url)
+{
+    QString command = url.path().mid(1);
+    QUrlQuery query(url);
+    QByteArray contentType = "application/xml";
+    QByteArray body;
+
+    m_RequestCounts[command]++;
+
+    // Look for an injected error for this command
+    auto error = m_Behavior.errors.constFind(command);
+    if (error == m_Behavior.errors.constEnd()) {
+        error = m_Behavior.errors.constFind("*");
+    }
+
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    if (error != m_Behavior.errors.constEnd() && dist(m_RandomEngine) < error->rate) {
+        body = statusXml(error->statusCode, "Injected error");
+    }
+    else {
+        body = handleCommand(command, query, https, isPairedClient(socket, https), contentType);
+    }
+
+    QByteArray response;
+    if (body.isNull()) {
+        response = "HTTP/1.1 404 Not Found\r\n"
+                   "Content-Length: 0\r\n"
+                   "Connection: close\r\n"
+                   "\r\n";
+    }
+    else {
+        response = "HTTP/1.1 200 OK\r\n"
+                   "Content-Type: " + contentType + "\r\n"
+                   "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                   "Connection: close\r\n"
+                   "\r\n" + body;
+    }
+
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+QByteArray EmulatedHost::handleCommand(const QString& command,
+                                       const QUrlQuery& query,
+                                       bool https,
+                                       bool paired,
+                                       QByteArray& contentType)
+{
+    if (command == "serverinfo") {
+        // GFE rejects HTTPS requests from clients it hasn't paired with
+        if (https && !paired) {
+            return statusXml(401, "The client is not authorized. Certificate verification failed.");
+        }
+
+        return serverInfoXml(paired);
+    }
+    else if (command == "pair") {
+        return handlePair(query, https, paired);
+    }
+    else if (command == "unpair") {
+        resetPairingSession();
+        return statusXml(200, "OK");
+    }
+
+    // Everything else requires a paired client over HTTPS
+    if (!https || !paired) {
+        return statusXml(401, "The client is not authorized. Certificate verification failed.");
+    }
+
+    if (command == "applist") {
+        QString apps;
+        for (const auto& app : k_Apps) {
+            apps += QString("<App><IsHdrSupported>0</IsHdrSupported>"
+                            "<AppTitle>%1</AppTitle><ID>%2</ID></App>")
+                    .arg(app.title).arg(app.id);
+        }
+        return statusXml(200, "OK", apps);
+    }
+    else if (command == "appasset") {
+        contentType = "image/png";
+        return QByteArray(k_BoxArtPng, sizeof(k_BoxArtPng) - 1);
+    }
+    else if (command == "launch") {
+        int appId = query.queryItemValue("appid").toInt();
+        if (m_CurrentGame != 0 && m_CurrentGame != appId) {
+            return statusXml(400, "An app is already running");
+        }
+
+        m_CurrentGame = appId;
+        return statusXml(200, "OK",
+                         "<gamesession>1</gamesession>"
+                         "<sessionUrl0>" RTSP_SESSION_URL "</sessionUrl0>");
+    }
+    else if (command == "resume") {
+        if (m_CurrentGame == 0) {
+            return statusXml(503, "No app is running");
+        }
+
+        return statusXml(200, "OK",
+                         "<resume>1</resume>"
+                         "<sessionUrl0>" RTSP_SESSION_URL "</sessionUrl0>");
+    }
+    else if (command == "cancel") {
+        m_CurrentGame = 0;
+        return statusXml(200, "OK", "<cancel>1</cancel>");
+    }
+
+    return QByteArray();
+}
+
+QByteArray EmulatedHost::handlePair(const QUrlQuery& query, bool https, bool paired)
+{
+    QString phrase = query.queryItemValue("phrase");
+
+    if (phrase == "getservercert") {
+        QString pin = m_Behavior.pin;
+        if (pin.isEmpty()) {
+            // Block like a real host waiting for the user to type the PIN
+            QTextStream out(stdout);
+            out << "Enter the PIN shown by the client for " << m_Name << ": ";
+            out.flush();
+            pin = QTextStream(stdin).readLine().trimmed();
+        }
+
+        QByteArray salt = QByteArray::fromHex(query.queryItemValue("salt").toLatin1());
+        resetPairingSession();
+        m_Pairing.clientCert = QByteArray::fromHex(query.queryItemValue("clientcert").toLatin1());
+        m_Pairing.aesKey = QCryptographicHash::hash(salt + pin.toLatin1(), QCryptographicHash::Sha256);
+        m_Pairing.aesKey.truncate(16);
+
+        return statusXml(200, "OK",
+                         "<paired>1</paired><plaincert>" + QString::fromLatin1(m_Credentials.pemCert.toHex()) + "</plaincert>");
+    }
+    else if (phrase == "pairchallenge") {
+        return statusXml(200, "OK", QString("<paired>%1</paired>").arg(https && paired ? 1 : 0));
+    }
+
+    // The remaining stages require a pairing attempt in progress
+    if (m_Pairing.aesKey.isEmpty()) {
+        return statusXml(200, "OK", "<paired>0</paired>");
+    }
+
+    if (query.hasQueryItem("clientchallenge")) {
+        QByteArray challenge = aesEcb(QByteArray::fromHex(query.queryItemValue("clientchallenge").toLatin1()),
+                                      m_Pairing.aesKey, false);
+
+        m_Pairing.serverSecret.resize(16);
+        RAND_bytes(reinterpret_cast<unsigned char*>(m_Pairing.serverSecret.data()), 16);
+        m_Pairing.serverChallenge.resize(16);
+        RAND_bytes(reinterpret_cast<unsigned char*>(m_Pairing.serverChallenge.data()), 16);
+
+        QByteArray response = QCryptographicHash::hash(challenge +
+                                                       getSignatureFromPemCert(m_Credentials.pemCert) +
+                                                       m_Pairing.serverSecret,
+                                                       QCryptographicHash::Sha256);
+        response += m_Pairing.serverChallenge;
+
+        return statusXml(200, "OK",
+                         "<paired>1</paired><challengeresponse>" +
+                         QString::fromLatin1(aesEcb(response, m_Pairing.aesKey, true).toHex()) +
+                         "</challengeresponse>");
+    }
+    else if (query.hasQueryItem("serverchallengeresp")) {
+        m_Pairing.clientHash = aesEcb(QByteArray::fromHex(query.queryItemValue("serverchallengeresp").toLatin1()),
+                                      m_Pairing.aesKey, false);
+
+        QByteArray pairingSecret = m_Pairing.serverSecret +
+                signMessage(m_Pairing.serverSecret, m_Credentials.pemKey);
+
+        return statusXml(200, "OK",
+                         "<paired>1</paired><pairingsecret>" + QString::fromLatin1(pairingSecret.toHex()) + "</pairingsecret>");
+    }
+    else if (query.hasQueryItem("clientpairingsecret")) {
+        QByteArray pairingSecret = QByteArray::fromHex(query.queryItemValue("clientpairingsecret").toLatin1());
+        QByteArray clientSecret = pairingSecret.left(16);
+        QByteArray clientSignature = pairingSecret.mid(16);
+
+        // A wrong PIN makes the client's hash mismatch since it was
+        // decrypted with a different AES key
+        QByteArray expectedHash = QCryptographicHash::hash(m_Pairing.serverChallenge +
+                                                           getSignatureFromPemCert(m_Pairing.clientCert) +
+                                                           clientSecret,
+                                                           QCryptographicHash::Sha256);
+        bool success = expectedHash == m_Pairing.clientHash &&
+                verifySignature(clientSecret, clientSignature, m_Pairing.clientCert);
+        if (success) {
+            m_PairedCerts.append(QSslCertificate(m_Pairing.clientCert));
+        }
+
+        resetPairingSession();
+        return statusXml(200, "OK", QString("<paired>%1</paired>").arg(success ? 1 : 0));
+    }
+
+    return statusXml(200, "OK", "<paired>0</paired>");
+}
+
+QByteArray EmulatedHost::serverInfoXml(bool paired)
+{
+    QString body;
+
+    body += "<hostname>" + m_Name + "</hostname>";
+    body += "<appversion>" APP_VERSION "</appversion>";
+    body += "<GfeVersion>" GFE_VERSION "</GfeVersion>";
+    body += "<uniqueid>" + m_Uuid + "</uniqueid>";
+    body += QString("<HttpsPort>%1</HttpsPort>").arg(httpsPort());
+    body += QString("<ExternalPort>%1</ExternalPort>").arg(httpPort());
+    body += "<mac>00:00:00:00:00:00</mac>";
+    body += "<LocalIP>127.0.0.1</LocalIP>";
+    body += "<ServerCodecModeSupport>259</ServerCodecModeSupport>";
+    body += "<MaxLumaPixelsHEVC>1869449984</MaxLumaPixelsHEVC>";
+    body += "<gputype>Emulated GPU</gputype>";
+    body += QString("<PairStatus>%1</PairStatus>").arg(paired ? 1 : 0);
+    body += QString("<currentgame>%1</currentgame>").arg(m_CurrentGame);
+    body += QString("<state>%1</state>").arg(m_CurrentGame != 0 ? STATE_BUSY : STATE_FREE);
+    body += "<SupportedDisplayMode>"
+            "<DisplayMode><Width>1920</Width><Height>1080</Height><RefreshRate>60</RefreshRate></DisplayMode>"
+            "<DisplayMode><Width>3840</Width><Height>2160</Height><RefreshRate>60</RefreshRate></DisplayMode>"
+            "</SupportedDisplayMode>";
+
+    return statusXml(200, "OK", body);
+}
+
+bool EmulatedHost::isPairedClient(QTcpSocket* socket, bool https)
+{
+    if (!https) {
+        return false;
+    }
+
+    QSslCertificate peerCert = static_cast<QSslSocket*>(socket)->peerCertificate();
+    return !peerCert.isNull() && m_PairedCerts.contains(peerCert);
+}
+
+void EmulatedHost::resetPairingSession()
+{
+    m_Pairing.clientCert.clear();
+    m_Pairing.aesKey.clear();
+    m_Pairing.serverSecret.clear();
+    m_Pairing.serverChallenge.clear();
+    m_Pairing.clientHash.clear();
+}
+
+QByteArray EmulatedHost::statusXml(int statusCode, QString statusMessage, QString body)
+{
+    return QString("<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                   "<root status_code=\"%1\" status_message=\"%2\">%3</root>")
+            .arg(statusCode).arg(statusMessage, body).toUtf8();
+}
+
+QByteArray EmulatedHost::aesEcb(const QByteArray& data, const QByteArray& key, bool encrypt)
+{
+    QByteArray output(data.size(), 0);
+    int outputLen;
+
+    EVP_CIPHER_CTX* cipher = EVP_CIPHER_CTX_new();
+    THROW_BAD_ALLOC_IF_NULL(cipher);
+
+    EVP_CipherInit(cipher, EVP_aes_128_ecb(), reinterpret_cast<const unsigned char*>(key.data()), NULL, encrypt ? 1 : 0);
+    EVP_CIPHER_CTX_set_padding(cipher, 0);
+
+    EVP_CipherUpdate(cipher,
+                     reinterpret_cast<unsigned char*>(output.data()),
+                     &outputLen,
+                     reinterpret_cast<const unsigned char*>(data.data()),
+                     data.length());
+    Q_ASSERT(outputLen == output.length());
+
+    EVP_CIPHER_CTX_free(cipher);
+
+    return output;
+}
+
+QByteArray EmulatedHost::getSignatureFromPemCert(const QByteArray& certificate)
+{
+    BIO* bio = BIO_new_mem_buf(certificate.data(), -1);
+    THROW_BAD_ALLOC_IF_NULL(bio);
+
+    X509* cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr);
+    BIO_free_all(bio);
+    if (cert == nullptr) {
+        return QByteArray();
+    }
+
+    const ASN1_BIT_STRING *asnSignature;
+    X509_get0_signature(&asnSignature, NULL, cert);
+
+    QByteArray signature(reinterpret_cast<const char*>(asnSignature->data), asnSignature->length);
+
+    X509_free(cert);
+
+    return signature;
+}
+
+QByteArray EmulatedHost::signMessage(const QByteArray& message, const QByteArray& pemKey)
+{
+    BIO* bio = BIO_new_mem_buf(pemKey.data(), -1);
+    THROW_BAD_ALLOC_IF_NULL(bio);
+
+    EVP_PKEY* pk = PEM_read_bio_PrivateKey(bio, nullptr, nullptr, nullptr);
+    BIO_free_all(bio);
+    THROW_BAD_ALLOC_IF_NULL(pk);
+
+    EVP_MD_CTX* ctx = EVP_MD_CTX_create();
+    THROW_BAD_ALLOC_IF_NULL(ctx);
+
+    EVP_DigestSignInit(ctx, NULL, EVP_sha256(), NULL, pk);
+    EVP_DigestSignUpdate(ctx, message.data(), message.length());
+
+    size_t signatureLength = 0;
+    EVP_DigestSignFinal(ctx, NULL, &signatureLength);
+
+    QByteArray signature((int)signatureLength, 0);
+    EVP_DigestSignFinal(ctx, reinterpret_cast<unsigned char*>(signature.data()), &signatureLength);
+
+    EVP_MD_CTX_destroy(ctx);
+    EVP_PKEY_free(pk);
+
+    return signature;
+}
+
+bool EmulatedHost::verifySignature(const QByteArray& data, const QByteArray& signature, const QByteArray& pemCert)
+{
+    BIO* bio = BIO_new_mem_buf(pemCert.data(), -1);
+    THROW_BAD_ALLOC_IF_NULL(bio);
+
+    X509* cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr);
+    BIO_free_all(bio);
+    if (cert == nullptr) {
+        return false;
+    }
+
+    EVP_PKEY* pubKey = X509_get_pubkey(cert);
+    THROW_BAD_ALLOC_IF_NULL(pubKey);
+
+    EVP_MD_CTX* mdctx = EVP_MD_CTX_create();
+    THROW_BAD_ALLOC_IF_NULL(mdctx);
+
+    EVP_DigestVerifyInit(mdctx, nullptr, EVP_sha256(), nullptr, pubKey);
+    EVP_DigestVerifyUpdate(mdctx, data.data(), data.length());
+    int result = EVP_DigestVerifyFinal(mdctx,
+                                       reinterpret_cast<const unsigned char*>(signature.data()),
+                                       signature.length());
+
+    EVP_PKEY_free(pubKey);
+    EVP_MD_CTX_destroy(mdctx);
+    X509_free(cert);
+
+    return result > 0;
+}
+
+HostEmulator::HostEmulator(const HostBehavior& behavior, QObject* parent) :
+    QObject(parent),
+    m_Credentials(HostCredentials::generate()),
+    m_Behavior(behavior)
+{
+
+}
+
+bool HostEmulator::start(int hostCount, const QHostAddress& address, quint16 basePort)
+{
+    for (int i = 0; i < hostCount; i++) {
+        EmulatedHost* host = new EmulatedHost(i, m_Credentials, m_Behavior, this);
+        quint16 httpPort = basePort != 0 ? basePort + 2 * i : 0;
+        quint16 httpsPort = basePort != 0 ? basePort + 2 * i + 1 : 0;
+
+        if (!host->listen(address, httpPort, httpsPort)) {
+            delete host;
+            return false;
+        }
+
+        m_Hosts.append(host);
+    }
+
+    return true;
+}
+
+const QList<EmulatedHost*>& HostEmulator::hosts() const
+{
+    return m_Hosts;
+}
+
+const HostCredentials& HostEmulator::credentials() const
+{
+    return m_Credentials;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QUrlQuery>
+#include <QSslCertificate>
+#include <QSslKey>
+#include <QTcpServer>
+#include <QHostAddress>
+
+#include <random>
+
+class QTcpSocket;
+class QSslSocket;
+
+// Scriptable behavior applied to every request an emulated host answers
+struct HostBehavior
+{
+    struct Error
+    {
+        // GameStream status code returned in the XML root element
+        int statusCode;
+
+        // Fraction of requests that fail (0.0 - 1.0)
+        double rate;
+    };
+
+    HostBehavior() :
+        latencyMs(0),
+        jitterMs(0)
+    {
+
+    }
+
+    // Fixed delay before each response is sent
+    int latencyMs;
+
+    // Random extra delay (0 - jitterMs) added to each response
+    int jitterMs;
+
+    // Injected failures keyed by command name (like "launch"). The
+    // key "*" applies to every command without its own entry.
+    QHash<QString, Error> errors;
+
+    // PIN entered on the host when a client pairs. If this is empty,
+    // the PIN is read from stdin like a user typing it on a real host.
+    QString pin;
+};
+
+// Server identity shared by all emulated hosts. Generating a 2048-bit
+// RSA key per host would make starting hundreds of hosts very slow.
+struct HostCredentials
+{
+    static HostCredentials generate();
+
+    QByteArray pemCert;
+    QByteArray pemKey;
+    QSslCertificate cert;
+    QSslKey key;
+};
+
+class HttpsServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    HttpsServer(const HostCredentials& credentials, QObject* parent = nullptr);
+
+protected:
+    void incomingConnection(qintptr handle) override;
+
+private:
+    const HostCredentials& m_Credentials;
+};
+
+// A single GameStream host answering the HTTP and HTTPS endpoints
+// used by NvHTTP and NvPairingManager
+class EmulatedHost : public QObject
+{
+    Q_OBJECT
+
+public:
+    EmulatedHost(int index,
+                 const HostCredentials& credentials,
+                 const HostBehavior& behavior,
+                 QObject* parent = nullptr);
+
+    // Ports of 0 pick free ports
+    bool listen(const QHostAddress& address, quint16 httpPort, quint16 httpsPort);
+
+    quint16 httpPort() const;
+    quint16 httpsPort() const;
+
+    QString name() const;
+    QString uuid() const;
+
+    int currentGame() const;
+    int pairedClientCount() const;
+
+    // Number of requests answered per command since the host started
+    QHash<QString, int> requestCounts() const;
+
+private slots:
+    void handleNewConnection();
+
+private:
+    void readRequest(QTcpSocket* socket, bool https);
+
+    void sendResponse(QTcpSocket* socket, bool https, QUrl url);
+
+    QByteArray handleCommand(const QString& command,
+                             const QUrlQuery& query,
+                             bool https,
+                             bool paired,
+                             QByteArray& contentType);
+
+    QByteArray handlePair(const QUrlQuery& query, bool https, bool paired);
+
+    QByteArray serverInfoXml(bool paired);
+
+    bool isPairedClient(QTcpSocket* socket, bool https);
+
+    void resetPairingSession();
+
+    static QByteArray statusXml(int statusCode, QString statusMessage, QString body = QString());
+
+    static QByteArray aesEcb(const QByteArray& data, const QByteArray& key, bool encrypt);
+    static QByteArray getSignatureFromPemCert(const QByteArray& certificate);
+    static QByteArray signMessage(const QByteArray& message, const QByteArray& pemKey);
+    static bool verifySignature(const QByteArray& data, const QByteArray& signature, const QByteArray& pemCert);
+
+    QString m_Name;
+    QString m_Uuid;
+    const HostCredentials& m_Credentials;
+    HostBehavior m_Behavior;
+    QTcpServer m_HttpServer;
+    HttpsServer m_HttpsServer;
+    QHash<QString, int> m_RequestCounts;
+    std::mt19937 m_RandomEngine;
+    int m_CurrentGame;
+    QList<QSslCertificate> m_PairedCerts;
+
+    // State of an in-progress pairing attempt
+    struct {
+        QByteArray clientCert;
+        QByteArray aesKey;
+        QByteArray serverSecret;
+        QByteArray serverChallenge;
+        QByteArray clientHash;
+    } m_Pairing;
+};
+
+// A set of emulated hosts on consecutive port pairs
+class HostEmulator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HostEmulator(const HostBehavior& behavior, QObject* parent = nullptr);
+
+    // Host i listens for HTTP on basePort + 2i and HTTPS on basePort + 2i + 1.
+    // A basePort of 0 picks free ports for every host.
+    bool start(int hostCount, const QHostAddress& address, quint16 basePort);
+
+    const QList<EmulatedHost*>& hosts() const;
+
+    const HostCredentials& credentials() const;
+
+private:
+    HostCredentials m_Credentials;
+    HostBehavior m_Behavior;
+    QList<EmulatedHost*> m_Hosts;
+};
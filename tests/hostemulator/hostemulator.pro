@@ -0,0 +1,17 @@
+# Loopback GameStream host emulator for load testing the client.
+# This is a tool rather than a test case, so make check doesn't run it.
+TARGET = hostemulator
+CONFIG += test_openssl
+
+include(../tests.pri)
+
+QT -= testlib
+QT += network
+CONFIG -= testcase
+
+SOURCES += \
+    main.cpp \
+    emulatedhost.cpp
+
+HEADERS += \
+    emulatedhost.h
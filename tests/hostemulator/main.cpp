@@ -0,0 +1,136 @@
+#include "emulatedhost.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QTimer>
+
+// Parses "command=status" or "command=status@rate", like "launch=503@0.25"
+static bool parseError(const QString& spec, HostBehavior& behavior)
+{
+    QStringList parts = spec.split('=');
+    if (parts.count() != 2 || parts.at(0).isEmpty()) {
+        return false;
+    }
+
+    QStringList statusAndRate = parts.at(1).split('@');
+    bool ok;
+
+    HostBehavior::Error error;
+    error.statusCode = statusAndRate.at(0).toInt(&ok);
+    if (!ok) {
+        return false;
+    }
+
+    error.rate = 1.0;
+    if (statusAndRate.count() > 1) {
+        error.rate = statusAndRate.at(1).toDouble(&ok);
+        if (!ok || error.rate < 0.0 || error.rate > 1.0) {
+            return false;
+        }
+    }
+
+    behavior.errors.insert(parts.at(0), error);
+    return true;
+}
+
+static void printRequestCounts(const HostEmulator& emulator)
+{
+    QHash<QString, int> totals;
+
+    for (const EmulatedHost* host : emulator.hosts()) {
+        const QHash<QString, int> counts = host->requestCounts();
+        for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+            totals[it.key()] += it.value();
+        }
+    }
+
+    QTextStream out(stdout);
+    out << "Requests answered:\n";
+    for (auto it = totals.constBegin(); it != totals.constEnd(); ++it) {
+        out << "  " << it.key() << ": " << it.value() << "\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("hostemulator");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Emulates GameStream hosts on loopback for load testing Moonlight. "
+                                     "Host i answers HTTP on base-port + 2i and HTTPS on base-port + 2i + 1.");
+    parser.addHelpOption();
+
+    QCommandLineOption hostsOption("hosts", "Number of hosts to emulate.", "count", "1");
+    QCommandLineOption addressOption("address", "Address to listen on.", "address", "127.0.0.1");
+    QCommandLineOption basePortOption("base-port", "HTTP port of the first host.", "port", "47989");
+    QCommandLineOption latencyOption("latency", "Delay before each response.", "ms", "0");
+    QCommandLineOption jitterOption("jitter", "Random extra delay added to each response.", "ms", "0");
+    QCommandLineOption errorOption("error",
+                                   "Fail a command with a GameStream status code, optionally for only a fraction "
+                                   "of requests (like launch=503 or serverinfo=503@0.1). Use * to match every "
+                                   "command. May be repeated.",
+                                   "command=status[@rate]");
+    QCommandLineOption pinOption("pin", "PIN to accept when pairing instead of prompting for it.", "pin");
+    QCommandLineOption durationOption("duration", "Exit after this long instead of running until killed.", "seconds", "0");
+
+    parser.addOption(hostsOption);
+    parser.addOption(addressOption);
+    parser.addOption(basePortOption);
+    parser.addOption(latencyOption);
+    parser.addOption(jitterOption);
+    parser.addOption(errorOption);
+    parser.addOption(pinOption);
+    parser.addOption(durationOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    HostBehavior behavior;
+    behavior.latencyMs = parser.value(latencyOption).toInt();
+    behavior.jitterMs = parser.value(jitterOption).toInt();
+    behavior.pin = parser.value(pinOption);
+
+    for (const QString& spec : parser.values(errorOption)) {
+        if (!parseError(spec, behavior)) {
+            err << "Invalid error specification: " << spec << "\n";
+            return 1;
+        }
+    }
+
+    int hostCount = parser.value(hostsOption).toInt();
+    if (hostCount <= 0) {
+        err << "Host count must be positive\n";
+        return 1;
+    }
+
+    QHostAddress address(parser.value(addressOption));
+    quint16 basePort = parser.value(basePortOption).toUShort();
+    if (address.isNull() || basePort == 0 || basePort + 2 * hostCount - 1 > 65535) {
+        err << "Invalid address or port range\n";
+        return 1;
+    }
+
+    HostEmulator emulator(behavior);
+    if (!emulator.start(hostCount, address, basePort)) {
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    for (const EmulatedHost* host : emulator.hosts()) {
+        // This is the address to add manually in the client
+        out << host->name() << " " << address.toString() << ":" << host->httpPort() << "\n";
+    }
+    out.flush();
+
+    // Scripted runs stop after a fixed duration and print a request summary
+    int durationSecs = parser.value(durationOption).toInt();
+    if (durationSecs > 0) {
+        QTimer::singleShot(durationSecs * 1000, &app, &QCoreApplication::quit);
+    }
+
+    int ret = app.exec();
+    printRequestCounts(emulator);
+    return ret;
+}
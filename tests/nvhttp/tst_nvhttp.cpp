@@ -0,0 +1,284 @@
+#include <QtTest>
+#include <QImage>
+#include <QUdpSocket>
+
+#include <cstring>
+
+#include "emulatedhost.h"
+#include "backend/nvcomputer.h"
+#include "backend/nvpairingmanager.h"
+
+#define TEST_PIN "1234"
+
+// Drives the real NvHTTP and NvPairingManager against emulated hosts
+class TestNvHttp : public QObject
+{
+    Q_OBJECT
+
+private:
+    static NvAddress hostAddress(const EmulatedHost* host)
+    {
+        return NvAddress(QHostAddress(QHostAddress::LocalHost), host->httpPort());
+    }
+
+    static int serverInfoStatus(NvHTTP& http)
+    {
+        try {
+            http.getServerInfo(NvHTTP::NVLL_ERROR);
+            return 200;
+        }
+        catch (const GfeHttpResponseException& e) {
+            return e.getStatusCode();
+        }
+    }
+
+    HostEmulator* m_Emulator = nullptr;
+    QSslCertificate m_ServerCert;
+
+private slots:
+    void initTestCase()
+    {
+        // Keep the client identity out of the real settings
+        QStandardPaths::setTestModeEnabled(true);
+        QCoreApplication::setOrganizationName("Moonlight Game Streaming Project");
+        QCoreApplication::setApplicationName("tst_nvhttp");
+
+        HostBehavior behavior;
+        behavior.pin = TEST_PIN;
+        m_Emulator = new HostEmulator(behavior, this);
+        QVERIFY(m_Emulator->start(1, QHostAddress::LocalHost, 0));
+    }
+
+    void serverInfoOverHttp()
+    {
+        EmulatedHost* host = m_Emulator->hosts().first();
+        NvHTTP http(hostAddress(host), 0, QSslCertificate());
+
+        QString serverInfo = http.getServerInfo(NvHTTP::NVLL_VERBOSE);
+        QCOMPARE(NvHTTP::getXmlString(serverInfo, "uniqueid"), host->uuid());
+        QCOMPARE(NvHTTP::getXmlString(serverInfo, "PairStatus"), QString("0"));
+        QCOMPARE(http.httpsPort(), host->httpsPort());
+
+        NvComputer computer(http, serverInfo);
+        QCOMPARE(computer.name, host->name());
+        QCOMPARE(computer.activeHttpsPort, host->httpsPort());
+        QCOMPARE(computer.pairState, NvComputer::PS_NOT_PAIRED);
+        QCOMPARE(computer.displayModes.count(), 2);
+    }
+
+    void pairWithWrongPin()
+    {
+        EmulatedHost* host = m_Emulator->hosts().first();
+        NvHTTP http(hostAddress(host), 0, QSslCertificate());
+        NvComputer computer(http, http.getServerInfo(NvHTTP::NVLL_VERBOSE));
+
+        NvPairingManager pairingManager(&computer);
+        QSslCertificate serverCert;
+        QCOMPARE(pairingManager.pair(computer.appVersion, "0000", serverCert), NvPairingManager::PIN_WRONG);
+        QCOMPARE(host->pairedClientCount(), 0);
+    }
+
+    void pair()
+    {
+        EmulatedHost* host = m_Emulator->hosts().first();
+        NvHTTP http(hostAddress(host), 0, QSslCertificate());
+        NvComputer computer(http, http.getServerInfo(NvHTTP::NVLL_VERBOSE));
+
+        NvPairingManager pairingManager(&computer);
+        QCOMPARE(pairingManager.pair(computer.appVersion, TEST_PIN, m_ServerCert), NvPairingManager::PAIRED);
+        QVERIFY(!m_ServerCert.isNull());
+        QCOMPARE(host->pairedClientCount(), 1);
+
+        // serverinfo now goes over HTTPS with the pinned certificate
+        NvHTTP pairedHttp(hostAddress(host), host->httpsPort(), m_ServerCert);
+        QString serverInfo = pairedHttp.getServerInfo(NvHTTP::NVLL_VERBOSE);
+        QCOMPARE(NvHTTP::getXmlString(serverInfo, "PairStatus"), QString("1"));
+    }
+
+    void appListAndBoxArt()
+    {
+        EmulatedHost* host = m_Emulator->hosts().first();
+        NvHTTP http(hostAddress(host), host->httpsPort(), m_ServerCert);
+
+        QVector<NvApp> apps = http.getAppList();
+        QCOMPARE(apps.count(), 3);
+        QCOMPARE(apps.first().name, QString("Desktop"));
+        QCOMPARE(apps.first().id, 1);
+
+        QImage boxArt = http.getBoxArt(apps.first().id);
+        QCOMPARE(boxArt.size(), QSize(1, 1));
+    }
+
+    void launchResumeQuit()
+    {
+        EmulatedHost* host = m_Emulator->hosts().first();
+        NvHTTP http(hostAddress(host), host->httpsPort(), m_ServerCert);
+
+        STREAM_CONFIGURATION streamConfig;
+        memset(&streamConfig, 0, sizeof(streamConfig));
+        streamConfig.width = 1920;
+        streamConfig.height = 1080;
+        streamConfig.fps = 60;
+        streamConfig.audioConfiguration = AUDIO_CONFIGURATION_STEREO;
+
+        QString rtspSessionUrl;
+        http.launchApp(3, &streamConfig, false, false, 1, rtspSessionUrl);
+        QVERIFY(rtspSessionUrl.startsWith("rtsp://"));
+        QCOMPARE(host->currentGame(), 3);
+        QCOMPARE(NvHTTP::getCurrentGame(http.getServerInfo(NvHTTP::NVLL_VERBOSE)), 3);
+
+        rtspSessionUrl.clear();
+        http.resumeApp(&streamConfig, rtspSessionUrl);
+        QVERIFY(rtspSessionUrl.startsWith("rtsp://"));
+
+        // Throws if the game is still running afterwards
+        http.quitApp();
+        QCOMPARE(host->currentGame(), 0);
+    }
+
+    void unpairedClientRejected()
+    {
+        // This emulator has never paired with our client certificate
+        HostEmulator emulator((HostBehavior()));
+        QVERIFY(emulator.start(1, QHostAddress::LocalHost, 0));
+        EmulatedHost* host = emulator.hosts().first();
+        NvHTTP http(hostAddress(host), host->httpsPort(), emulator.credentials().cert);
+
+        // HTTPS is refused with 401 so NvHTTP falls back to HTTP
+        QString serverInfo = http.getServerInfo(NvHTTP::NVLL_VERBOSE);
+        QCOMPARE(NvHTTP::getXmlString(serverInfo, "PairStatus"), QString("0"));
+        QCOMPARE(host->requestCounts().value("serverinfo"), 2);
+
+        try {
+            http.getAppList();
+            QFAIL("App list request from an unpaired client succeeded");
+        }
+        catch (const GfeHttpResponseException& e) {
+            QCOMPARE(e.getStatusCode(), 401);
+        }
+    }
+
+    void injectedErrors()
+    {
+        HostBehavior behavior;
+        behavior.errors.insert("serverinfo", { 503, 1.0 });
+        HostEmulator emulator(behavior);
+        QVERIFY(emulator.start(1, QHostAddress::LocalHost, 0));
+
+        NvHTTP http(hostAddress(emulator.hosts().first()), 0, QSslCertificate());
+        QCOMPARE(serverInfoStatus(http), 503);
+
+        // Never failing must leave every request untouched
+        behavior.errors.insert("serverinfo", { 503, 0.0 });
+        HostEmulator passingEmulator(behavior);
+        QVERIFY(passingEmulator.start(1, QHostAddress::LocalHost, 0));
+
+        NvHTTP passingHttp(hostAddress(passingEmulator.hosts().first()), 0, QSslCertificate());
+        QCOMPARE(serverInfoStatus(passingHttp), 200);
+    }
+
+    void injectedLatency()
+    {
+        HostBehavior behavior;
+        behavior.latencyMs = 100;
+        HostEmulator emulator(behavior);
+        QVERIFY(emulator.start(1, QHostAddress::LocalHost, 0));
+
+        NvHTTP http(hostAddress(emulator.hosts().first()), 0, QSslCertificate());
+
+        QElapsedTimer timer;
+        timer.start();
+        http.getServerInfo(NvHTTP::NVLL_VERBOSE);
+        QVERIFY(timer.elapsed() >= behavior.latencyMs);
+    }
+
+    void pathMtuFromUdpStandIn()
+    {
+        EmulatedHost* host = m_Emulator->hosts().first();
+        NvHTTP http(hostAddress(host), 0, QSslCertificate());
+        NvComputer computer(http, http.getServerInfo(NvHTTP::NVLL_VERBOSE));
+
+        // Stand in for the host's video port with a local UDP socket
+        QUdpSocket videoSocket;
+        QVERIFY(videoSocket.bind(QHostAddress::LocalHost, 0));
+        computer.activeAddress = NvAddress(QHostAddress(QHostAddress::LocalHost), videoSocket.localPort());
+
+        int maxUdpPayloadSize = computer.getMaxUdpPayloadSize();
+        if (maxUdpPayloadSize == 0) {
+            QSKIP("Path MTU is unavailable on this platform");
+        }
+
+        // Loopback MTUs are at least the IPv4 minimum, minus IP and UDP headers
+        QVERIFY(maxUdpPayloadSize >= 576 - 20 - 8);
+
+        // The cached value is used while the route stays the same
+        QCOMPARE(computer.getMaxUdpPayloadSize(), maxUdpPayloadSize);
+
+        // Nothing was sent to the stand-in
+        QVERIFY(!videoSocket.hasPendingDatagrams());
+
+        // A large loopback MTU never raises the default packet sizes
+        QCOMPARE(NvComputer::getVideoPacketSizeForPath(1392, maxUdpPayloadSize), 1392);
+        QCOMPARE(NvComputer::getVideoPacketSizeForPath(1024, maxUdpPayloadSize), 1024);
+    }
+
+    void videoPacketSizeForPath_data()
+    {
+        QTest::addColumn<int>("defaultPacketSize");
+        QTest::addColumn<int>("maxUdpPayloadSize");
+        QTest::addColumn<int>("packetSize");
+
+        QTest::newRow("unknown MTU") << 1392 << 0 << 1392;
+        QTest::newRow("1500 MTU") << 1392 << 1472 << 1392;
+        QTest::newRow("jumbo MTU") << 1392 << 8972 << 1392;
+        QTest::newRow("VPN default on 1500 MTU") << 1024 << 1472 << 1024;
+        QTest::newRow("VPN default on jumbo MTU") << 1024 << 8972 << 1024;
+        QTest::newRow("WireGuard MTU") << 1392 << 1392 << 1312;
+        QTest::newRow("small tunnel MTU") << 1024 << 1052 << 972;
+    }
+
+    void videoPacketSizeForPath()
+    {
+        QFETCH(int, defaultPacketSize);
+        QFETCH(int, maxUdpPayloadSize);
+        QFETCH(int, packetSize);
+
+        QCOMPARE(NvComputer::getVideoPacketSizeForPath(defaultPacketSize, maxUdpPayloadSize), packetSize);
+    }
+
+    void pollManyHosts_data()
+    {
+        QTest::addColumn<int>("hostCount");
+
+        // Use the hostemulator tool for larger counts. 500 hosts need 1000
+        // listening sockets, which runs into the default 1024 fd limit.
+        QTest::newRow("1 host") << 1;
+        QTest::newRow("10 hosts") << 10;
+        QTest::newRow("100 hosts") << 100;
+    }
+
+    void pollManyHosts()
+    {
+        QFETCH(int, hostCount);
+
+        HostBehavior behavior;
+        behavior.latencyMs = 1;
+        HostEmulator emulator(behavior);
+        QVERIFY(emulator.start(hostCount, QHostAddress::LocalHost, 0));
+
+        QSet<QString> uuids;
+        QElapsedTimer timer;
+        timer.start();
+
+        for (const EmulatedHost* host : emulator.hosts()) {
+            NvHTTP http(hostAddress(host), 0, QSslCertificate());
+            uuids.insert(NvHTTP::getXmlString(http.getServerInfo(NvHTTP::NVLL_ERROR), "uniqueid"));
+        }
+
+        qInfo() << "Polled" << hostCount << "hosts in" << timer.elapsed() << "ms";
+        QCOMPARE(uuids.count(), hostCount);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestNvHttp)
+#include "tst_nvhttp.moc"
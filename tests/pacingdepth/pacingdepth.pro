@@ -0,0 +1,11 @@
+TARGET = tst_pacingdepth
+CONFIG += test_sdl
+
+include(../tests.pri)
+
+SOURCES += \
+    tst_pacingdepth.cpp \
+    $$PWD/../../app/streaming/video/ffmpeg-renderers/pacer/pacingdepth.cpp
+
+HEADERS += \
+    $$PWD/../../app/streaming/video/ffmpeg-renderers/pacer/pacingdepth.h
@@ -0,0 +1,175 @@
+#include "streaming/video/ffmpeg-renderers/pacer/pacingdepth.h"
+
+#include <QtTest>
+
+#define TEST_FPS 60
+#define TEST_MAX_PACING_DEPTH 4
+
+// Start the fake clock away from 0, like a real performance counter
+#define TEST_START_TIME_US 1000000
+
+class TestPacingDepth : public QObject
+{
+    Q_OBJECT
+
+private:
+    static
+    Uint64 scheduledTimeUs(int frame, double fps = TEST_FPS)
+    {
+        return TEST_START_TIME_US + (Uint64)(frame * 1000000.0 / fps);
+    }
+
+    // Delays every Nth frame by lateUs. Frames arrive in order, so
+    // frames behind a late one arrive with it if they're due earlier.
+    static
+    QVector<Uint64> makeLateArrivals(int frames, int lateEvery, int lateUs)
+    {
+        QVector<Uint64> arrivals;
+        Uint64 lastArrival = 0;
+
+        for (int i = 0; i < frames; i++) {
+            Uint64 arrival = scheduledTimeUs(i);
+            if (i % lateEvery == 0) {
+                arrival += lateUs;
+            }
+
+            lastArrival = qMax(arrival, lastArrival);
+            arrivals.append(lastArrival);
+        }
+
+        return arrivals;
+    }
+
+    static
+    int feed(PacingDepthEstimator& estimator, const QVector<Uint64>& arrivals)
+    {
+        int maxDepth = 0;
+        for (Uint64 arrival : arrivals) {
+            maxDepth = qMax(maxDepth, estimator.addFrameArrival(arrival));
+        }
+        return maxDepth;
+    }
+
+private slots:
+    void steadyArrivals_data()
+    {
+        QTest::addColumn<double>("fps");
+
+        QTest::newRow("60 FPS") << 60.0;
+
+        // A host clock running slightly slow isn't jitter
+        QTest::newRow("59.94 FPS") << 59.94;
+
+        // Neither is a host sending fewer frames than the maximum
+        QTest::newRow("30 FPS") << 30.0;
+    }
+
+    void steadyArrivals()
+    {
+        QFETCH(double, fps);
+        PacingDepthEstimator estimator(TEST_FPS, TEST_MAX_PACING_DEPTH);
+
+        for (int i = 0; i < 5 * TEST_FPS; i++) {
+            QCOMPARE(estimator.addFrameArrival(scheduledTimeUs(i, fps)), 1);
+        }
+        QVERIFY(estimator.getJitterUs() < 100);
+    }
+
+    void constantDelayIsNotJitter()
+    {
+        PacingDepthEstimator estimator(TEST_FPS, TEST_MAX_PACING_DEPTH);
+
+        // Every frame is 30 ms late, so the schedule just starts later
+        for (int i = 0; i < 5 * TEST_FPS; i++) {
+            QCOMPARE(estimator.addFrameArrival(scheduledTimeUs(i) + 30000), 1);
+        }
+    }
+
+    void lateFramesGrowDepth_data()
+    {
+        QTest::addColumn<int>("lateEvery");
+        QTest::addColumn<int>("lateUs");
+        QTest::addColumn<int>("pacingDepth");
+
+        // One frame in 5 or 10 is late, well above the 95th percentile.
+        // Less than half a frame late is covered by V-sync slack.
+        QTest::newRow("5 ms late") << 5 << 5000 << 1;
+        QTest::newRow("20 ms late") << 5 << 20000 << 2;
+        QTest::newRow("35 ms late") << 5 << 35000 << 3;
+        QTest::newRow("100 ms late") << 10 << 100000 << TEST_MAX_PACING_DEPTH;
+    }
+
+    void lateFramesGrowDepth()
+    {
+        QFETCH(int, lateEvery);
+        QFETCH(int, lateUs);
+        QFETCH(int, pacingDepth);
+        PacingDepthEstimator estimator(TEST_FPS, TEST_MAX_PACING_DEPTH);
+
+        feed(estimator, makeLateArrivals(5 * TEST_FPS, lateEvery, lateUs));
+        QCOMPARE(estimator.getPacingDepth(), pacingDepth);
+    }
+
+    void rareLateFramesAreIgnored()
+    {
+        PacingDepthEstimator estimator(TEST_FPS, TEST_MAX_PACING_DEPTH);
+
+        // One late frame per second is below the 95th percentile
+        QCOMPARE(feed(estimator, makeLateArrivals(5 * TEST_FPS, TEST_FPS, 30000)), 1);
+    }
+
+    void depthIsCapped()
+    {
+        PacingDepthEstimator estimator(TEST_FPS, 1);
+
+        QCOMPARE(feed(estimator, makeLateArrivals(5 * TEST_FPS, 5, 35000)), 1);
+    }
+
+    void idleGapsAreIgnored()
+    {
+        PacingDepthEstimator estimator(TEST_FPS, TEST_MAX_PACING_DEPTH);
+        QVector<Uint64> arrivals;
+
+        // Two seconds of nothing between two steady runs, like a host
+        // that stops sending while the screen doesn't change
+        for (int i = 0; i < 2 * TEST_FPS; i++) {
+            arrivals.append(scheduledTimeUs(i));
+        }
+        for (int i = 4 * TEST_FPS; i < 6 * TEST_FPS; i++) {
+            arrivals.append(scheduledTimeUs(i));
+        }
+
+        QCOMPARE(feed(estimator, arrivals), 1);
+    }
+
+    void shrinksAfterJitterStops()
+    {
+        PacingDepthEstimator estimator(TEST_FPS, TEST_MAX_PACING_DEPTH);
+
+        QVector<Uint64> arrivals = makeLateArrivals(2 * TEST_FPS, 5, 35000);
+        feed(estimator, arrivals);
+        QCOMPARE(estimator.getPacingDepth(), 3);
+
+        // Jitter leaves the window after a second, then each step down
+        // waits 2 seconds of low jitter
+        int frame = 2 * TEST_FPS;
+        for (int expectedDepth = 3; expectedDepth > 1; expectedDepth--) {
+            Uint64 stepStartUs = scheduledTimeUs(frame);
+            while (estimator.getPacingDepth() == expectedDepth) {
+                estimator.addFrameArrival(scheduledTimeUs(frame++));
+                QVERIFY(frame < 20 * TEST_FPS);
+            }
+
+            QCOMPARE(estimator.getPacingDepth(), expectedDepth - 1);
+            QVERIFY(scheduledTimeUs(frame) - stepStartUs >= 2000000);
+        }
+
+        // And it stays there
+        for (int i = 0; i < 5 * TEST_FPS; i++) {
+            QCOMPARE(estimator.addFrameArrival(scheduledTimeUs(frame++)), 1);
+        }
+    }
+};
+
+QTEST_APPLESS_MAIN(TestPacingDepth)
+#include "tst_pacingdepth.moc"
@@ -0,0 +1,11 @@
+TARGET = tst_planecopy
+CONFIG += test_sdl
+
+include(../tests.pri)
+
+SOURCES += \
+    tst_planecopy.cpp \
+    $$PWD/../../app/streaming/video/planecopy.cpp
+
+HEADERS += \
+    $$PWD/../../app/streaming/video/planecopy.h
@@ -0,0 +1,152 @@
+#include "streaming/video/planecopy.h"
+
+#include <QtTest>
+
+class TestPlaneCopy : public QObject
+{
+    Q_OBJECT
+
+private:
+    static
+    QByteArray makePlane(int pitch, int rows, int seed)
+    {
+        QByteArray plane(pitch * rows, Qt::Uninitialized);
+        for (int i = 0; i < plane.size(); i++) {
+            plane[i] = (char)(i * 31 + seed);
+        }
+        return plane;
+    }
+
+    static
+    void addImplementationRows()
+    {
+        for (const PlaneCopy::Implementation& impl : PlaneCopy::getSupportedImplementations()) {
+            QTest::newRow(impl.name) << QByteArray(impl.name);
+        }
+    }
+
+    static
+    PlaneCopy::CopyRowsFn findImplementation(const QByteArray& name)
+    {
+        for (const PlaneCopy::Implementation& impl : PlaneCopy::getSupportedImplementations()) {
+            if (name == impl.name) {
+                return impl.copyRows;
+            }
+        }
+        return nullptr;
+    }
+
+private slots:
+    void memcpyIsAlwaysSupported()
+    {
+        QVector<PlaneCopy::Implementation> impls = PlaneCopy::getSupportedImplementations();
+        QVERIFY(!impls.isEmpty());
+        QCOMPARE(QByteArray(impls.first().name), QByteArray("memcpy"));
+    }
+
+    void copyRowsConvertsPitch_data()
+    {
+        QTest::addColumn<QByteArray>("impl");
+        addImplementationRows();
+    }
+
+    void copyRowsConvertsPitch()
+    {
+        QFETCH(QByteArray, impl);
+        PlaneCopy::CopyRowsFn copyRows = findImplementation(impl);
+        QVERIFY(copyRows != nullptr);
+
+        // Odd row sizes and offsets exercise the unaligned head and tail
+        // of each row, and the large case crosses the non-temporal threshold.
+        const int rowSizes[] = { 1, 17, 63, 64, 129, 1921, 3840 };
+        const int rowCounts[] = { 1, 3, 600 };
+        for (int rowBytes : rowSizes) {
+            for (int rows : rowCounts) {
+                int srcPitch = rowBytes + 13;
+                int dstPitch = rowBytes + 32;
+                QByteArray src = makePlane(srcPitch, rows, rowBytes);
+                QByteArray dst(dstPitch * rows + 1, (char)0xAA);
+
+                copyRows((Uint8*)dst.data() + 1, dstPitch,
+                         (const Uint8*)src.constData(), srcPitch,
+                         rowBytes, rows);
+
+                for (int y = 0; y < rows; y++) {
+                    const char* dstRow = dst.constData() + 1 + dstPitch * y;
+                    QVERIFY(memcmp(dstRow, src.constData() + srcPitch * y, rowBytes) == 0);
+
+                    // The padding after each row must be left alone
+                    if (y < rows - 1) {
+                        QCOMPARE(dstRow[rowBytes], (char)0xAA);
+                    }
+                }
+                QCOMPARE(dst.at(0), (char)0xAA);
+            }
+        }
+    }
+
+    void copyNV12()
+    {
+        const int width = 33, height = 17;
+        const int srcPitch = 64, dstPitch = 48;
+        QByteArray srcY = makePlane(srcPitch, height, 1);
+        QByteArray srcUV = makePlane(srcPitch, (height + 1) / 2, 2);
+        QByteArray dstY(dstPitch * height, 0);
+        QByteArray dstUV(dstPitch * ((height + 1) / 2), 0);
+
+        PlaneCopy::copyNV12((Uint8*)dstY.data(), dstPitch, (Uint8*)dstUV.data(), dstPitch,
+                            (const Uint8*)srcY.constData(), srcPitch,
+                            (const Uint8*)srcUV.constData(), srcPitch,
+                            width, height, 1);
+
+        for (int y = 0; y < height; y++) {
+            QVERIFY(memcmp(dstY.constData() + dstPitch * y, srcY.constData() + srcPitch * y, width) == 0);
+        }
+
+        // Interleaved chroma rows are rounded up to whole sample pairs
+        for (int y = 0; y < (height + 1) / 2; y++) {
+            QVERIFY(memcmp(dstUV.constData() + dstPitch * y, srcUV.constData() + srcPitch * y, width + 1) == 0);
+        }
+    }
+
+    // Compare each kernel against memcpy with the plane sizes we upload.
+    // Run with -median N for stable numbers.
+    void benchmarkCopyRows_data()
+    {
+        QTest::addColumn<QByteArray>("impl");
+        QTest::addColumn<int>("rowBytes");
+        QTest::addColumn<int>("rows");
+
+        for (const PlaneCopy::Implementation& impl : PlaneCopy::getSupportedImplementations()) {
+            QTest::newRow(QByteArray(impl.name) + " 1080p luma") << QByteArray(impl.name) << 1920 << 1080;
+            QTest::newRow(QByteArray(impl.name) + " 1080p chroma") << QByteArray(impl.name) << 1920 << 540;
+            QTest::newRow(QByteArray(impl.name) + " 4K luma") << QByteArray(impl.name) << 3840 << 2160;
+        }
+    }
+
+    void benchmarkCopyRows()
+    {
+        QFETCH(QByteArray, impl);
+        QFETCH(int, rowBytes);
+        QFETCH(int, rows);
+
+        PlaneCopy::CopyRowsFn copyRows = findImplementation(impl);
+        QVERIFY(copyRows != nullptr);
+
+        // Pitches are padded like decoder output and texture memory
+        int srcPitch = rowBytes + 64;
+        int dstPitch = rowBytes + 256;
+        QByteArray src = makePlane(srcPitch, rows, 0);
+        QByteArray dst(dstPitch * rows, 0);
+
+        QBENCHMARK {
+            copyRows((Uint8*)dst.data(), dstPitch,
+                     (const Uint8*)src.constData(), srcPitch,
+                     rowBytes, rows);
+        }
+    }
+};
+
+QTEST_APPLESS_MAIN(TestPlaneCopy)
+
+#include "tst_planecopy.moc"
@@ -0,0 +1,10 @@
+TARGET = tst_rfitracker
+
+include(../tests.pri)
+
+SOURCES += \
+    tst_rfitracker.cpp \
+    $$PWD/../../app/streaming/video/rfitracker.cpp
+
+HEADERS += \
+    $$PWD/../../app/streaming/video/rfitracker.h
@@ -0,0 +1,169 @@
+#include "streaming/video/rfitracker.h"
+
+#include <QtTest>
+
+enum FrameOutcome
+{
+    // The decoder returned a clean frame
+    DECODED,
+
+    // The decoder returned a frame with decode errors or marked corrupt
+    CORRUPT,
+
+    // avcodec_send_packet() failed
+    SEND_FAILED,
+
+    // The decoder held on to the frame and returned nothing yet
+    NO_OUTPUT,
+
+    // The output thread decoded the frame
+    OUTPUT_THREAD
+};
+
+struct TraceFrame
+{
+    int frameNumber;
+    bool idrFrame;
+    FrameOutcome outcome;
+};
+
+// Frames of a 60 FPS stream that lost packets. Frame numbers that are
+// missing never arrived. Each loss is followed by the frame the host
+// encoded around it, except where it sent an IDR frame instead.
+static const TraceFrame k_LossyStream[] = {
+    { 1, true, DECODED },
+    { 2, false, DECODED },
+    { 3, false, DECODED },
+    { 4, false, DECODED },
+
+    // Frames 5-6 lost, and the host encoded around them
+    { 7, false, DECODED },
+    { 8, false, DECODED },
+
+    // Frame 9 lost, but the decoder couldn't use its remaining references.
+    // The host keeps sending P-frames until our IDR request arrives.
+    { 10, false, CORRUPT },
+    { 11, false, DECODED },
+    { 12, true, DECODED },
+    { 13, false, DECODED },
+
+    // Frames 14-16 lost, and the decoder rejected the next frame
+    { 17, false, SEND_FAILED },
+    { 18, true, DECODED },
+
+    // Frames 19-20 lost, and the host sent an IDR frame instead
+    { 21, true, DECODED },
+    { 22, false, DECODED },
+
+    // Frame 23 lost, and the decoder delayed the next frame until after
+    // the IDR frame arrived, so we never got to check it
+    { 24, false, NO_OUTPUT },
+    { 25, true, DECODED },
+
+    // Frame 26 lost while the output thread was decoding
+    { 27, false, OUTPUT_THREAD },
+    { 28, false, DECODED },
+
+    // Frames 29-30 lost, and the host encoded around them
+    { 31, false, DECODED },
+    { 32, false, DECODED },
+};
+
+class TestRfiTracker : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Replays the trace like FFmpegVideoDecoder::submitDecodeUnit() and
+    // returns how many IDR frames we requested because RFI failed
+    static
+    int replay(RfiTracker& tracker)
+    {
+        int idrRequests = 0;
+
+        for (const TraceFrame& frame : k_LossyStream) {
+            tracker.addFrame(frame.frameNumber, frame.idrFrame);
+
+            switch (frame.outcome) {
+            case DECODED:
+                if (tracker.frameDecoded(false)) {
+                    idrRequests++;
+                }
+                break;
+            case CORRUPT:
+                if (tracker.frameDecoded(true)) {
+                    idrRequests++;
+                }
+                break;
+            case SEND_FAILED:
+                // A failed send always requests an IDR frame
+                tracker.decodeFailed();
+                break;
+            case NO_OUTPUT:
+                break;
+            case OUTPUT_THREAD:
+                tracker.skipCheck();
+                break;
+            }
+        }
+
+        return idrRequests;
+    }
+
+private slots:
+    void lossyStream()
+    {
+        RfiTracker tracker;
+        tracker.setActive(true);
+
+        QCOMPARE(replay(tracker), 1);
+
+        // Losses before frames 7, 10, 17, 24, 27 and 31 were encoded around.
+        // The loss before frame 21 was answered with an IDR frame instead.
+        QCOMPARE(tracker.getInvalidations(), 6);
+
+        // Frames 7 and 31 decoded cleanly
+        QCOMPARE(tracker.getRecoveries(), 2);
+
+        // Frame 10 was corrupt, frame 17 failed to send, and frame 24 was
+        // overtaken by an IDR frame. Frame 27 wasn't checked at all.
+        QCOMPARE(tracker.getFallbacks(), 3);
+    }
+
+    void inactiveTrackerIgnoresLosses()
+    {
+        RfiTracker tracker;
+
+        QCOMPARE(replay(tracker), 0);
+        QCOMPARE(tracker.getInvalidations(), 0);
+        QCOMPARE(tracker.getRecoveries(), 0);
+        QCOMPARE(tracker.getFallbacks(), 0);
+    }
+
+    void firstFrameIsNotALoss()
+    {
+        RfiTracker tracker;
+        tracker.setActive(true);
+
+        // Streams don't start at frame 1 after a reset
+        QVERIFY(!tracker.addFrame(100, false));
+        QVERIFY(tracker.addFrame(102, false));
+    }
+
+    void resetStartsANewStream()
+    {
+        RfiTracker tracker;
+        tracker.setActive(true);
+
+        replay(tracker);
+        tracker.reset();
+
+        QVERIFY(tracker.isActive());
+        QCOMPARE(tracker.getInvalidations(), 0);
+        QVERIFY(!tracker.addFrame(1, true));
+        QVERIFY(!tracker.frameDecoded(true));
+    }
+};
+
+QTEST_APPLESS_MAIN(TestRfiTracker)
+#include "tst_rfitracker.moc"
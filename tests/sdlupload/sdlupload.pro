@@ -0,0 +1,11 @@
+TARGET = tst_sdlupload
+CONFIG += test_sdl
+
+include(../tests.pri)
+
+SOURCES += \
+    tst_sdlupload.cpp \
+    $$PWD/../../app/streaming/video/planecopy.cpp
+
+HEADERS += \
+    $$PWD/../../app/streaming/video/planecopy.h
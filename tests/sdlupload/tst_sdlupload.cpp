@@ -0,0 +1,208 @@
+#include "streaming/video/planecopy.h"
+
+#include <QtTest>
+
+// The same number of textures SdlRenderer alternates between
+#define MAX_UPLOAD_TEXTURES 2
+
+enum UploadPath
+{
+    // SDL_UpdateYUVTexture() with a YV12 texture, used for software decoding
+    UPLOAD_YUV,
+
+    // SDL_UpdateNVTexture() with an NV12 texture, used for read-back frames
+    UPLOAD_NV,
+
+    // SDL_LockTexture() and PlaneCopy, the NV12 fallback
+    UPLOAD_LOCK
+};
+Q_DECLARE_METATYPE(UploadPath)
+
+// Benchmarks SdlRenderer's upload and draw path on SDL's OpenGL renderer.
+// By default, this runs headless on SDL's offscreen video driver, which
+// uses Mesa's llvmpipe when LIBGL_ALWAYS_SOFTWARE=1 is set. Set
+// SDL_VIDEODRIVER and SDL_RENDER_DRIVER to benchmark other backends.
+class TestSdlUpload : public QObject
+{
+    Q_OBJECT
+
+private:
+    static
+    QByteArray makePlane(int pitch, int rows, int seed)
+    {
+        QByteArray plane(pitch * rows, Qt::Uninitialized);
+        for (int i = 0; i < plane.size(); i++) {
+            plane[i] = (char)(i * 31 + seed);
+        }
+        return plane;
+    }
+
+    bool uploadFrame(SDL_Texture* texture, UploadPath path, int width, int height)
+    {
+        switch (path) {
+        case UPLOAD_YUV:
+            return SDL_UpdateYUVTexture(texture, nullptr,
+                                        (const Uint8*)m_Planes[0].constData(), m_Pitch,
+                                        (const Uint8*)m_Planes[1].constData(), m_Pitch / 2,
+                                        (const Uint8*)m_Planes[2].constData(), m_Pitch / 2) == 0;
+
+        case UPLOAD_NV:
+#if SDL_VERSION_ATLEAST(2, 0, 15)
+            return SDL_UpdateNVTexture(texture, nullptr,
+                                       (const Uint8*)m_Planes[0].constData(), m_Pitch,
+                                       (const Uint8*)m_Planes[1].constData(), m_Pitch) == 0;
+#else
+            return false;
+#endif
+
+        case UPLOAD_LOCK:
+        {
+            char* pixels;
+            int pitch;
+
+            if (SDL_LockTexture(texture, nullptr, (void**)&pixels, &pitch) < 0) {
+                return false;
+            }
+
+            PlaneCopy::copyNV12((Uint8*)pixels, pitch,
+                                (Uint8*)pixels + (pitch * height), pitch,
+                                (const Uint8*)m_Planes[0].constData(), m_Pitch,
+                                (const Uint8*)m_Planes[1].constData(), m_Pitch,
+                                width, height, 1);
+
+            SDL_UnlockTexture(texture);
+            return true;
+        }
+        }
+
+        return false;
+    }
+
+    SDL_Window* m_Window = nullptr;
+    SDL_Renderer* m_Renderer = nullptr;
+    QByteArray m_Planes[3];
+    int m_Pitch = 0;
+
+private slots:
+    void initTestCase()
+    {
+        if (qEnvironmentVariableIsEmpty("SDL_VIDEODRIVER")) {
+            qputenv("SDL_VIDEODRIVER", "offscreen");
+        }
+
+        // SDL_RENDER_DRIVER takes precedence over this hint
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengl");
+
+        SDL_SetMainReady();
+        if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
+            QSKIP(qPrintable(QString("Unable to initialize SDL video: %1").arg(SDL_GetError())));
+        }
+
+        m_Window = SDL_CreateWindow("tst_sdlupload",
+                                    SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                    1920, 1080,
+                                    SDL_WINDOW_HIDDEN | SDL_WINDOW_OPENGL);
+        if (m_Window == nullptr) {
+            QSKIP(qPrintable(QString("Unable to create window: %1").arg(SDL_GetError())));
+        }
+
+        // No SDL_RENDERER_PRESENTVSYNC, so we measure the upload and draw
+        // rather than the display's refresh interval
+        m_Renderer = SDL_CreateRenderer(m_Window, -1, SDL_RENDERER_ACCELERATED);
+        if (m_Renderer == nullptr) {
+            QSKIP(qPrintable(QString("Unable to create renderer: %1").arg(SDL_GetError())));
+        }
+
+        SDL_RendererInfo info;
+        if (SDL_GetRendererInfo(m_Renderer, &info) == 0) {
+            qInfo("Benchmarking the %s renderer on the %s video driver",
+                  info.name, SDL_GetCurrentVideoDriver());
+        }
+    }
+
+    void cleanupTestCase()
+    {
+        if (m_Renderer != nullptr) {
+            SDL_DestroyRenderer(m_Renderer);
+        }
+        if (m_Window != nullptr) {
+            SDL_DestroyWindow(m_Window);
+        }
+        SDL_QuitSubSystem(SDL_INIT_VIDEO);
+    }
+
+    // Run with -median N for stable numbers
+    void benchmarkUploadAndDraw_data()
+    {
+        QTest::addColumn<UploadPath>("path");
+        QTest::addColumn<int>("textureCount");
+        QTest::addColumn<int>("width");
+        QTest::addColumn<int>("height");
+
+        for (int textureCount = 1; textureCount <= MAX_UPLOAD_TEXTURES; textureCount++) {
+            QByteArray textures = " " + QByteArray::number(textureCount) + (textureCount == 1 ? " texture" : " textures");
+
+            QTest::newRow("YV12 update 720p" + textures) << UPLOAD_YUV << textureCount << 1280 << 720;
+            QTest::newRow("YV12 update 1080p" + textures) << UPLOAD_YUV << textureCount << 1920 << 1080;
+            QTest::newRow("NV12 update 1080p" + textures) << UPLOAD_NV << textureCount << 1920 << 1080;
+            QTest::newRow("NV12 lock 1080p" + textures) << UPLOAD_LOCK << textureCount << 1920 << 1080;
+        }
+    }
+
+    void benchmarkUploadAndDraw()
+    {
+        QFETCH(UploadPath, path);
+        QFETCH(int, textureCount);
+        QFETCH(int, width);
+        QFETCH(int, height);
+
+#if !SDL_VERSION_ATLEAST(2, 0, 15)
+        if (path == UPLOAD_NV) {
+            QSKIP("SDL_UpdateNVTexture() requires SDL 2.0.15");
+        }
+#endif
+
+        // Frames are padded like decoder output
+        m_Pitch = (width + 63) & ~63;
+        if (path == UPLOAD_YUV) {
+            m_Planes[0] = makePlane(m_Pitch, height, 0);
+            m_Planes[1] = makePlane(m_Pitch / 2, height / 2, 1);
+            m_Planes[2] = makePlane(m_Pitch / 2, height / 2, 2);
+        }
+        else {
+            m_Planes[0] = makePlane(m_Pitch, height, 0);
+            m_Planes[1] = makePlane(m_Pitch, height / 2, 1);
+        }
+
+        SDL_Texture* textures[MAX_UPLOAD_TEXTURES] = {};
+        for (int i = 0; i < textureCount; i++) {
+            textures[i] = SDL_CreateTexture(m_Renderer,
+                                            path == UPLOAD_YUV ? SDL_PIXELFORMAT_YV12 : SDL_PIXELFORMAT_NV12,
+                                            SDL_TEXTUREACCESS_STREAMING,
+                                            width, height);
+            QVERIFY2(textures[i] != nullptr, SDL_GetError());
+        }
+
+        QVERIFY2(uploadFrame(textures[0], path, width, height), SDL_GetError());
+
+        int nextTexture = 0;
+        QBENCHMARK {
+            SDL_Texture* texture = textures[nextTexture];
+            nextTexture = (nextTexture + 1) % textureCount;
+
+            uploadFrame(texture, path, width, height);
+
+            SDL_RenderClear(m_Renderer);
+            SDL_RenderCopy(m_Renderer, texture, nullptr, nullptr);
+            SDL_RenderPresent(m_Renderer);
+        }
+
+        for (int i = 0; i < textureCount; i++) {
+            SDL_DestroyTexture(textures[i]);
+        }
+    }
+};
+
+QTEST_APPLESS_MAIN(TestSdlUpload)
+
+#include "tst_sdlupload.moc"
@@ -0,0 +1,18 @@
+TARGET = tst_streamutils
+CONFIG += test_sdl
+
+include(../tests.pri)
+
+win32 {
+    LIBS += -lpsapi
+}
+macx {
+    LIBS += -framework CoreGraphics
+}
+
+SOURCES += \
+    tst_streamutils.cpp \
+    $$PWD/../../app/streaming/streamutils.cpp
+
+HEADERS += \
+    $$PWD/../../app/streaming/streamutils.h
@@ -0,0 +1,55 @@
+#include "streaming/streamutils.h"
+
+#include <QtTest>
+
+#define TEST_ALLOCATION_MB 64
+
+class TestStreamUtils : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void peakMemoryTracksAllocations()
+    {
+        Uint64 peakRssBefore, peakRssAfter;
+        QVERIFY(StreamUtils::getProcessPeakMemory(peakRssBefore));
+        QVERIFY(peakRssBefore > 0);
+
+        // Touch every page so it's actually resident. The writes are
+        // volatile so the compiler can't drop the allocation.
+        size_t size = (size_t)TEST_ALLOCATION_MB * 1024 * 1024;
+        volatile char* buffer = new char[size];
+        for (size_t i = 0; i < size; i += 1024) {
+            buffer[i] = 1;
+        }
+
+        QVERIFY(StreamUtils::getProcessPeakMemory(peakRssAfter));
+        delete[] buffer;
+
+        // Leave room for pages that were resident before but not at the peak
+        QVERIFY(peakRssAfter - peakRssBefore >= (Uint64)TEST_ALLOCATION_MB / 2 * 1024 * 1024);
+
+        // The peak stays put after the memory is freed
+        Uint64 peakRssFreed;
+        QVERIFY(StreamUtils::getProcessPeakMemory(peakRssFreed));
+        QVERIFY(peakRssFreed >= peakRssAfter);
+    }
+
+    void lowMemoryProfileIsOptIn()
+    {
+        // Small machines don't get it without asking
+        qunsetenv("ML_LOW_MEMORY");
+        QVERIFY(!StreamUtils::isLowMemoryProfileEnabled());
+
+        qputenv("ML_LOW_MEMORY", "1");
+        QVERIFY(StreamUtils::isLowMemoryProfileEnabled());
+
+        qputenv("ML_LOW_MEMORY", "0");
+        QVERIFY(!StreamUtils::isLowMemoryProfileEnabled());
+
+        qunsetenv("ML_LOW_MEMORY");
+    }
+};
+
+QTEST_APPLESS_MAIN(TestStreamUtils)
+#include "tst_streamutils.moc"
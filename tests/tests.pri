@@ -0,0 +1,66 @@
+# Common settings for each unit test project
+QT += testlib
+QT -= gui
+CONFIG += testcase console c++11
+CONFIG -= app_bundle
+TEMPLATE = app
+
+include(../globaldefs.pri)
+
+# Tests build the app sources they cover directly
+INCLUDEPATH += $$PWD/../app
+
+# Tests that call into SDL or OpenSSL add CONFIG += test_sdl or
+# CONFIG += test_openssl before including this file
+test_sdl|test_openssl {
+    win32 {
+        contains(QT_ARCH, i386) {
+            LIBS += -L$$PWD/../libs/windows/lib/x86
+            INCLUDEPATH += $$PWD/../libs/windows/include/x86
+        }
+        contains(QT_ARCH, x86_64) {
+            LIBS += -L$$PWD/../libs/windows/lib/x64
+            INCLUDEPATH += $$PWD/../libs/windows/include/x64
+        }
+        contains(QT_ARCH, arm64) {
+            LIBS += -L$$PWD/../libs/windows/lib/arm64
+            INCLUDEPATH += $$PWD/../libs/windows/include/arm64
+        }
+        INCLUDEPATH += $$PWD/../libs/windows/include
+    }
+    macx {
+        INCLUDEPATH += $$PWD/../libs/mac/include
+        LIBS += -L$$PWD/../libs/mac/lib
+    }
+    unix:!macx {
+        CONFIG += link_pkgconfig
+    }
+}
+
+test_sdl {
+    # QTEST_MAIN provides main(), so SDL must not redefine it
+    DEFINES += SDL_MAIN_HANDLED
+
+    win32 {
+        LIBS += -lSDL2
+    }
+    macx {
+        INCLUDEPATH += $$PWD/../libs/mac/Frameworks/SDL2.framework/Versions/A/Headers
+        LIBS += -F$$PWD/../libs/mac/Frameworks -framework SDL2
+    }
+    unix:!macx {
+        PKGCONFIG += sdl2
+    }
+}
+
+test_openssl {
+    win32 {
+        LIBS += -llibssl -llibcrypto
+    }
+    macx {
+        LIBS += -lssl -lcrypto
+    }
+    unix:!macx {
+        PKGCONFIG += openssl
+    }
+}
@@ -0,0 +1,16 @@
+# Unit tests for streaming logic that can run without FFmpeg, a video
+# device, or a GameStream host. Build and run them with:
+#   qmake tests/tests.pro && make check
+TEMPLATE = subdirs
+SUBDIRS = \
+    avsync \
+    cachedcomputervalidator \
+    heldframes \
+    hostemulator \
+    nvhttp \
+    pacingdepth \
+    planecopy \
+    rfitracker \
+    sdlupload \
+    streamutils \
+    threadroles
@@ -0,0 +1,11 @@
+TARGET = tst_threadroles
+CONFIG += test_sdl
+
+include(../tests.pri)
+
+SOURCES += \
+    tst_threadroles.cpp \
+    $$PWD/../../app/streaming/threadroles.cpp
+
+HEADERS += \
+    $$PWD/../../app/streaming/threadroles.h
@@ -0,0 +1,175 @@
+#include "streaming/threadroles.h"
+
+#include <QtTest>
+
+#ifdef Q_OS_LINUX
+#include <sys/prctl.h>
+#endif
+
+Q_DECLARE_METATYPE(ThreadRoles::SchedPolicy)
+
+class TestThreadRoles : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roleVariables()
+    {
+        qputenv("ML_THREAD_DECODER_AFFINITY", "2-3");
+        qputenv("ML_THREAD_RENDER_SCHED", "fifo:10");
+        qputenv("ML_THREAD_AUDIO_TIMER_SLACK_NS", "1000");
+
+        QCOMPARE(ThreadRoles::getRoleVariable(ThreadRoles::RoleDecoder, "AFFINITY"), QByteArray("2-3"));
+        QCOMPARE(ThreadRoles::getRoleVariable(ThreadRoles::RoleRender, "SCHED"), QByteArray("fifo:10"));
+        QCOMPARE(ThreadRoles::getRoleVariable(ThreadRoles::RoleAudio, "TIMER_SLACK_NS"), QByteArray("1000"));
+
+        // Each role only sees its own variables
+        QVERIFY(ThreadRoles::getRoleVariable(ThreadRoles::RoleMain, "AFFINITY").isEmpty());
+        QVERIFY(ThreadRoles::getRoleVariable(ThreadRoles::RoleDecoder, "SCHED").isEmpty());
+
+        qunsetenv("ML_THREAD_DECODER_AFFINITY");
+        qunsetenv("ML_THREAD_RENDER_SCHED");
+        qunsetenv("ML_THREAD_AUDIO_TIMER_SLACK_NS");
+    }
+
+    void parseSchedPolicy_data()
+    {
+        QTest::addColumn<QByteArray>("sched");
+        QTest::addColumn<bool>("valid");
+        QTest::addColumn<ThreadRoles::SchedPolicy>("policy");
+        QTest::addColumn<int>("value");
+
+        QTest::newRow("fifo") << QByteArray("fifo:10") << true << ThreadRoles::SchedFifo << 10;
+        QTest::newRow("rr") << QByteArray("rr:1") << true << ThreadRoles::SchedRoundRobin << 1;
+        QTest::newRow("nice") << QByteArray("nice:-5") << true << ThreadRoles::SchedNice << -5;
+        QTest::newRow("missing value") << QByteArray("fifo") << false << ThreadRoles::SchedFifo << 0;
+        QTest::newRow("empty value") << QByteArray("rr:") << false << ThreadRoles::SchedFifo << 0;
+        QTest::newRow("bad value") << QByteArray("nice:low") << false << ThreadRoles::SchedFifo << 0;
+        QTest::newRow("unknown policy") << QByteArray("idle:0") << false << ThreadRoles::SchedFifo << 0;
+        QTest::newRow("extra field") << QByteArray("fifo:10:1") << false << ThreadRoles::SchedFifo << 0;
+        QTest::newRow("uppercase") << QByteArray("FIFO:10") << false << ThreadRoles::SchedFifo << 0;
+    }
+
+    void parseSchedPolicy()
+    {
+        QFETCH(QByteArray, sched);
+        QFETCH(bool, valid);
+        QFETCH(ThreadRoles::SchedPolicy, policy);
+        QFETCH(int, value);
+
+        ThreadRoles::SchedPolicy parsedPolicy;
+        int parsedValue;
+        QCOMPARE(ThreadRoles::parseSchedPolicy(sched, &parsedPolicy, &parsedValue), valid);
+        if (valid) {
+            QCOMPARE(parsedPolicy, policy);
+            QCOMPARE(parsedValue, value);
+        }
+    }
+
+    void parseTimerSlack_data()
+    {
+        QTest::addColumn<QByteArray>("timerSlack");
+        QTest::addColumn<bool>("valid");
+        QTest::addColumn<int>("timerSlackNs");
+
+        QTest::newRow("1 ns") << QByteArray("1") << true << 1;
+        QTest::newRow("50 us") << QByteArray("50000") << true << 50000;
+        QTest::newRow("zero") << QByteArray("0") << false << 0;
+        QTest::newRow("negative") << QByteArray("-1") << false << 0;
+        QTest::newRow("units") << QByteArray("50us") << false << 0;
+    }
+
+    void parseTimerSlack()
+    {
+        QFETCH(QByteArray, timerSlack);
+        QFETCH(bool, valid);
+        QFETCH(int, timerSlackNs);
+
+        int parsedTimerSlackNs;
+        QCOMPARE(ThreadRoles::parseTimerSlack(timerSlack, &parsedTimerSlackNs), valid);
+        if (valid) {
+            QCOMPARE(parsedTimerSlackNs, timerSlackNs);
+        }
+    }
+
+    void parseCpuList_data()
+    {
+#ifdef Q_OS_LINUX
+        QTest::addColumn<QByteArray>("cpuList");
+        QTest::addColumn<bool>("valid");
+        QTest::addColumn<QString>("formatted");
+
+        QTest::newRow("single") << QByteArray("3") << true << QString("3");
+        QTest::newRow("range") << QByteArray("2-3") << true << QString("2-3");
+        QTest::newRow("mixed") << QByteArray("0, 2-4,6") << true << QString("0,2-4,6");
+        QTest::newRow("overlapping") << QByteArray("1-3,2-5") << true << QString("1-5");
+        QTest::newRow("adjacent") << QByteArray("1,2,3") << true << QString("1-3");
+        QTest::newRow("reversed") << QByteArray("3-2") << false << QString();
+        QTest::newRow("negative") << QByteArray("-1") << false << QString();
+        QTest::newRow("open range") << QByteArray("2-") << false << QString();
+        QTest::newRow("too large") << QByteArray::number(CPU_SETSIZE) << false << QString();
+        QTest::newRow("not a number") << QByteArray("all") << false << QString();
+        QTest::newRow("empty entry") << QByteArray("1,,2") << false << QString();
+#endif
+    }
+
+    void parseCpuList()
+    {
+#ifdef Q_OS_LINUX
+        QFETCH(QByteArray, cpuList);
+        QFETCH(bool, valid);
+        QFETCH(QString, formatted);
+
+        cpu_set_t cpuSet;
+        QCOMPARE(ThreadRoles::parseCpuList(cpuList, &cpuSet), valid);
+        if (valid) {
+            QCOMPARE(ThreadRoles::formatCpuList(&cpuSet), formatted);
+        }
+#else
+        QSKIP("CPU affinity is only supported on Linux");
+#endif
+    }
+
+    void applyAndRestore()
+    {
+#ifdef Q_OS_LINUX
+        cpu_set_t originalAffinity;
+        QVERIFY(sched_getaffinity(0, sizeof(originalAffinity), &originalAffinity) == 0);
+        int originalTimerSlackNs = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+
+        // Pin to the first CPU we're already allowed to run on
+        int cpu = 0;
+        while (!CPU_ISSET(cpu, &originalAffinity)) {
+            cpu++;
+        }
+
+        qputenv("ML_THREAD_DECODER_AFFINITY", QByteArray::number(cpu));
+        qputenv("ML_THREAD_DECODER_TIMER_SLACK_NS", QByteArray::number(originalTimerSlackNs + 1000));
+
+        ThreadRoles::SavedState savedState;
+        ThreadRoles::applyToCurrentThread(ThreadRoles::RoleDecoder, &savedState);
+
+        qunsetenv("ML_THREAD_DECODER_AFFINITY");
+        qunsetenv("ML_THREAD_DECODER_TIMER_SLACK_NS");
+
+        cpu_set_t affinity;
+        QVERIFY(sched_getaffinity(0, sizeof(affinity), &affinity) == 0);
+        QCOMPARE(CPU_COUNT(&affinity), 1);
+        QVERIFY(CPU_ISSET(cpu, &affinity));
+        QCOMPARE(prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0), originalTimerSlackNs + 1000);
+
+        QVERIFY(savedState.valid);
+        ThreadRoles::restoreCurrentThread(savedState);
+
+        QVERIFY(sched_getaffinity(0, sizeof(affinity), &affinity) == 0);
+        QVERIFY(CPU_EQUAL(&affinity, &originalAffinity));
+        QCOMPARE(prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0), originalTimerSlackNs);
+#else
+        QSKIP("Thread roles are only configurable on Linux");
+#endif
+    }
+};
+
+QTEST_APPLESS_MAIN(TestThreadRoles)
+
+#include "tst_threadroles.moc"